@@ -0,0 +1,67 @@
+/*****************************************************************************
+* | File      	:   emu_golden.c
+* | Author      :   IT8951-ePaper contributors
+* | Function    :   Runs an example against the emulator bus and dumps the panel
+* | Info        :
+*                For "make emu-check", which compares the dump with
+*                golden.pgm; the bus, panel and timing come from the
+*                EPD_BUS and EPD_EMU_* variables the Makefile sets
+*----------------
+* |	This version:   V1.0
+* | Date        :   2026-10-18
+* | Info        :
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documnetation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to  whom the Software is
+# furished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS OR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+# THE SOFTWARE.
+#
+******************************************************************************/
+#include "../example.h"
+#include "../../lib/Config/Debug.h"
+
+//example.c takes these from main.cpp
+int epd_mode = 0;
+UWORD VCOM = 1500;
+
+int main(int argc, char *argv[])
+{
+    IT8951_Dev Panel;
+    IT8951_Dev_Info Dev_Info;
+    DEV_PINS Pins;
+    UDOUBLE Init_Target_Memory_Addr;
+    int Result = 0;
+
+    if(argc != 2) {
+        printf("usage: %s <panel.pgm>\r\n", argv[0]);
+        return 1;
+    }
+    if(DEV_Module_Init() != 0)
+        return 1;
+
+    DEV_Get_Screen_Pins(1, &Pins);
+    EPD_IT8951_Open(&Panel, &Pins);
+    Dev_Info = EPD_IT8951_Init(&Panel, VCOM);
+    Init_Target_Memory_Addr = Dev_Info.Memory_Addr_L | (Dev_Info.Memory_Addr_H << 16);
+
+    EPD_IT8951_Clear_Refresh(&Panel, Init_Target_Memory_Addr, Panel.INIT_Mode);
+    Display_CharacterPattern_Example(&Panel, Dev_Info.Panel_W, Dev_Info.Panel_H, Init_Target_Memory_Addr, BitsPerPixel_4);
+    if(EPD_IT8951_Wait_Display(&Panel) != IT8951_OK || DEV_Emu_Dump_PGM(1, argv[1]) != 0)
+        Result = 1;
+
+    DEV_Module_Exit();
+    return Result;
+}
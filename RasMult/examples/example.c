@@ -8,6 +8,10 @@
 #include <stdlib.h>
 
 #include "../lib/e-Paper/EPD_IT8951.h"
+#include "../lib/e-Paper/EPD_IT8951_Coalesce.h"
+#include "../lib/e-Paper/EPD_IT8951_Player.h"
+#include "../lib/e-Paper/EPD_IT8951_Scroll.h"
+#include "../lib/e-Paper/EPD_IT8951_Cache.h"
 #include "../lib/GUI/GUI_Paint.h"
 #include "../lib/GUI/GUI_BMPfile.h"
 #include "../lib/Config/Debug.h"
@@ -17,45 +21,38 @@ UBYTE *Refresh_Frame_Buf = NULL;
 UBYTE *Panel_Frame_Buf = NULL;
 UBYTE *Panel_Area_Frame_Buf = NULL;
 
-bool Four_Byte_Align = false;
-
 extern int epd_mode;
 extern UWORD VCOM;
 extern UBYTE isColor;
 /******************************************************************************
-function: Change direction of display, Called after Paint_NewImage()
+function: Set the orientation of the panel, Called before the image is sized
 parameter:
+    Dev: The panel
     mode: display mode
+    Width, Height: set to the canvas the image is drawn on
 ******************************************************************************/
-static void Epd_Mode(int mode)
+static void Epd_Mode(IT8951_Dev* Dev, int mode, UWORD* Width, UWORD* Height)
 {
-	if(mode == 3) {
-		Paint_SetRotate(ROTATE_0);
-		Paint_SetMirroring(MIRROR_NONE);
+	//the 10.3inch and 5.17inch panels are mirrored, the driver turns the
+	//rows round as they are loaded and the image is drawn as it is seen
+	EPD_IT8951_Set_Orientation(Dev, IT8951_ROTATE_0, mode == 1 || mode == 2);
+	EPD_IT8951_Get_Canvas_Size(Dev, Width, Height);
+	if(mode == 3)
 		isColor = 1;
-	}else if(mode == 2) {
-		Paint_SetRotate(ROTATE_0);
-		Paint_SetMirroring(MIRROR_HORIZONTAL);
-	}else if(mode == 1) {
-		Paint_SetRotate(ROTATE_0);
-		Paint_SetMirroring(MIRROR_HORIZONTAL);
-	}else {
-		Paint_SetRotate(ROTATE_0);
-		Paint_SetMirroring(MIRROR_NONE);
-	}
 }
 
 
 /******************************************************************************
 function: Display_ColorPalette_Example
 parameter:
+    Dev: The panel
     Panel_Width: Width of the panel
     Panel_Height: Height of the panel
     Init_Target_Memory_Addr: Memory address of IT8951 target memory address
 ******************************************************************************/
-UBYTE Display_ColorPalette_Example(UWORD Panel_Width, UWORD Panel_Height, UDOUBLE Init_Target_Memory_Addr){
+UBYTE Display_ColorPalette_Example(IT8951_Dev* Dev, UWORD Panel_Width, UWORD Panel_Height, UDOUBLE Init_Target_Memory_Addr){
     UWORD In_4bp_Refresh_Area_Width;
-    if(Four_Byte_Align == true){
+    if(Dev->Four_Byte_Align == true){
         In_4bp_Refresh_Area_Width = Panel_Width - (Panel_Width % 32);
     }else{
         In_4bp_Refresh_Area_Width = Panel_Width;
@@ -81,7 +78,7 @@ UBYTE Display_ColorPalette_Example(UWORD Panel_Width, UWORD Panel_Height, UDOUBL
 
     for(int i=0; i < 16; i++){
         memset(Refresh_Frame_Buf, SixteenColorPattern[i], Imagesize);
-        EPD_IT8951_4bp_Refresh(Refresh_Frame_Buf, 0, i * In_4bp_Refresh_Area_Height, In_4bp_Refresh_Area_Width, In_4bp_Refresh_Area_Height, false, Init_Target_Memory_Addr, false);
+        EPD_IT8951_4bp_Refresh(Dev, Refresh_Frame_Buf, 0, i * In_4bp_Refresh_Area_Height, In_4bp_Refresh_Area_Width, In_4bp_Refresh_Area_Height, false, Init_Target_Memory_Addr, false);
     }
 
     In_4bp_Refresh_Finish = clock();
@@ -99,14 +96,16 @@ UBYTE Display_ColorPalette_Example(UWORD Panel_Width, UWORD Panel_Height, UDOUBL
 /******************************************************************************
 function: Display_CharacterPattern_Example
 parameter:
+    Dev: The panel
     Panel_Width: Width of the panel
     Panel_Height: Height of the panel
     Init_Target_Memory_Addr: Memory address of IT8951 target memory address
     BitsPerPixel: Bits Per Pixel, 2^BitsPerPixel = grayscale
 ******************************************************************************/
-UBYTE Display_CharacterPattern_Example(UWORD Panel_Width, UWORD Panel_Height, UDOUBLE Init_Target_Memory_Addr, UBYTE BitsPerPixel){
+UBYTE Display_CharacterPattern_Example(IT8951_Dev* Dev, UWORD Panel_Width, UWORD Panel_Height, UDOUBLE Init_Target_Memory_Addr, UBYTE BitsPerPixel){
+    Epd_Mode(Dev, epd_mode, &Panel_Width, &Panel_Height);
     UWORD Display_Area_Width;
-    if(Four_Byte_Align == true){
+    if(Dev->Four_Byte_Align == true){
         Display_Area_Width = Panel_Width - (Panel_Width % 32);
     }else{
         Display_Area_Width = Panel_Width;
@@ -126,7 +125,6 @@ UBYTE Display_CharacterPattern_Example(UWORD Panel_Width, UWORD Panel_Height, UD
 
     Paint_NewImage(Refresh_Frame_Buf, Display_Area_Width, Display_Area_Height, 0, BLACK);
     Paint_SelectImage(Refresh_Frame_Buf);
-	Epd_Mode(epd_mode);
     Paint_SetBitsPerPixel(BitsPerPixel);
     Paint_Clear(WHITE);
     
@@ -149,19 +147,19 @@ UBYTE Display_CharacterPattern_Example(UWORD Panel_Width, UWORD Panel_Height, UD
 
     switch(BitsPerPixel){
         case BitsPerPixel_8:{
-            EPD_IT8951_8bp_Refresh(Refresh_Frame_Buf, 0, 0, Display_Area_Width,  Display_Area_Height, false, Init_Target_Memory_Addr);
+            EPD_IT8951_8bp_Refresh(Dev, Refresh_Frame_Buf, 0, 0, Display_Area_Width,  Display_Area_Height, false, Init_Target_Memory_Addr);
             break;
         }
         case BitsPerPixel_4:{
-            EPD_IT8951_4bp_Refresh(Refresh_Frame_Buf, 0, 0, Display_Area_Width,  Display_Area_Height, false, Init_Target_Memory_Addr,false);
+            EPD_IT8951_4bp_Refresh(Dev, Refresh_Frame_Buf, 0, 0, Display_Area_Width,  Display_Area_Height, false, Init_Target_Memory_Addr,false);
             break;
         }
         case BitsPerPixel_2:{
-            EPD_IT8951_2bp_Refresh(Refresh_Frame_Buf, 0, 0, Display_Area_Width,  Display_Area_Height, false, Init_Target_Memory_Addr,false);
+            EPD_IT8951_2bp_Refresh(Dev, Refresh_Frame_Buf, 0, 0, Display_Area_Width,  Display_Area_Height, false, Init_Target_Memory_Addr,false);
             break;
         }
         case BitsPerPixel_1:{
-            EPD_IT8951_1bp_Refresh(Refresh_Frame_Buf, 0, 0, Display_Area_Width,  Display_Area_Height, A2_Mode, Init_Target_Memory_Addr,false);
+            EPD_IT8951_1bp_Refresh(Dev, Refresh_Frame_Buf, 0, 0, Display_Area_Width,  Display_Area_Height, Dev->A2_Mode, Init_Target_Memory_Addr,false);
             break;
         }
     }
@@ -179,14 +177,16 @@ UBYTE Display_CharacterPattern_Example(UWORD Panel_Width, UWORD Panel_Height, UD
 /******************************************************************************
 function: Display_BMP_Example
 parameter:
+    Dev: The panel
     Panel_Width: Width of the panel
     Panel_Height: Height of the panel
     Init_Target_Memory_Addr: Memory address of IT8951 target memory address
     BitsPerPixel: Bits Per Pixel, 2^BitsPerPixel = grayscale
 ******************************************************************************/
-UBYTE Display_BMP_Example(char *filenm, UWORD Panel_Width, UWORD Panel_Height, UDOUBLE Init_Target_Memory_Addr, UBYTE BitsPerPixel){
+UBYTE Display_BMP_Example(IT8951_Dev* Dev, char *filenm, UWORD Panel_Width, UWORD Panel_Height, UDOUBLE Init_Target_Memory_Addr, UBYTE BitsPerPixel){
+    Epd_Mode(Dev, epd_mode, &Panel_Width, &Panel_Height);
     UWORD WIDTH;
-    if(Four_Byte_Align == true){
+    if(Dev->Four_Byte_Align == true){
         WIDTH  = Panel_Width - (Panel_Width % 32);
     }else{
         WIDTH = Panel_Width;
@@ -195,21 +195,34 @@ UBYTE Display_BMP_Example(char *filenm, UWORD Panel_Width, UWORD Panel_Height, U
 
     UDOUBLE Imagesize;
 
+    char Path[30];
+    sprintf(Path,filenm, WIDTH, HEIGHT);
+
+    //the transfers of an earlier run of this picture replay without decoding it again;
+    //the file's time and size are in the name, so an edited picture is recorded anew
+    char Rec_Path[96] = "";
+    IT8951_Recording Rec = {0};
+    struct stat Bmp_Stat;
+    if(stat(Path, &Bmp_Stat) == 0)
+        snprintf(Rec_Path, sizeof(Rec_Path), "%s.%ld-%ld.%dbpp-%d.it8951", Path,
+                 (long)Bmp_Stat.st_mtime, (long)Bmp_Stat.st_size, BitsPerPixel, epd_mode);
+    if(Rec_Path[0] != 0 && EPD_IT8951_Recording_Load(&Rec, Rec_Path) == 0 && EPD_IT8951_Replay(Dev, &Rec) == IT8951_OK) {
+        EPD_IT8951_Recording_Free(&Rec);
+        return 0;
+    }
+
     Imagesize = ((WIDTH * BitsPerPixel % 8 == 0)? (WIDTH * BitsPerPixel / 8 ): (WIDTH * BitsPerPixel / 8 + 1)) * HEIGHT;
     if((Refresh_Frame_Buf = (UBYTE *)malloc(Imagesize)) == NULL) {
         Debug("Failed to apply for black memory...\r\n");
+        EPD_IT8951_Recording_Free(&Rec);
         return -1;
     }
 
     Paint_NewImage(Refresh_Frame_Buf, WIDTH, HEIGHT, 0, BLACK);
     Paint_SelectImage(Refresh_Frame_Buf);
-	Epd_Mode(epd_mode);
     Paint_SetBitsPerPixel(BitsPerPixel);
     Paint_Clear(WHITE);
 
-    char Path[30];
-    sprintf(Path,filenm, WIDTH, HEIGHT);
-
     GUI_ReadBmp(Path, 0, 0);
 
     //you can draw your character and pattern on the image, for color definition of all BitsPerPixel, you can refer to GUI_Paint.h, 
@@ -217,28 +230,32 @@ UBYTE Display_BMP_Example(char *filenm, UWORD Panel_Width, UWORD Panel_Height, U
     //Paint_DrawCircle(WIDTH*3/4, HEIGHT/4, 100, 0xF0, DOT_PIXEL_2X2, DRAW_FILL_EMPTY);
     //Paint_DrawNum(WIDTH/4, HEIGHT/5, 709, &Font20, 0x30, 0xB0);
 
+    EPD_IT8951_Record_Start(Dev, &Rec);
     switch(BitsPerPixel){
         case BitsPerPixel_8:{
             //Paint_DrawString_EN(10, 10, "8 bits per pixel 16 grayscale", &Font24, 0xF0, 0x00);
-            EPD_IT8951_8bp_Refresh(Refresh_Frame_Buf, 0, 0, WIDTH,  HEIGHT, false, Init_Target_Memory_Addr);
+            EPD_IT8951_8bp_Refresh(Dev, Refresh_Frame_Buf, 0, 0, WIDTH,  HEIGHT, false, Init_Target_Memory_Addr);
             break;
         }
         case BitsPerPixel_4:{
             //Paint_DrawString_EN(10, 10, "4 bits per pixel 16 grayscale", &Font24, 0xF0, 0x00);
-            EPD_IT8951_4bp_Refresh(Refresh_Frame_Buf, 0, 0, WIDTH,  HEIGHT, false, Init_Target_Memory_Addr,false);
+            EPD_IT8951_4bp_Refresh(Dev, Refresh_Frame_Buf, 0, 0, WIDTH,  HEIGHT, false, Init_Target_Memory_Addr,false);
             break;
         }
         case BitsPerPixel_2:{
             //Paint_DrawString_EN(10, 10, "2 bits per pixel 4 grayscale", &Font24, 0xC0, 0x00);
-            EPD_IT8951_2bp_Refresh(Refresh_Frame_Buf, 0, 0, WIDTH,  HEIGHT, false, Init_Target_Memory_Addr,false);
+            EPD_IT8951_2bp_Refresh(Dev, Refresh_Frame_Buf, 0, 0, WIDTH,  HEIGHT, false, Init_Target_Memory_Addr,false);
             break;
         }
         case BitsPerPixel_1:{
             //Paint_DrawString_EN(10, 10, "1 bit per pixel 2 grayscale", &Font24, 0x80, 0x00);
-            EPD_IT8951_1bp_Refresh(Refresh_Frame_Buf, 0, 0, WIDTH,  HEIGHT, A2_Mode, Init_Target_Memory_Addr,false);
+            EPD_IT8951_1bp_Refresh(Dev, Refresh_Frame_Buf, 0, 0, WIDTH,  HEIGHT, Dev->A2_Mode, Init_Target_Memory_Addr,false);
             break;
         }
     }
+    if(EPD_IT8951_Record_Stop(Dev) == IT8951_OK && Rec_Path[0] != 0)
+        EPD_IT8951_Recording_Save(&Rec, Rec_Path);
+    EPD_IT8951_Recording_Free(&Rec);
 
     if(Refresh_Frame_Buf != NULL){
         free(Refresh_Frame_Buf);
@@ -254,12 +271,14 @@ UBYTE Display_BMP_Example(char *filenm, UWORD Panel_Width, UWORD Panel_Height, U
 /******************************************************************************
 function: Dynamic_Refresh_Example
 parameter:
-    Dev_Info: Information structure read from IT8951
+    Dev: The panel, its Info is the structure read from IT8951
     Init_Target_Memory_Addr: Memory address of IT8951 target memory address
 ******************************************************************************/
-UBYTE Dynamic_Refresh_Example(IT8951_Dev_Info Dev_Info, UDOUBLE Init_Target_Memory_Addr){
-    UWORD Panel_Width = Dev_Info.Panel_W;
-    UWORD Panel_Height = Dev_Info.Panel_H;
+UBYTE Dynamic_Refresh_Example(IT8951_Dev* Dev, UDOUBLE Init_Target_Memory_Addr){
+    UWORD Panel_Width = Dev->Info.Panel_W;
+    UWORD Panel_Height = Dev->Info.Panel_H;
+
+    Epd_Mode(Dev, epd_mode, &Panel_Width, &Panel_Height);
 
     UWORD Dynamic_Area_Width = 96;
     UWORD Dynamic_Area_Height = 48;
@@ -282,6 +301,10 @@ UBYTE Dynamic_Refresh_Example(IT8951_Dev_Info Dev_Info, UDOUBLE Init_Target_Memo
     clock_t Dynamic_Area_Start, Dynamic_Area_Finish;
     double Dynamic_Area_Duration;  
 
+    //neighbouring areas that come within the window share one display command
+    IT8951_Coalesce Coalesce;
+    EPD_IT8951_Coalesce_Init(&Coalesce, Dev, IT8951_COALESCE_WINDOW_MS);
+
     while(1)
     {
         Dynamic_Area_Width = 128;
@@ -301,7 +324,6 @@ UBYTE Dynamic_Refresh_Example(IT8951_Dev_Info Dev_Info, UDOUBLE Init_Target_Memo
             Imagesize = ((Dynamic_Area_Width % 8 == 0)? (Dynamic_Area_Width / 8 ): (Dynamic_Area_Width / 8 + 1)) * Dynamic_Area_Height;
             Paint_NewImage(Refresh_Frame_Buf, Dynamic_Area_Width, Dynamic_Area_Height, 0, BLACK);
             Paint_SelectImage(Refresh_Frame_Buf);
-			Epd_Mode(epd_mode);
             Paint_SetBitsPerPixel(1);
 
            for(int y=Start_Y; y< Panel_Height - Dynamic_Area_Height; y += Dynamic_Area_Height)
@@ -317,17 +339,13 @@ UBYTE Dynamic_Refresh_Example(IT8951_Dev_Info Dev_Info, UDOUBLE Init_Target_Memo
 
                     Paint_DrawNum(Dynamic_Area_Width/4, Dynamic_Area_Height/4, ++Dynamic_Area_Count, &Font20, 0x00, 0xF0);
 
-					if(epd_mode == 2)
-						EPD_IT8951_1bp_Refresh(Refresh_Frame_Buf, 1280-Dynamic_Area_Width-x, y, Dynamic_Area_Width,  Dynamic_Area_Height, A2_Mode, Init_Target_Memory_Addr, true);
-					else if(epd_mode == 1)
-						EPD_IT8951_1bp_Refresh(Refresh_Frame_Buf, Panel_Width-Dynamic_Area_Width-x-16, y, Dynamic_Area_Width,  Dynamic_Area_Height, A2_Mode, Init_Target_Memory_Addr, true);
-                    else
-						EPD_IT8951_1bp_Refresh(Refresh_Frame_Buf, x, y, Dynamic_Area_Width,  Dynamic_Area_Height, A2_Mode, Init_Target_Memory_Addr, true);
+                    EPD_IT8951_Coalesce_Refresh(&Coalesce, 1, Refresh_Frame_Buf, x, y, Dynamic_Area_Width,  Dynamic_Area_Height, Dev->A2_Mode, Init_Target_Memory_Addr);
                 }
             }
             Start_X += 32;
             Start_Y += 24;
         }
+        EPD_IT8951_Coalesce_Flush(&Coalesce);
 
         Dynamic_Area_Finish = clock();
         Dynamic_Area_Duration = (double)(Dynamic_Area_Finish - Dynamic_Area_Start) / CLOCKS_PER_SEC;
@@ -350,12 +368,14 @@ UBYTE Dynamic_Refresh_Example(IT8951_Dev_Info Dev_Info, UDOUBLE Init_Target_Memo
 /******************************************************************************
 function: Dynamic_GIF_Example
 parameter:
+    Dev: The panel
     Panel_Width: Width of the panel
     Panel_Height: Height of the panel
     Init_Target_Memory_Addr: Memory address of IT8951 target memory address
     BitsPerPixel: Bits Per Pixel, 2^BitsPerPixel = grayscale
 ******************************************************************************/
-UBYTE Dynamic_GIF_Example(UWORD Panel_Width, UWORD Panel_Height, UDOUBLE Init_Target_Memory_Addr){
+UBYTE Dynamic_GIF_Example(IT8951_Dev* Dev, UWORD Panel_Width, UWORD Panel_Height, UDOUBLE Init_Target_Memory_Addr){
+    Epd_Mode(Dev, epd_mode, &Panel_Width, &Panel_Height);
 
     UWORD Animation_Start_X = 0;
     UWORD Animation_Start_Y = 0;
@@ -375,14 +395,20 @@ UBYTE Dynamic_GIF_Example(UWORD Panel_Width, UWORD Panel_Height, UDOUBLE Init_Ta
     UBYTE Pic_Num = 7;
     char Path[30];
 
-    UDOUBLE Basical_Memory_Addr = Init_Target_Memory_Addr;
-
-    UDOUBLE Target_Memory_Addr = Basical_Memory_Addr;
+    //every frame gets its own slot past the display buffer
+    IT8951_Pool Pool;
+    UDOUBLE Frame_Addr[7];
     UWORD Repeat_Animation_Times = 0;
 
-    clock_t Animation_Test_Start, Animation_Test_Finish;
+    //wall time, clock() only counts the CPU time of this process
+    uint64_t Animation_Test_Start;
     double Animation_Test_Duration;
 
+    //target rate, frames the panel cannot take in time are dropped
+    UWORD Animation_Frame_Rate = 8;
+    IT8951_Player Player;
+    IT8951_Player_Stats Player_Stats;
+
     Imagesize = ((Animation_Area_Width * 1 % 8 == 0)? (Animation_Area_Width * 1 / 8 ): (Animation_Area_Width * 1 / 8 + 1)) * Animation_Area_Height;
 
     if((Refresh_Frame_Buf = (UBYTE *)malloc(Imagesize)) == NULL){
@@ -392,51 +418,45 @@ UBYTE Dynamic_GIF_Example(UWORD Panel_Width, UWORD Panel_Height, UDOUBLE Init_Ta
 
     Paint_NewImage(Refresh_Frame_Buf, Animation_Area_Width, Animation_Area_Height, 0, BLACK);
     Paint_SelectImage(Refresh_Frame_Buf);
-	Epd_Mode(epd_mode);
     Paint_SetBitsPerPixel(1);
 
+    EPD_IT8951_Pool_Init(&Pool, Dev, 0, NULL, NULL);
+    for(int i=0; i < Pic_Num; i += 1){
+        Frame_Addr[i] = EPD_IT8951_Pool_Alloc(&Pool, 1, Animation_Start_X, Animation_Start_Y, Animation_Area_Width, Animation_Area_Height);
+        if(Frame_Addr[i] == 0){
+            Debug("No controller memory left for frame %d\r\n", i);
+            free(Refresh_Frame_Buf);
+            Refresh_Frame_Buf = NULL;
+            return -1;
+        }
+    }
+
     Debug("Start to write a animation\r\n");
-    Animation_Test_Start = clock();
+    Animation_Test_Start = DEV_Time_us();
     for(int i=0; i < Pic_Num; i += 1){
         Paint_Clear(WHITE);
         sprintf(Path,"./pic/800x600_gif_%d.bmp",Pic_Count++);
         GUI_ReadBmp(Path, 0, 0);
         //For color definition of all BitsPerPixel, you can refer to GUI_Paint.h
         Paint_DrawNum(10, 10, i+1, &Font16, 0x00, 0xF0);
-		if(epd_mode == 2)
-			EPD_IT8951_1bp_Multi_Frame_Write(Refresh_Frame_Buf, 1280-Animation_Area_Width+Animation_Start_X, Animation_Start_Y, Animation_Area_Width,  Animation_Area_Height, Target_Memory_Addr,false);
-        else if(epd_mode == 1)
-			EPD_IT8951_1bp_Multi_Frame_Write(Refresh_Frame_Buf, Panel_Width-Animation_Area_Width+Animation_Start_X-16, Animation_Start_Y, Animation_Area_Width,  Animation_Area_Height, Target_Memory_Addr,false);
-		else
-			EPD_IT8951_1bp_Multi_Frame_Write(Refresh_Frame_Buf, Animation_Start_X, Animation_Start_Y, Animation_Area_Width,  Animation_Area_Height, Target_Memory_Addr,false);
-        Target_Memory_Addr += Imagesize;
+        EPD_IT8951_1bp_Multi_Frame_Write(Dev, Refresh_Frame_Buf, Animation_Start_X, Animation_Start_Y, Animation_Area_Width,  Animation_Area_Height, Frame_Addr[i],false);
     }
 
-    Animation_Test_Finish = clock();
-    Animation_Test_Duration = (double)(Animation_Test_Finish - Animation_Test_Start) / CLOCKS_PER_SEC;
+    Animation_Test_Duration = (double)(DEV_Time_us() - Animation_Test_Start) / 1000000;
 	Debug( "Write all frame occupy %f second\r\n", Animation_Test_Duration);
 
-    Target_Memory_Addr = Basical_Memory_Addr;
+    EPD_IT8951_Player_Start(&Player, Dev, 1, Animation_Start_X, Animation_Start_Y, Animation_Area_Width, Animation_Area_Height, Dev->A2_Mode, Animation_Frame_Rate);
 
     while(1){
         Debug("Start to show a animation\r\n");
-        Animation_Test_Start = clock();
 
         for(int i=0; i< Pic_Num; i += 1){
-			if(epd_mode == 2)
-				EPD_IT8951_1bp_Multi_Frame_Refresh(Panel_Width-Animation_Area_Width+Animation_Start_X, Animation_Start_Y, Animation_Area_Width,  Animation_Area_Height, Target_Memory_Addr);
-			else if(epd_mode == 1)
-				EPD_IT8951_1bp_Multi_Frame_Refresh(Panel_Width-Animation_Area_Width+Animation_Start_X-16, Animation_Start_Y, Animation_Area_Width,  Animation_Area_Height, Target_Memory_Addr);
-            else
-				EPD_IT8951_1bp_Multi_Frame_Refresh(Animation_Start_X, Animation_Start_Y, Animation_Area_Width,  Animation_Area_Height, Target_Memory_Addr);
-            Target_Memory_Addr += Imagesize;
+            EPD_IT8951_Player_Frame(&Player, Frame_Addr[i]);
         }
-        Target_Memory_Addr = Basical_Memory_Addr;
 
-        Animation_Test_Finish = clock();
-        Animation_Test_Duration = (double)(Animation_Test_Finish - Animation_Test_Start) / CLOCKS_PER_SEC;
-        Debug( "Show all frame occupy %f second\r\n", Animation_Test_Duration );
-   		Debug( "The frame rate is: %lf fps\r\n", Pic_Num/Animation_Test_Duration);
+        EPD_IT8951_Player_Get_Stats(&Player, &Player_Stats);
+        Debug( "Shown %d, dropped %d frames\r\n", Player_Stats.Shown, Player_Stats.Dropped );
+   		Debug( "The frame rate is: %lf fps, jitter %lf ms\r\n", Player_Stats.Fps, Player_Stats.Jitter_us / 1000);
 
         Repeat_Animation_Times ++;
         if(Repeat_Animation_Times >15){
@@ -454,17 +474,87 @@ UBYTE Dynamic_GIF_Example(UWORD Panel_Width, UWORD Panel_Height, UDOUBLE Init_Ta
 
 
 
+/******************************************************************************
+function: Scroll_Log_Draw
+parameter:
+Info:
+    Draw callback of Scroll_Log_Example, the strips it is asked for start
+    on whole lines because every step moves by whole lines
+******************************************************************************/
+#define SCROLL_LOG_LINE_H   36
+
+static void Scroll_Log_Draw(void* User, UBYTE* Buf, UWORD Image_X, UWORD Image_Y, UWORD W, UWORD H)
+{
+    char Line[32];
+
+    Paint_NewImage(Buf, W, H, 0, WHITE);
+    Paint_SelectImage(Buf);
+    Paint_SetBitsPerPixel(1);
+    for(UWORD y = 0; y < H; y += SCROLL_LOG_LINE_H) {
+        sprintf(Line, "log line %d", (Image_Y + y) / SCROLL_LOG_LINE_H + 1);
+        Paint_DrawString_EN(10, y + 6, Line, &Font24, 0x00, 0xFF);
+    }
+}
+
+
+/******************************************************************************
+function: Scroll_Log_Example
+parameter:
+    Dev: The panel
+    Panel_Width: Width of the panel
+    Panel_Height: Height of the panel
+    Init_Target_Memory_Addr: Memory address of IT8951 target memory address
+Info:
+    A 200 line log scrolled through with A2. Each line is drawn and loaded
+    once, scrolling back up shows it again without any pixel transfer.
+******************************************************************************/
+UBYTE Scroll_Log_Example(IT8951_Dev* Dev, UWORD Panel_Width, UWORD Panel_Height, UDOUBLE Init_Target_Memory_Addr){
+    UWORD Log_Lines = 200;
+    UWORD View_W = (Dev->Four_Byte_Align == true) ? Panel_Width - (Panel_Width % 32) : Panel_Width - (Panel_Width % 16);
+    UWORD View_H = Panel_Height - (Panel_Height % SCROLL_LOG_LINE_H);
+    UWORD Position;
+    IT8951_Scroll Scroll;
+    IT8951_Pool Pool;
+    UDOUBLE Log_Addr;
+
+    EPD_IT8951_Pool_Init(&Pool, Dev, 0, NULL, NULL);
+    Log_Addr = EPD_IT8951_Pool_Alloc(&Pool, 1, 0, 0, View_W, Log_Lines * SCROLL_LOG_LINE_H);
+    if(Log_Addr == 0 || EPD_IT8951_Scroll_Open(&Scroll, Dev, Log_Addr, 1,
+                              0, 0, View_W, View_H, View_W, Log_Lines * SCROLL_LOG_LINE_H, Scroll_Log_Draw, NULL) != 0){
+        return -1;
+    }
+
+    Debug("Scroll down the log\r\n");
+    for(Position = 0; Position + View_H <= Scroll.Image_H; Position += 3 * SCROLL_LOG_LINE_H){
+        EPD_IT8951_Scroll_To(&Scroll, 0, Position, Dev->A2_Mode);
+    }
+    Debug("Drawn %d pixels\r\n", Scroll.Drawn_Pixels);
+
+    Debug("Scroll back up\r\n");
+    while(Position >= 3 * SCROLL_LOG_LINE_H){
+        Position -= 3 * SCROLL_LOG_LINE_H;
+        EPD_IT8951_Scroll_To(&Scroll, 0, Position, Dev->A2_Mode);
+    }
+    Debug("Drawn %d pixels\r\n", Scroll.Drawn_Pixels);
+
+    return EPD_IT8951_Scroll_To(&Scroll, 0, 0, Dev->GC16_Mode);
+}
+
+
+
 /******************************************************************************
 function: Check_FrameRate_Example
 parameter:
+    Dev: The panel
     Panel_Width: Width of the panel
     Panel_Height: Height of the panel
     Init_Target_Memory_Addr: Memory address of IT8951 target memory address
     BitsPerPixel: Bits Per Pixel, 2^BitsPerPixel = grayscale
 ******************************************************************************/
-UBYTE Check_FrameRate_Example(UWORD Panel_Width, UWORD Panel_Height, UDOUBLE Target_Memory_Addr, UBYTE BitsPerPixel){
+UBYTE Check_FrameRate_Example(IT8951_Dev* Dev, UWORD Panel_Width, UWORD Panel_Height, UDOUBLE Target_Memory_Addr, UBYTE BitsPerPixel){
+    Epd_Mode(Dev, epd_mode, &Panel_Width, &Panel_Height);
     UWORD Frame_Rate_Test_Width;
-    if(Four_Byte_Align == true){
+    if(Dev->Four_Byte_Align == true){
         Frame_Rate_Test_Width = Panel_Width - (Panel_Width % 32);
     }else{
         Frame_Rate_Test_Width = Panel_Width;
@@ -488,7 +578,6 @@ UBYTE Check_FrameRate_Example(UWORD Panel_Width, UWORD Panel_Height, UDOUBLE Tar
 
     Paint_NewImage(Refresh_FrameRate_Buf, Frame_Rate_Test_Width, Frame_Rate_Test_Height, 0, BLACK);
     Paint_SelectImage(Refresh_FrameRate_Buf);
-	Epd_Mode(epd_mode);
     Paint_SetBitsPerPixel(BitsPerPixel);
 
     Debug("Start to test Frame Rate\r\n");
@@ -505,39 +594,19 @@ UBYTE Check_FrameRate_Example(UWORD Panel_Width, UWORD Panel_Height, UDOUBLE Tar
 
         switch(BitsPerPixel){
             case 8:{
-				if(epd_mode == 2)
-					EPD_IT8951_8bp_Refresh(Refresh_FrameRate_Buf, 1280-Frame_Rate_Test_Width, 0, Frame_Rate_Test_Width,  Frame_Rate_Test_Height, false, Target_Memory_Addr);
-				else if(epd_mode == 1)
-					EPD_IT8951_8bp_Refresh(Refresh_FrameRate_Buf, 1872-Frame_Rate_Test_Width-16, 0, Frame_Rate_Test_Width,  Frame_Rate_Test_Height, false, Target_Memory_Addr);
-				else					
-					EPD_IT8951_8bp_Refresh(Refresh_FrameRate_Buf, 0, 0, Frame_Rate_Test_Width,  Frame_Rate_Test_Height, false, Target_Memory_Addr);
+                EPD_IT8951_8bp_Refresh(Dev, Refresh_FrameRate_Buf, 0, 0, Frame_Rate_Test_Width,  Frame_Rate_Test_Height, false, Target_Memory_Addr);
                 break;
             }
             case 4:{
-				if(epd_mode == 2)
-					EPD_IT8951_4bp_Refresh(Refresh_FrameRate_Buf, 1280-Frame_Rate_Test_Width, 0, Frame_Rate_Test_Width,  Frame_Rate_Test_Height, false, Target_Memory_Addr,false);
-				else if(epd_mode == 1)
-					EPD_IT8951_4bp_Refresh(Refresh_FrameRate_Buf, 1872-Frame_Rate_Test_Width-16, 0, Frame_Rate_Test_Width,  Frame_Rate_Test_Height, false, Target_Memory_Addr,false);
-				else
-					EPD_IT8951_4bp_Refresh(Refresh_FrameRate_Buf, 0, 0, Frame_Rate_Test_Width,  Frame_Rate_Test_Height, false, Target_Memory_Addr,false);
+                EPD_IT8951_4bp_Refresh(Dev, Refresh_FrameRate_Buf, 0, 0, Frame_Rate_Test_Width,  Frame_Rate_Test_Height, false, Target_Memory_Addr,false);
                 break;
             }
             case 2:{
-				if(epd_mode == 2)
-					EPD_IT8951_2bp_Refresh(Refresh_FrameRate_Buf, 1280-Frame_Rate_Test_Width, 0, Frame_Rate_Test_Width,  Frame_Rate_Test_Height, false, Target_Memory_Addr,false);
-				else if(epd_mode == 1)
-					EPD_IT8951_2bp_Refresh(Refresh_FrameRate_Buf, 1872-Frame_Rate_Test_Width-16, 0, Frame_Rate_Test_Width,  Frame_Rate_Test_Height, false, Target_Memory_Addr,false);
-				else	
-					EPD_IT8951_2bp_Refresh(Refresh_FrameRate_Buf, 0, 0, Frame_Rate_Test_Width,  Frame_Rate_Test_Height, false, Target_Memory_Addr,false);
+                EPD_IT8951_2bp_Refresh(Dev, Refresh_FrameRate_Buf, 0, 0, Frame_Rate_Test_Width,  Frame_Rate_Test_Height, false, Target_Memory_Addr,false);
                 break;
             }
             case 1:{
-				if(epd_mode == 2)
-					EPD_IT8951_1bp_Refresh(Refresh_FrameRate_Buf, 1280-Frame_Rate_Test_Width, 0, Frame_Rate_Test_Width,  Frame_Rate_Test_Height, A2_Mode, Target_Memory_Addr,false);
-				else if(epd_mode == 1)
-					EPD_IT8951_1bp_Refresh(Refresh_FrameRate_Buf, 1872-Frame_Rate_Test_Width-16, 0, Frame_Rate_Test_Width,  Frame_Rate_Test_Height, A2_Mode, Target_Memory_Addr,false);
-				else	
-					EPD_IT8951_1bp_Refresh(Refresh_FrameRate_Buf, 0, 0, Frame_Rate_Test_Width,  Frame_Rate_Test_Height, A2_Mode, Target_Memory_Addr,false);
+                EPD_IT8951_1bp_Refresh(Dev, Refresh_FrameRate_Buf, 0, 0, Frame_Rate_Test_Width,  Frame_Rate_Test_Height, Dev->A2_Mode, Target_Memory_Addr,false);
                 break;
             }
         }
@@ -559,14 +628,16 @@ UBYTE Check_FrameRate_Example(UWORD Panel_Width, UWORD Panel_Height, UDOUBLE Tar
 /******************************************************************************
 function: TouchPanel_ePaper_Example
 parameter:
+    Dev: The panel
     Panel_Width: Width of the panel
     Panel_Height: Height of the panel
     Init_Target_Memory_Addr: Memory address of IT8951 target memory address
 ******************************************************************************/
-UBYTE TouchPanel_ePaper_Example(UWORD Panel_Width, UWORD Panel_Height, UDOUBLE Init_Target_Memory_Addr){
+UBYTE TouchPanel_ePaper_Example(IT8951_Dev* Dev, UWORD Panel_Width, UWORD Panel_Height, UDOUBLE Init_Target_Memory_Addr){
+    Epd_Mode(Dev, epd_mode, &Panel_Width, &Panel_Height);
     int ret,fd;
     UWORD Touch_Pannel_Area_Width;
-    if(Four_Byte_Align == true){
+    if(Dev->Four_Byte_Align == true){
         Touch_Pannel_Area_Width = Panel_Width - (Panel_Width % 32);
     }else{
         Touch_Pannel_Area_Width = Panel_Width;
@@ -589,6 +660,10 @@ UBYTE TouchPanel_ePaper_Example(UWORD Panel_Width, UWORD Panel_Height, UDOUBLE I
     UWORD Panel_Frame_Buf_WidthByte;
     UWORD Panel_Area_Frame_Buf_WidthByte;
 
+    //strokes that come within the window share one display command
+    IT8951_Coalesce Coalesce;
+    EPD_IT8951_Coalesce_Init(&Coalesce, Dev, IT8951_COALESCE_WINDOW_MS);
+
 	if(access("/home/pi/FIFO",F_OK)){
 		ret = mkfifo("/home/pi/FIFO",0777);
 		if(ret == -1){
@@ -620,7 +695,6 @@ UBYTE TouchPanel_ePaper_Example(UWORD Panel_Width, UWORD Panel_Height, UDOUBLE I
 
     Paint_NewImage(Panel_Frame_Buf, Touch_Pannel_Area_Width, Touch_Pannel_Area_Height, 0, BLACK);
     Paint_SelectImage(Panel_Frame_Buf);
-	Epd_Mode(epd_mode);
     Paint_SetBitsPerPixel(1);
     Paint_Clear(WHITE);
 
@@ -703,7 +777,6 @@ UBYTE TouchPanel_ePaper_Example(UWORD Panel_Width, UWORD Panel_Height, UDOUBLE I
             //----------Prepare Image----------
             Paint_NewImage(Panel_Area_Frame_Buf, Width, Height, 0, BLACK);
             Paint_SelectImage(Panel_Area_Frame_Buf);
-			Epd_Mode(epd_mode);
             Paint_Clear(WHITE);
 
             Panel_Area_Frame_Buf_WidthByte = (Width % 8 == 0) ? (Width / 8 ): (Width / 8 + 1);
@@ -713,8 +786,11 @@ UBYTE TouchPanel_ePaper_Example(UWORD Panel_Width, UWORD Panel_Height, UDOUBLE I
             }
 
             //----------Display Image----------
-            EPD_IT8951_1bp_Refresh(Panel_Area_Frame_Buf, X_Start, Y_Start, Width,  Height, A2_Mode, Init_Target_Memory_Addr, true);
+            EPD_IT8951_Coalesce_Refresh(&Coalesce, 1, Panel_Area_Frame_Buf, X_Start, Y_Start, Width,  Height, Dev->A2_Mode, Init_Target_Memory_Addr);
         }
+
+        //show what was held once the window is over
+        EPD_IT8951_Coalesce_Poll(&Coalesce);
     }
 
     if( Panel_Area_Frame_Buf != NULL ){
@@ -732,11 +808,12 @@ UBYTE TouchPanel_ePaper_Example(UWORD Panel_Width, UWORD Panel_Height, UDOUBLE I
 
 
 
-static UBYTE BMP_Test(UWORD Panel_Width, UWORD Panel_Height, UDOUBLE Init_Target_Memory_Addr, UBYTE BitsPerPixel, UBYTE Pic_Count)
+static UBYTE BMP_Test(IT8951_Dev* Dev, UWORD Panel_Width, UWORD Panel_Height, UDOUBLE Init_Target_Memory_Addr, UBYTE BitsPerPixel, UBYTE Pic_Count)
 {
+    Epd_Mode(Dev, epd_mode, &Panel_Width, &Panel_Height);
     UWORD WIDTH;
 
-    if(Four_Byte_Align == true){
+    if(Dev->Four_Byte_Align == true){
         WIDTH  = Panel_Width - (Panel_Width % 32);
     }else{
         WIDTH = Panel_Width;
@@ -753,7 +830,6 @@ static UBYTE BMP_Test(UWORD Panel_Width, UWORD Panel_Height, UDOUBLE Init_Target
 
     Paint_NewImage(Refresh_Frame_Buf, WIDTH, HEIGHT, 0, BLACK);
     Paint_SelectImage(Refresh_Frame_Buf);
-	Epd_Mode(epd_mode);
     Paint_SetBitsPerPixel(BitsPerPixel);
     Paint_Clear(WHITE);
 
@@ -765,22 +841,22 @@ static UBYTE BMP_Test(UWORD Panel_Width, UWORD Panel_Height, UDOUBLE Init_Target
     switch(BitsPerPixel){
         case BitsPerPixel_8:{
             Paint_DrawString_EN(10, 10, "8 bits per pixel 16 grayscale", &Font24, 0xF0, 0x00);
-            EPD_IT8951_8bp_Refresh(Refresh_Frame_Buf, 0, 0, WIDTH,  HEIGHT, false, Init_Target_Memory_Addr);
+            EPD_IT8951_8bp_Refresh(Dev, Refresh_Frame_Buf, 0, 0, WIDTH,  HEIGHT, false, Init_Target_Memory_Addr);
             break;
         }
         case BitsPerPixel_4:{
 			Paint_DrawString_EN(10, 10, "4 bits per pixel 16 grayscale", &Font24, 0xF0, 0x00);
-            EPD_IT8951_4bp_Refresh(Refresh_Frame_Buf, 0, 0, WIDTH,  HEIGHT, false, Init_Target_Memory_Addr,false);
+            EPD_IT8951_4bp_Refresh(Dev, Refresh_Frame_Buf, 0, 0, WIDTH,  HEIGHT, false, Init_Target_Memory_Addr,false);
             break;
         }
         case BitsPerPixel_2:{
             Paint_DrawString_EN(10, 10, "2 bits per pixel 4 grayscale", &Font24, 0xC0, 0x00);
-            EPD_IT8951_2bp_Refresh(Refresh_Frame_Buf, 0, 0, WIDTH,  HEIGHT, false, Init_Target_Memory_Addr,false);
+            EPD_IT8951_2bp_Refresh(Dev, Refresh_Frame_Buf, 0, 0, WIDTH,  HEIGHT, false, Init_Target_Memory_Addr,false);
             break;
         }
         case BitsPerPixel_1:{
             Paint_DrawString_EN(10, 10, "1 bit per pixel 2 grayscale", &Font24, 0x80, 0x00);
-            EPD_IT8951_1bp_Refresh(Refresh_Frame_Buf, 0, 0, WIDTH,  HEIGHT, A2_Mode, Init_Target_Memory_Addr,false);
+            EPD_IT8951_1bp_Refresh(Dev, Refresh_Frame_Buf, 0, 0, WIDTH,  HEIGHT, Dev->A2_Mode, Init_Target_Memory_Addr,false);
             break;
         }
     }
@@ -798,45 +874,46 @@ static UBYTE BMP_Test(UWORD Panel_Width, UWORD Panel_Height, UDOUBLE Init_Target
 
 
 
-void Factory_Test_Only(IT8951_Dev_Info Dev_Info, UDOUBLE Init_Target_Memory_Addr)
+void Factory_Test_Only(IT8951_Dev* Dev, UDOUBLE Init_Target_Memory_Addr)
 {
     while(1)
     {
         for(int i=0; i < 4; i++){
-			EPD_IT8951_SystemRun();
+			EPD_IT8951_SystemRun(Dev);
 			
-			EPD_IT8951_Clear_Refresh(Dev_Info, Init_Target_Memory_Addr, GC16_Mode);
-            // BMP_Test(Dev_Info.Panel_W, Dev_Info.Panel_H, Init_Target_Memory_Addr, BitsPerPixel_1, i);
-            // BMP_Test(Dev_Info.Panel_W, Dev_Info.Panel_H, Init_Target_Memory_Addr, BitsPerPixel_2, i);
-            BMP_Test(Dev_Info.Panel_W, Dev_Info.Panel_H, Init_Target_Memory_Addr, BitsPerPixel_4, i);
-            // BMP_Test(Dev_Info.Panel_W, Dev_Info.Panel_H, Init_Target_Memory_Addr, BitsPerPixel_8, i);
-			EPD_IT8951_Clear_Refresh(Dev_Info, Init_Target_Memory_Addr, GC16_Mode);
+			EPD_IT8951_Clear_Refresh(Dev, Init_Target_Memory_Addr, Dev->GC16_Mode);
+            // BMP_Test(Dev, Dev->Info.Panel_W, Dev->Info.Panel_H, Init_Target_Memory_Addr, BitsPerPixel_1, i);
+            // BMP_Test(Dev, Dev->Info.Panel_W, Dev->Info.Panel_H, Init_Target_Memory_Addr, BitsPerPixel_2, i);
+            BMP_Test(Dev, Dev->Info.Panel_W, Dev->Info.Panel_H, Init_Target_Memory_Addr, BitsPerPixel_4, i);
+            // BMP_Test(Dev, Dev->Info.Panel_W, Dev->Info.Panel_H, Init_Target_Memory_Addr, BitsPerPixel_8, i);
+			EPD_IT8951_Clear_Refresh(Dev, Init_Target_Memory_Addr, Dev->GC16_Mode);
 			
-			EPD_IT8951_Sleep();
+			EPD_IT8951_Sleep(Dev);
 			DEV_Delay_ms(5000);
         }
-		EPD_IT8951_SystemRun();
+		EPD_IT8951_SystemRun(Dev);
 		
-		EPD_IT8951_Clear_Refresh(Dev_Info, Init_Target_Memory_Addr, A2_Mode);
-        Dynamic_Refresh_Example(Dev_Info,Init_Target_Memory_Addr);
-		EPD_IT8951_Clear_Refresh(Dev_Info, Init_Target_Memory_Addr, A2_Mode);
+		EPD_IT8951_Clear_Refresh(Dev, Init_Target_Memory_Addr, Dev->A2_Mode);
+        Dynamic_Refresh_Example(Dev, Init_Target_Memory_Addr);
+		EPD_IT8951_Clear_Refresh(Dev, Init_Target_Memory_Addr, Dev->A2_Mode);
 		
 		if(isColor) 
-			Color_Test(Dev_Info, Init_Target_Memory_Addr);
+			Color_Test(Dev, Init_Target_Memory_Addr);
 		
-		EPD_IT8951_Sleep();
+		EPD_IT8951_Sleep(Dev);
 		DEV_Delay_ms(5000);
     }
 }
 
-void Color_Test(IT8951_Dev_Info Dev_Info, UDOUBLE Init_Target_Memory_Addr)
+void Color_Test(IT8951_Dev* Dev, UDOUBLE Init_Target_Memory_Addr)
 {
 	PAINT_TIME Time = {2020, 9, 30, 18, 10, 34};
 	
 	while(1) 
 	{
-		UWORD Panel_Width = Dev_Info.Panel_W;
-		UWORD Panel_Height = Dev_Info.Panel_H;
+		UWORD Panel_Width = Dev->Info.Panel_W;
+		UWORD Panel_Height = Dev->Info.Panel_H;
+		Epd_Mode(Dev, epd_mode, &Panel_Width, &Panel_Height);
 
 		UDOUBLE Imagesize;
 
@@ -848,7 +925,6 @@ void Color_Test(IT8951_Dev_Info Dev_Info, UDOUBLE Init_Target_Memory_Addr)
 
 		Paint_NewImage(Refresh_Frame_Buf, Panel_Width, Panel_Height, 0, BLACK);
 		Paint_SelectImage(Refresh_Frame_Buf);
-		Epd_Mode(epd_mode);
 		Paint_SetBitsPerPixel(4);
 		Paint_Clear(WHITE);
 
@@ -880,7 +956,7 @@ void Color_Test(IT8951_Dev_Info Dev_Info, UDOUBLE Init_Target_Memory_Addr)
 			}
 		}
 
-		EPD_IT8951_4bp_Refresh(Refresh_Frame_Buf, 0, 0, Panel_Width,  Panel_Height, false, Init_Target_Memory_Addr, false);
+		EPD_IT8951_4bp_Refresh(Dev, Refresh_Frame_Buf, 0, 0, Panel_Width,  Panel_Height, false, Init_Target_Memory_Addr, false);
 		
 		if(Refresh_Frame_Buf != NULL) {
 			free(Refresh_Frame_Buf);
@@ -22,23 +22,23 @@ extern UBYTE *Refresh_Frame_Buf;
 extern UBYTE *Panel_Frame_Buf;
 extern UBYTE *Panel_Area_Frame_Buf;
 
-extern bool Four_Byte_Align;
+UBYTE Display_ColorPalette_Example(IT8951_Dev* Dev, UWORD Panel_Width, UWORD Panel_Height, UDOUBLE Init_Target_Memory_Addr);
 
-UBYTE Display_ColorPalette_Example(UWORD Panel_Width, UWORD Panel_Height, UDOUBLE Init_Target_Memory_Addr);
+UBYTE Display_CharacterPattern_Example(IT8951_Dev* Dev, UWORD Panel_Width, UWORD Panel_Height, UDOUBLE Init_Target_Memory_Addr, UBYTE BitsPerPixel);
 
-UBYTE Display_CharacterPattern_Example(UWORD Panel_Width, UWORD Panel_Height, UDOUBLE Init_Target_Memory_Addr, UBYTE BitsPerPixel);
+UBYTE Display_BMP_Example(IT8951_Dev* Dev, char *filename, UWORD Panel_Width, UWORD Panel_Height, UDOUBLE Init_Target_Memory_Addr, UBYTE BitsPerPixel);
 
-UBYTE Display_BMP_Example(char *filename, UWORD Panel_Width, UWORD Panel_Height, UDOUBLE Init_Target_Memory_Addr, UBYTE BitsPerPixel);
+UBYTE Dynamic_Refresh_Example(IT8951_Dev* Dev, UDOUBLE Init_Target_Memory_Addr);
 
-UBYTE Dynamic_Refresh_Example(IT8951_Dev_Info Dev_Info, UDOUBLE Init_Target_Memory_Addr);
+UBYTE Dynamic_GIF_Example(IT8951_Dev* Dev, UWORD Panel_Width, UWORD Panel_Height, UDOUBLE Init_Target_Memory_Addr);
 
-UBYTE Dynamic_GIF_Example(UWORD Panel_Width, UWORD Panel_Height, UDOUBLE Init_Target_Memory_Addr);
+UBYTE Scroll_Log_Example(IT8951_Dev* Dev, UWORD Panel_Width, UWORD Panel_Height, UDOUBLE Init_Target_Memory_Addr);
 
-UBYTE Check_FrameRate_Example(UWORD Panel_Width, UWORD Panel_Height, UDOUBLE Target_Memory_Addr, UBYTE BitsPerPixel);
+UBYTE Check_FrameRate_Example(IT8951_Dev* Dev, UWORD Panel_Width, UWORD Panel_Height, UDOUBLE Target_Memory_Addr, UBYTE BitsPerPixel);
 
-UBYTE TouchPanel_ePaper_Example(UWORD Panel_Width, UWORD Panel_Height, UDOUBLE Init_Target_Memory_Addr);
+UBYTE TouchPanel_ePaper_Example(IT8951_Dev* Dev, UWORD Panel_Width, UWORD Panel_Height, UDOUBLE Init_Target_Memory_Addr);
 
-void Factory_Test_Only(IT8951_Dev_Info Dev_Info, UDOUBLE Init_Target_Memory_Addr);
-void Color_Test(IT8951_Dev_Info Dev_Info, UDOUBLE Init_Target_Memory_Addr);
+void Factory_Test_Only(IT8951_Dev* Dev, UDOUBLE Init_Target_Memory_Addr);
+void Color_Test(IT8951_Dev* Dev, UDOUBLE Init_Target_Memory_Addr);
 
 #endif
@@ -3,6 +3,11 @@ extern "C" {
 #include "example.h"
 #include "../lib/GUI/GUI_BMPfile.h"
 #include "../lib/GUI/GUI_Paint.h"
+#include "../lib/e-Paper/EPD_IT8951_Tune.h"
+#include "../lib/e-Paper/EPD_IT8951_State.h"
+#include "../lib/e-Paper/EPD_IT8951_Power.h"
+#include "../lib/e-Paper/EPD_IT8951_Sched.h"
+#include "../lib/e-Paper/EPD_IT8951_Cache.h"
 }
 #include "../lib/Wacom/BasicTypes.h"
 #include "../lib/Wacom/WacomI2CHandler.h"
@@ -22,6 +27,9 @@ extern "C" {
 
 #define USE_Touch_Panel false
 
+//strokes that may be queued at once, each in its own sub-frame buffer
+#define INK_RING 4
+
 UWORD VCOM = 2050;
 
 const int TABLET_I2C_ADDRESS = 9;
@@ -32,6 +40,9 @@ WacomI2CHandler *tabletHandler;
 
 struct TabletData tabletData;
 
+IT8951_Dev Panel;
+IT8951_Sched Sched;             //background in stripes, pen ink in between
+IT8951_Pool Pool;               //controller memory past the display buffer
 IT8951_Dev_Info Dev_Info = {0, 0};
 UWORD Panel_Width;
 UWORD Panel_Height;
@@ -42,7 +53,13 @@ UWORD Min_Y = 0;
 UWORD Max_Y = 0;
 
 UBYTE *Refresh_Frame_Buf2 = NULL;
-UBYTE *Refresh_Frame_Buf3 = NULL;
+UBYTE *Ink_Buf[INK_RING] = {NULL};
+UBYTE Ink_Used = 0;             //Ink_Buf entries handed to the worker since the last drain
+UBYTE *Background_Buf = NULL;
+UDOUBLE Canvas_Size = 0;        //bytes in Refresh_Frame_Buf2
+
+char State_Path[64];
+bool Warm_Start = false;        //the panel still shows what the last run left
 
 UDOUBLE Init_Target_Memory_Addr;
 int epd_mode = 0;	//0: no rotate, no mirror
@@ -50,9 +67,24 @@ int epd_mode = 0;	//0: no rotate, no mirror
 					//2: no totate, horizontal mirror, for 5.17inch
 					//3: no rotate, no mirror, isColor, for 6inch color
 					
+//set by Handler, the main loop stops and shuts down in normal context
+volatile sig_atomic_t Quit = 0;
+
 void  Handler(int signo){
-    
+    Quit = 1;
+}
+
+/******************************************************************************
+function: Shutdown
+Info:
+    Stops the worker first, nothing is on the bus after that. The
+    controller is kept running for the next start when the state could
+    be saved, otherwise the panel goes to white as before storage.
+******************************************************************************/
+void Shutdown(){
     Debug("\r\nHandler:exit\r\n");
+    EPD_IT8951_Sched_Stop(&Sched);
+    tabletHandler->stop();
     if(Refresh_Frame_Buf != NULL){
         free(Refresh_Frame_Buf);
         Debug("free Refresh_Frame_Buf\r\n");
@@ -78,17 +110,68 @@ void  Handler(int signo){
         Debug("free bmp_dst_buf\r\n");
         bmp_dst_buf = NULL;
     }
-	if(Dev_Info.Panel_W != 0){
-		Debug("Going to sleep\r\n");
-		//EPD_IT8951_Sleep();
-	}
+    //keep the controller running, the next start attaches to it
+    if(Dev_Info.Panel_W != 0 && EPD_IT8951_Save_State(State_Path, &Dev_Info, Refresh_Frame_Buf2, Canvas_Size) == 0){
+        DEV_Module_Detach();
+        return;
+    }
+    if(Dev_Info.Panel_W != 0){
+        //We recommended refresh the panel to white color before storing in the warehouse.
+        EPD_IT8951_Clear_Refresh(&Panel, Init_Target_Memory_Addr, Panel.INIT_Mode);
+        EPD_IT8951_Wait_Display(&Panel);
+    }
     DEV_Module_Exit();
-    exit(0);
 }
 
 int paintBackground() {
-   Display_BMP_Example((char *)"/home/pi/Dev/docs/Notebook2.bmp", Panel_Width, Panel_Height, Init_Target_Memory_Addr, BitsPerPixel_1);
-   return(0);
+    UWORD Width = (Panel.Four_Byte_Align == true) ? Panel_Width - (Panel_Width % 32) : Panel_Width;
+    UDOUBLE Imagesize = ((Width % 8 == 0)? (Width / 8 ): (Width / 8 + 1)) * Panel_Height;
+    IT8951_Slot* Screen;
+    IT8951_Sched_Job Job;
+
+    //the last background may still be loading from the buffer, as an
+    //interactive job when it had no slot
+    EPD_IT8951_Sched_Drain(&Sched, IT8951_SCHED_BULK);
+    EPD_IT8951_Sched_Drain(&Sched, IT8951_SCHED_INTERACTIVE);
+    Ink_Used = 0;
+
+    Job.Bits_Per_Pixel = 1;
+    Job.X = 0;
+    Job.Y = 0;
+    Job.W = Width;
+    Job.H = Panel_Height;
+    Job.Mode = Panel.A2_Mode;
+    Job.Hold = false;
+    Job.Priority = IT8951_SCHED_BULK;
+
+    //loaded before, one display command from its slot
+    if((Screen = EPD_IT8951_Cache_Find(&Pool, "Notebook2")) != NULL){
+        Job.Frame_Buf = NULL;
+        Job.Target_Memory_Addr = Screen->Target_Memory_Addr;
+        return (EPD_IT8951_Sched_Submit(&Sched, 0, &Job) == 0) ? 0 : -1;
+    }
+
+    if(Background_Buf == NULL && (Background_Buf = (UBYTE *)malloc(Imagesize)) == NULL){
+        Debug("Failed to apply for background memory...\r\n");
+        return -1;
+    }
+
+    Paint_NewImage(Background_Buf, Width, Panel_Height, 0, BLACK);
+    Paint_SelectImage(Background_Buf);
+    Paint_SetBitsPerPixel(1);
+    Paint_Clear(WHITE);
+    GUI_ReadBmp("/home/pi/Dev/docs/Notebook2.bmp", 0, 0);
+
+    //decoded here, the worker loads it and lets the pen in between the stripes;
+    //kept in its own slot for the next reset when there is room
+    Screen = EPD_IT8951_Cache_Add(&Pool, "Notebook2", 1, 0, 0, Width, Panel_Height);
+    Job.Frame_Buf = Background_Buf;
+    Job.Target_Memory_Addr = (Screen != NULL) ? Screen->Target_Memory_Addr : Init_Target_Memory_Addr;
+    //without a slot it shares the pen's buffer, the stripes would overwrite
+    //the ink loaded in between: loaded in one go, in order with the pen
+    if(Screen == NULL)
+        Job.Priority = IT8951_SCHED_INTERACTIVE;
+    return (EPD_IT8951_Sched_Submit(&Sched, 0, &Job) == 0) ? 0 : -1;
 }
 
 int paintInit(UWORD Radius) {
@@ -98,15 +181,19 @@ int paintInit(UWORD Radius) {
     Debug("Paint init....\r\n");
         //malloc enough memory for 1bp picture first
     Imagesize = ((Panel_Width * 1 % 8 == 0)? (Panel_Width * 1 / 8 ): (Panel_Width * 1 / 8 + 1)) * Panel_Height;
+    Canvas_Size = Imagesize;
     //Imagesize = ((dia * 1 % 8 == 0)? (dia * 1 / 8 ): (dia * 1 / 8 + 1)) * dia;
-    if((Refresh_Frame_Buf2 = (UBYTE *)malloc(Imagesize)) == NULL){
+    //kept over a reset, only the first call allocates
+    if(Refresh_Frame_Buf2 == NULL && (Refresh_Frame_Buf2 = (UBYTE *)malloc(Imagesize)) == NULL){
         Debug("Failed to apply for picture memory...\r\n");
         return -1;
     }
 
-    if((Refresh_Frame_Buf3 = (UBYTE *)malloc(Imagesize)) == NULL){
-        Debug("Failed to apply for picture memory...\r\n");
-        return -1;
+    for(UBYTE i = 0; i < INK_RING; i++){
+        if(Ink_Buf[i] == NULL && (Ink_Buf[i] = (UBYTE *)malloc(Imagesize)) == NULL){
+            Debug("Failed to apply for picture memory...\r\n");
+            return -1;
+        }
     }
 
     Paint_NewImage(Refresh_Frame_Buf2, Panel_Width, Panel_Height, 0, BLACK);
@@ -124,6 +211,9 @@ int paintInit(UWORD Radius) {
 }
 
 int addBrushPoint(UWORD x, UWORD y, UWORD Radius) {
+    //a refresh is queued, make sure the panel is up when it goes out
+    EPD_IT8951_Power_Hint(&Panel);
+
     Paint_DrawCircle(x, y, Radius, 0x00, DOT_PIXEL_1X1, DRAW_FILL_FULL);
     UWORD xval;
 
@@ -185,14 +275,31 @@ int paintBrush() {
     y = Min_Y;
     width = Max_X - x;
     height = Max_Y - y;
-    subFrame(Refresh_Frame_Buf2, Paint.WidthByte, Refresh_Frame_Buf3, x, y, width, height);
+    //only wait for the worker when every buffer still holds a queued stroke
+    if(Ink_Used == INK_RING){
+        EPD_IT8951_Sched_Drain(&Sched, IT8951_SCHED_INTERACTIVE);
+        Ink_Used = 0;
+    }
+    UBYTE *Ink = Ink_Buf[Ink_Used++];
+    subFrame(Refresh_Frame_Buf2, Paint.WidthByte, Ink, x, y, width, height);
     Min_X = Panel_Width;
     Min_Y = Panel_Height;
     Max_X = 0;
     Max_Y = 0;
         
     //Debug("Painting Brush: %d %d %d %d\r\n", Min_X, Min_Y, width, height);
-    EPD_IT8951_1bp_Refresh(Refresh_Frame_Buf3, x, y, width,  height, A2_Mode, Init_Target_Memory_Addr, true);
+    IT8951_Sched_Job Job;
+    Job.Bits_Per_Pixel = 1;
+    Job.Frame_Buf = Ink;
+    Job.X = x;
+    Job.Y = y;
+    Job.W = width;
+    Job.H = height;
+    Job.Mode = Panel.A2_Mode;
+    Job.Hold = false;
+    Job.Target_Memory_Addr = Init_Target_Memory_Addr;
+    Job.Priority = IT8951_SCHED_INTERACTIVE;
+    EPD_IT8951_Sched_Submit(&Sched, 0, &Job);
         
     return(0);
 }
@@ -217,15 +324,20 @@ void updateDisplay() {
 int handleTasks() {
     bool resetDisplay = false;
 
-    while(1){
+    while(!Quit){
         //Debug("Query pen data...\r\n");
         tabletHandler->queryPenData();
 
+        //the pen is near, wake the panel before the first stroke needs it
+        if (tabletData.inProximity) {
+                EPD_IT8951_Power_Hint(&Panel);
+        }
+
         if (tabletData.touchDown) {
                 addBrushPoint(tabletData.transformedX, tabletData.transformedY, brush_Radius);
                 if ((tabletData.transformedX < 100) && (resetDisplay == false)) {
                         resetDisplay = true;
-                        //EPD_IT8951_Clear_Refresh(Dev_Info, Init_Target_Memory_Addr, INIT_Mode);
+                        //EPD_IT8951_Clear_Refresh(&Panel, Init_Target_Memory_Addr, Panel.INIT_Mode);
                         paintBackground();
                         paintInit(brush_Radius);
                 } else if (tabletData.transformedX > 100) {
@@ -233,6 +345,12 @@ int handleTasks() {
                 }
         }
 
+        //ink goes out ahead of a background that is still loading
+        paintBrush();
+
+        //standby / sleep once nothing was drawn for a while
+        EPD_IT8951_Power_Poll(&Panel);
+
         if(deviceInfo.refreshRateUS > 0){
             usleep(deviceInfo.refreshRateUS);
         }
@@ -248,6 +366,7 @@ int main(int argc, char *argv[])
 {
     //Exception handling:ctrl + c
     signal(SIGINT, Handler);
+    signal(SIGTERM, Handler);
     int screen = 2;
     int status; 
 
@@ -280,8 +399,13 @@ int main(int argc, char *argv[])
     Debug("Display mode:%d\r\n", epd_mode);
     Debug("Refresh Rate: %d\r\n", deviceInfo.refreshRateUS);
 
-    swapSCREEN(screen);   //select the screen IO pins
-    Dev_Info = EPD_IT8951_Init(VCOM);           // must reinitalize to work properly after swap I don't think all of the routines in this function are necessary here, it currently takes a few seconds for this funciton to run
+    //select the screen IO pins
+    DEV_PINS Pins;
+    DEV_Get_Screen_Pins(screen, &Pins);
+    EPD_IT8951_Open(&Panel, &Pins);
+    //a restart takes over the running controller, a cold start resets and reads it
+    snprintf(State_Path, sizeof(State_Path), IT8951_STATE_PATH, screen);
+    Dev_Info = EPD_IT8951_Warm_Init(&Panel, VCOM, State_Path, &Warm_Start);
 
     tabletHandler = new WacomI2CHandler(&deviceInfo, &tabletData);
     tabletHandler->init();
@@ -294,34 +418,46 @@ int main(int argc, char *argv[])
     Panel_Width = Dev_Info.Panel_W;
     Panel_Height = Dev_Info.Panel_H;
     Init_Target_Memory_Addr = Dev_Info.Memory_Addr_L | (Dev_Info.Memory_Addr_H << 16);
+
+    //fastest verified SPI clocks for this panel; tried out past the image
+    //buffer, which a warm start still shows, before the pool hands it out
+    EPD_IT8951_Auto_SPI(&Panel, Init_Target_Memory_Addr + (UDOUBLE)Panel.Image_Pitch * Panel_Height);
     char* LUT_Version = (char*)"M841_TFA2812";
     Debug("LUT Mod Version = %s\r\n", LUT_Version);
-    A2_Mode = 6;
-    Debug("A2 Mode:%d\r\n", A2_Mode);
+    Panel.A2_Mode = 6;
+    Debug("A2 Mode:%d\r\n", Panel.A2_Mode);
 
-    //clear the screen
-    EPD_IT8951_Clear_Refresh(Dev_Info, Init_Target_Memory_Addr, INIT_Mode);
+    EPD_IT8951_Pool_Init(&Pool, &Panel, 0, NULL, NULL);
 
-    //display the background
-    paintBackground();
-
-    paintInit(brush_Radius);
+    IT8951_Dev* Devs[1] = {&Panel};
+    if(EPD_IT8951_Sched_Start(&Sched, Devs, 1) != 0){
+        DEV_Module_Exit();
+        return -1;
+    }
 
-    //process the loop
-    handleTasks();
+    if(!Warm_Start){
+        //clear the screen
+        EPD_IT8951_Clear_Refresh(&Panel, Init_Target_Memory_Addr, Panel.INIT_Mode);
 
-    //We recommended refresh the panel to white color before storing in the warehouse.
-    EPD_IT8951_Clear_Refresh(Dev_Info, Init_Target_Memory_Addr, INIT_Mode);
+        //display the background
+        paintBackground();
+    }
 
-    tabletHandler->stop();
+    paintInit(brush_Radius);
 
-    //EPD_IT8951_Standby();
-    //EPD_IT8951_Sleep();
+    //continue drawing on the canvas of the last run, the panel shows it already
+    if(Warm_Start && EPD_IT8951_Load_State(State_Path, NULL, Refresh_Frame_Buf2, Canvas_Size) != 0){
+        EPD_IT8951_Clear_Refresh(&Panel, Init_Target_Memory_Addr, Panel.INIT_Mode);
+        //paintBackground leaves Paint on its own buffer, the pen draws
+        //on the canvas
+        paintBackground();
+        paintInit(brush_Radius);
+    }
 
-    //In case RPI is transmitting image in no hold mode, which requires at most 10s
-    DEV_Delay_ms(5000);
+    //process the loop until a signal asks to stop
+    handleTasks();
 
-    DEV_Module_Exit();
+    Shutdown();
     return 0;
 }
 
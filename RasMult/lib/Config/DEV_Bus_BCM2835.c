@@ -0,0 +1,137 @@
+/*****************************************************************************
+* | File      	:   DEV_Bus_BCM2835.c
+* | Author      :   IT8951-ePaper contributors
+* | Function    :   libbcm2835 bus backend
+* | Info        :
+*                Memory mapped GPIO and SPI through libbcm2835, only built
+*                with USELIB=USE_BCM2835_LIB
+*----------------
+* |	This version:   V1.0
+* | Date        :   2026-10-18
+* | Info        :
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documnetation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to  whom the Software is
+# furished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS OR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+# THE SOFTWARE.
+#
+******************************************************************************/
+#include "DEV_Config.h"
+
+#ifdef USE_BCM2835_LIB
+
+//0 keeps the divider set in BCM2835_Init
+static UDOUBLE Write_Hz = 0;
+static UDOUBLE Read_Hz = 0;
+static UDOUBLE Current_Hz = 0;
+
+static void BCM2835_Use_Speed(UDOUBLE Hz)
+{
+	if(Hz != 0 && Hz != Current_Hz) {
+		bcm2835_spi_set_speed_hz(Hz);
+		Current_Hz = Hz;
+	}
+}
+
+static UBYTE BCM2835_Init(void)
+{
+	if(!bcm2835_init()) {
+		return 1;
+	}
+
+	bcm2835_spi_begin();                                         //Start spi interface, set spi pin for the reuse function
+	bcm2835_spi_setBitOrder(BCM2835_SPI_BIT_ORDER_MSBFIRST);     //High first transmission
+	bcm2835_spi_setDataMode(BCM2835_SPI_MODE0);                  //spi mode 0
+	//bcm2835_spi_setClockDivider(BCM2835_SPI_CLOCK_DIVIDER_16);   //For RPi3/3B/3B+
+	bcm2835_spi_setClockDivider(BCM2835_SPI_CLOCK_DIVIDER_64);   //For RPi 4
+	/* SPI clock reference link：*/
+	/*http://www.airspayce.com/mikem/bcm2835/group__constants.html#gaf2e0ca069b8caef24602a02e8a00884e*/
+	return 0;
+}
+
+static void BCM2835_Exit(void)
+{
+	bcm2835_spi_end();
+	bcm2835_close();
+}
+
+static void BCM2835_GPIO_Mode(UWORD Pin, UWORD Mode)
+{
+	if(Mode == DEV_GPIO_INPUT) {
+		bcm2835_gpio_fsel(Pin, BCM2835_GPIO_FSEL_INPT);
+	} else {
+		bcm2835_gpio_fsel(Pin, BCM2835_GPIO_FSEL_OUTP);
+	}
+}
+
+static void BCM2835_Digital_Write(UWORD Pin, UBYTE Value)
+{
+	bcm2835_gpio_write(Pin, Value);
+}
+
+static UBYTE BCM2835_Digital_Read(UWORD Pin)
+{
+	return bcm2835_gpio_lev(Pin);
+}
+
+static UBYTE BCM2835_SPI_Transfer(UBYTE Value)
+{
+	BCM2835_Use_Speed(Read_Hz);
+	return bcm2835_spi_transfer(Value);
+}
+
+static void BCM2835_SPI_Write_nByte(UBYTE *pData, UDOUBLE Len)
+{
+	BCM2835_Use_Speed(Write_Hz);
+	bcm2835_spi_writenb((const char *)pData, Len);
+}
+
+static void BCM2835_SPI_Read_nByte(UBYTE *pData, UDOUBLE Len)
+{
+	BCM2835_Use_Speed(Read_Hz);
+	memset(pData, 0, Len);
+	bcm2835_spi_transfern((char *)pData, Len);
+}
+
+static void BCM2835_SPI_Set_Speed(UDOUBLE Write, UDOUBLE Read)
+{
+	Write_Hz = Write;
+	Read_Hz = Read;
+}
+
+static void BCM2835_Delay_us(UDOUBLE xus)
+{
+	if(xus >= 1000)
+		bcm2835_delay(xus / 1000);
+	bcm2835_delayMicroseconds(xus % 1000);
+}
+
+const DEV_BUS DEV_Bus_BCM2835 = {
+	.Name            = "bcm2835",
+	.Init            = BCM2835_Init,
+	.Exit            = BCM2835_Exit,
+	.GPIO_Mode       = BCM2835_GPIO_Mode,
+	.Digital_Write   = BCM2835_Digital_Write,
+	.Digital_Read    = BCM2835_Digital_Read,
+	.SPI_Transfer    = BCM2835_SPI_Transfer,
+	.SPI_Write_nByte = BCM2835_SPI_Write_nByte,
+	.SPI_Read_nByte  = BCM2835_SPI_Read_nByte,
+	.SPI_Set_Speed   = BCM2835_SPI_Set_Speed,
+	.Delay_us        = BCM2835_Delay_us,
+	.Wait_Level      = NULL,
+};
+
+#endif
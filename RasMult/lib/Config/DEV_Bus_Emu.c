@@ -0,0 +1,863 @@
+/*****************************************************************************
+* | File      	:   DEV_Bus_Emu.c
+* | Author      :   IT8951-ePaper contributors
+* | Function    :   In-process IT8951 emulator bus backend
+* | Info        :
+*                Decodes the SPI byte stream like three IT8951s behind
+*                EPD_CS_PIN_1..3 would, keeps their SDRAM and panel image,
+*                and models HRDY and LUTAFSR timing
+*----------------
+* |	This version:   V1.0
+* | Date        :   2026-10-18
+* | Info        :
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documnetation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to  whom the Software is
+# furished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS OR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+# THE SOFTWARE.
+#
+******************************************************************************/
+#include "DEV_Config.h"
+#include <time.h>
+#include <pthread.h>
+
+#define EMU_SCREENS      3
+#define EMU_ENGINES      16      //LUT engines, one LUTAFSR bit each
+#define EMU_REGS         0x2000  //register space, in bytes
+#define EMU_REG_MEM_BASE 0x18000000
+
+//register addresses the model acts on, as in EPD_IT8951.h
+#define EMU_I80CPCR      0x0004
+#define EMU_LISAR        0x0208
+#define EMU_UP1SR_H      0x113A
+#define EMU_LUTAFSR      0x1224
+#define EMU_BGVR         0x1250
+
+typedef struct {
+	UWORD X, Y, W, H;
+	uint64_t Until_us;
+} EMU_ENGINE;
+
+typedef struct {
+	UWORD CS_Pin, Busy_Pin, Rst_Pin;
+	UBYTE Selected;
+	UBYTE In_Reset;
+	UBYTE Sleeping;
+	uint64_t Busy_Until_us;             //HRDY low until then
+
+	//transaction being decoded
+	UWORD Preamble;                     //0xFFFF until the first word
+	UBYTE Have_Byte, First_Byte;
+	UDOUBLE Read_Bytes;                 //bytes clocked in this read transaction
+	UWORD Read_Word;
+
+	//command being decoded
+	UWORD Cmd;
+	UWORD Args[8];
+	UBYTE Arg_Count, Arg_Need;
+	UDOUBLE Next_Read;                  //index into what the command returns
+
+	//LD_IMG / LD_IMG_AREA
+	UBYTE Load_Active, Load_Bpp, Load_Rotate, Load_Little;
+	UWORD Load_X, Load_Y, Load_W, Load_H, Load_Row_Pixels;
+	UDOUBLE Load_Col, Load_Row, Load_Addr;
+
+	//MEM_BST_*
+	UDOUBLE Burst_Addr;
+
+	UWORD VCOM;
+	UWORD Reg[EMU_REGS / 2];
+	UBYTE *SDRAM;
+	UDOUBLE SDRAM_Size;
+	UBYTE *Panel;
+	UBYTE Shown;                        //a display command has run since init
+	EMU_ENGINE Engine[EMU_ENGINES];
+	DEV_EMU_STATS Stats;
+} EMU_CTRL;
+
+static EMU_CTRL Emu[EMU_SCREENS];
+static pthread_mutex_t Emu_Lock = PTHREAD_MUTEX_INITIALIZER;
+static UWORD Emu_Panel_W = DEV_EMU_PANEL_W;
+static UWORD Emu_Panel_H = DEV_EMU_PANEL_H;
+static UDOUBLE Emu_SDRAM_Size = DEV_EMU_SDRAM_SIZE;
+static double Emu_Time_Scale = 1.0;
+static UDOUBLE Emu_Write_Hz = DEV_SPI_SPEED_HZ;
+static UDOUBLE Emu_Read_Hz = DEV_SPI_SPEED_HZ;
+
+//waveform time per display mode, in ms, for the usual LUT order
+//INIT, DU, GC16, GL16, GLR16, GLD16, A2, DU4; other modes take GC16's
+static const UWORD Emu_Wave_ms[8] = {2000, 260, 450, 450, 450, 450, 120, 290};
+
+static uint64_t Emu_Scaled(uint64_t Time_us)
+{
+	return (uint64_t)(Time_us * Emu_Time_Scale);
+}
+
+static void Emu_Error(EMU_CTRL *C, const char *What)
+{
+	C->Stats.Errors++;
+	Debug("Emu CS %d: %s, command 0x%04x\r\n", C->CS_Pin, What, C->Cmd);
+}
+
+/******************************************************************************
+function:	Power up or reset release
+parameter:
+Info:
+	The SDRAM and the panel keep their contents, the registers do not
+******************************************************************************/
+static void Emu_Boot(EMU_CTRL *C, uint64_t Now)
+{
+	memset(C->Reg, 0, sizeof(C->Reg));
+	memset(C->Engine, 0, sizeof(C->Engine));
+	C->Cmd = 0;
+	C->Arg_Count = C->Arg_Need = 0;
+	C->Load_Active = 0;
+	C->Sleeping = 0;
+	C->VCOM = 1500;
+	C->Busy_Until_us = Now + Emu_Scaled(DEV_EMU_BOOT_US);
+}
+
+static UWORD Emu_Engines_Busy(EMU_CTRL *C, uint64_t Now)
+{
+	UWORD Status = 0;
+
+	for(int i = 0; i < EMU_ENGINES; i++)
+		if(C->Engine[i].Until_us > Now)
+			Status |= 1 << i;
+	return Status;
+}
+
+static UWORD Emu_Reg_Read(EMU_CTRL *C, UDOUBLE Addr)
+{
+	if(Addr == EMU_LUTAFSR)
+		return Emu_Engines_Busy(C, DEV_Time_us());
+	if(Addr >= EMU_REGS)
+		return 0;
+	return C->Reg[Addr / 2];
+}
+
+static void Emu_Reg_Write(EMU_CTRL *C, UDOUBLE Addr, UWORD Value)
+{
+	if(Addr >= EMU_REGS || Addr == EMU_LUTAFSR)
+		return;
+	C->Reg[Addr / 2] = Value;
+}
+
+//one byte of SDRAM, or of the register space mapped above it
+static UBYTE *Emu_Mem(EMU_CTRL *C, UDOUBLE Addr)
+{
+	if(Addr >= C->SDRAM_Size)
+		return NULL;
+	return &C->SDRAM[Addr];
+}
+
+/******************************************************************************
+function:	Show an area
+parameter:
+	Addr : image buffer, Image pitch is the panel width
+Info:
+	The panel takes the final image at once, the waveform only keeps a
+	LUT engine busy. 1bpp mode reads one bit per pixel, first pixel in
+	bit 0, and shows it through BGVR: a set bit as the low byte, a clear
+	one as the high byte, which is how the 1bpp paths of the driver use it.
+******************************************************************************/
+static void Emu_Display(EMU_CTRL *C, UWORD X, UWORD Y, UWORD W, UWORD H, UWORD Mode, UDOUBLE Addr)
+{
+	uint64_t Now = DEV_Time_us(), Start = Now, Wave_us;
+	UBYTE One_Bit = (C->Reg[EMU_UP1SR_H / 2] & (1 << 2)) != 0;
+	UWORD BGVR = C->Reg[EMU_BGVR / 2];
+	EMU_ENGINE *E = NULL;
+	UBYTE *Src, Gray;
+
+	C->Stats.Displays++;
+	C->Shown = 1;
+	if(X + W > Emu_Panel_W || Y + H > Emu_Panel_H || W == 0 || H == 0) {
+		Emu_Error(C, "display area outside the panel");
+		return;
+	}
+
+	for(UWORD y = Y; y < Y + H; y++) {
+		for(UWORD x = X; x < X + W; x++) {
+			if(One_Bit) {
+				Src = Emu_Mem(C, Addr + (UDOUBLE)y * Emu_Panel_W + x / 8);
+				if(Src == NULL)
+					break;
+				Gray = ((*Src >> (x % 8)) & 1) ? (BGVR & 0xFF) : (BGVR >> 8);
+			} else {
+				Src = Emu_Mem(C, Addr + (UDOUBLE)y * Emu_Panel_W + x);
+				if(Src == NULL)
+					break;
+				Gray = *Src;
+			}
+			switch(Mode) {
+			case 0:                 //INIT
+				Gray = 0xFF;
+				break;
+			case 1:                 //DU
+			case 6:                 //A2
+				Gray = (Gray & 0x80) ? 0xFF : 0x00;
+				break;
+			case 7:                 //DU4
+				Gray = (Gray >> 6) * 0x55;
+				break;
+			default:
+				Gray = (Gray & 0xF0) | (Gray >> 4);
+				break;
+			}
+			C->Panel[(UDOUBLE)y * Emu_Panel_W + x] = Gray;
+		}
+	}
+
+	//a waveform over one still running, the controller would hold it back
+	for(int i = 0; i < EMU_ENGINES; i++) {
+		EMU_ENGINE *R = &C->Engine[i];
+		if(R->Until_us > Now && X < R->X + R->W && R->X < X + W && Y < R->Y + R->H && R->Y < Y + H) {
+			C->Stats.Overlaps++;
+			break;
+		}
+	}
+
+	//all engines taken, HRDY stays low until one is free
+	for(int i = 0; i < EMU_ENGINES; i++) {
+		if(E == NULL || C->Engine[i].Until_us < E->Until_us)
+			E = &C->Engine[i];
+	}
+	if(E->Until_us > Start) {
+		Start = E->Until_us;
+		if(Start > C->Busy_Until_us)
+			C->Busy_Until_us = Start;
+	}
+
+	Wave_us = Emu_Scaled((uint64_t)(Mode < 8 ? Emu_Wave_ms[Mode] : Emu_Wave_ms[2]) * 1000);
+	E->X = X;
+	E->Y = Y;
+	E->W = W;
+	E->H = H;
+	E->Until_us = Start + Wave_us;
+	C->Stats.Waveform_us += Wave_us;
+}
+
+/******************************************************************************
+function:	Start of LD_IMG / LD_IMG_AREA
+parameter:
+Info:
+	Rows are padded to whole words. With the little endian type the low
+	byte of a word holds the first pixels, with big endian the first byte
+	on the wire; inside a byte the first pixel is in the low bits. The
+	rotation maps the area into the buffer clockwise.
+******************************************************************************/
+static void Emu_Load_Start(EMU_CTRL *C, UWORD Info, UWORD X, UWORD Y, UWORD W, UWORD H)
+{
+	static const UBYTE Bpp[4] = {2, 4, 4, 8};     //3bpp comes in 4 bit slots
+
+	C->Load_Active = 1;
+	C->Load_Little = ((Info >> 8) & 1) == 0;
+	C->Load_Bpp = Bpp[(Info >> 4) & 3];
+	C->Load_Rotate = Info & 3;
+	C->Load_X = X;
+	C->Load_Y = Y;
+	C->Load_W = W;
+	C->Load_H = H;
+	C->Load_Row_Pixels = (((UDOUBLE)W * C->Load_Bpp + 15) / 16) * 16 / C->Load_Bpp;
+	C->Load_Col = 0;
+	C->Load_Row = 0;
+	C->Load_Addr = C->Reg[EMU_LISAR / 2] | ((UDOUBLE)C->Reg[(EMU_LISAR + 2) / 2] << 16);
+}
+
+static void Emu_Load_Pixel(EMU_CTRL *C, UBYTE Value)
+{
+	UDOUBLE X = C->Load_X + C->Load_Col, Y = C->Load_Y + C->Load_Row, Mem_X, Mem_Y;
+	UBYTE *Dst;
+
+	if(C->Load_Col >= C->Load_W)
+		return;
+
+	switch(C->Load_Rotate) {
+	case 1:
+		Mem_X = Emu_Panel_W - 1 - Y;
+		Mem_Y = X;
+		break;
+	case 2:
+		Mem_X = Emu_Panel_W - 1 - X;
+		Mem_Y = Emu_Panel_H - 1 - Y;
+		break;
+	case 3:
+		Mem_X = Y;
+		Mem_Y = Emu_Panel_H - 1 - X;
+		break;
+	default:
+		Mem_X = X;
+		Mem_Y = Y;
+		break;
+	}
+	if(Mem_X >= Emu_Panel_W || Mem_Y >= Emu_Panel_H
+	   || (Dst = Emu_Mem(C, C->Load_Addr + Mem_Y * Emu_Panel_W + Mem_X)) == NULL) {
+		Emu_Error(C, "pixel outside the image buffer");
+		return;
+	}
+	*Dst = Value;
+	C->Stats.Pixels_Loaded++;
+}
+
+static void Emu_Load_Word(EMU_CTRL *C, UWORD Word)
+{
+	UBYTE Bytes[2], Bpp = C->Load_Bpp, Mask = (1 << Bpp) - 1;
+
+	if(C->Load_Row >= C->Load_H) {
+		Emu_Error(C, "more pixels than the area holds");
+		C->Load_Active = 0;
+		return;
+	}
+
+	Bytes[0] = C->Load_Little ? Word : Word >> 8;
+	Bytes[1] = C->Load_Little ? Word >> 8 : Word;
+	for(int b = 0; b < 2; b++) {
+		for(int Shift = 0; Shift < 8; Shift += Bpp) {
+			UBYTE Value = (Bytes[b] >> Shift) & Mask;
+			Emu_Load_Pixel(C, Bpp == 8 ? Value : (UBYTE)(Value << (8 - Bpp)));
+			if(++C->Load_Col == C->Load_Row_Pixels) {
+				C->Load_Col = 0;
+				C->Load_Row++;
+			}
+		}
+	}
+}
+
+/******************************************************************************
+function:	A command word
+parameter:
+Info:
+	Arguments, pixels and burst data come in the data transactions after it
+******************************************************************************/
+static void Emu_Command(EMU_CTRL *C, UWORD Cmd)
+{
+	C->Stats.Commands++;
+	if(C->Sleeping && Cmd != 0x0001) {
+		Emu_Error(C, "command while asleep");
+		return;
+	}
+	if(C->Load_Active && Cmd != 0x0022)
+		Emu_Error(C, "LD_IMG not ended");
+
+	C->Cmd = Cmd;
+	C->Arg_Count = 0;
+	C->Next_Read = 0;
+	C->Load_Active = 0;
+	switch(Cmd) {
+	case 0x0001:                //SYS_RUN
+		if(C->Sleeping)
+			C->Busy_Until_us = DEV_Time_us() + Emu_Scaled(DEV_EMU_WAKE_US);
+		C->Sleeping = 0;
+		C->Arg_Need = 0;
+		break;
+	case 0x0002:                //STANDBY
+	case 0x0003:                //SLEEP
+		C->Sleeping = 1;
+		C->Arg_Need = 0;
+		break;
+	case 0x0010:                //REG_RD
+		C->Arg_Need = 1;
+		break;
+	case 0x0011:                //REG_WR
+		C->Arg_Need = 2;
+		break;
+	case 0x0012:                //MEM_BST_RD_T
+	case 0x0014:                //MEM_BST_WR
+		C->Arg_Need = 4;
+		break;
+	case 0x0013:                //MEM_BST_RD_S
+	case 0x0015:                //MEM_BST_END
+	case 0x0302:                //GET_DEV_INFO
+		C->Arg_Need = 0;
+		break;
+	case 0x0020:                //LD_IMG
+		C->Arg_Need = 1;
+		break;
+	case 0x0021:                //LD_IMG_AREA
+	case 0x0034:                //DPY_AREA
+		C->Arg_Need = 5;
+		break;
+	case 0x0022:                //LD_IMG_END
+		C->Arg_Need = 0;
+		break;
+	case 0x0037:                //DPY_BUF_AREA
+		C->Arg_Need = 7;
+		break;
+	case 0x0039:                //VCOM, 0 reads it, 1 and a value sets it
+		C->Arg_Need = 1;
+		break;
+	default:
+		Emu_Error(C, "unknown command");
+		C->Arg_Need = 0;
+		break;
+	}
+}
+
+static void Emu_Args_Done(EMU_CTRL *C)
+{
+	UWORD *A = C->Args;
+
+	switch(C->Cmd) {
+	case 0x0011:
+		Emu_Reg_Write(C, A[0], A[1]);
+		break;
+	case 0x0012:
+	case 0x0014:
+		C->Burst_Addr = A[0] | ((UDOUBLE)A[1] << 16);
+		break;
+	case 0x0020:
+		if((A[0] & 3) == 1 || (A[0] & 3) == 3)
+			Emu_Load_Start(C, A[0], 0, 0, Emu_Panel_H, Emu_Panel_W);
+		else
+			Emu_Load_Start(C, A[0], 0, 0, Emu_Panel_W, Emu_Panel_H);
+		break;
+	case 0x0021:
+		Emu_Load_Start(C, A[0], A[1], A[2], A[3], A[4]);
+		break;
+	case 0x0034:
+		Emu_Display(C, A[0], A[1], A[2], A[3], A[4], DEV_EMU_IMAGE_ADDR);
+		break;
+	case 0x0037:
+		Emu_Display(C, A[0], A[1], A[2], A[3], A[4], A[5] | ((UDOUBLE)A[6] << 16));
+		break;
+	case 0x0039:
+		if(C->Arg_Need == 1 && A[0] == 1) {
+			C->Arg_Need = 2;
+			return;
+		}
+		if(C->Arg_Need == 2)
+			C->VCOM = A[1];
+		break;
+	}
+}
+
+//a data word that is not an argument
+static void Emu_Payload(EMU_CTRL *C, UWORD Word)
+{
+	UBYTE *Dst;
+
+	if(C->Load_Active) {
+		Emu_Load_Word(C, Word);
+	} else if(C->Cmd == 0x0014) {
+		if(C->Burst_Addr >= EMU_REG_MEM_BASE) {
+			Emu_Reg_Write(C, C->Burst_Addr - EMU_REG_MEM_BASE, Word);
+		} else if((Dst = Emu_Mem(C, C->Burst_Addr + 1)) != NULL) {
+			Dst[-1] = Word;
+			Dst[0] = Word >> 8;
+		} else {
+			Emu_Error(C, "burst outside the SDRAM");
+		}
+		C->Burst_Addr += 2;
+	} else {
+		Emu_Error(C, "data without a command that takes it");
+	}
+}
+
+static void Emu_Word(EMU_CTRL *C, UWORD Word)
+{
+	if(C->Preamble == 0xFFFF) {
+		C->Preamble = Word;
+		if(Word != 0x6000 && Word != 0x0000 && Word != 0x1000)
+			Emu_Error(C, "bad preamble");
+		return;
+	}
+	if(C->Preamble == 0x6000) {
+		Emu_Command(C, Word);
+	} else if(C->Preamble == 0x0000) {
+		if(C->Sleeping)
+			return;
+		if(C->Arg_Count < C->Arg_Need) {
+			C->Args[C->Arg_Count++] = Word;
+			if(C->Arg_Count == C->Arg_Need)
+				Emu_Args_Done(C);
+		} else {
+			Emu_Payload(C, Word);
+		}
+	}
+}
+
+//what the last command returns, word by word
+static UWORD Emu_Read_Word(EMU_CTRL *C)
+{
+	UDOUBLE i = C->Next_Read++;
+	UDOUBLE Addr;
+	UBYTE *Src;
+
+	switch(C->Cmd) {
+	case 0x0010:
+		return Emu_Reg_Read(C, C->Args[0]);
+	case 0x0013:
+		Addr = C->Burst_Addr + i * 2;
+		if(Addr >= EMU_REG_MEM_BASE)
+			return Emu_Reg_Read(C, Addr - EMU_REG_MEM_BASE);
+		if((Src = Emu_Mem(C, Addr + 1)) == NULL)
+			return 0;
+		return Src[-1] | (Src[0] << 8);
+	case 0x0039:
+		return C->VCOM;
+	case 0x0302: {
+		//Panel_W, Panel_H, Memory_Addr_L, _H, FW_Version[8], LUT_Version[8]
+		static const char Version[] = "emu";
+		if(i == 0) return Emu_Panel_W;
+		if(i == 1) return Emu_Panel_H;
+		if(i == 2) return DEV_EMU_IMAGE_ADDR & 0xFFFF;
+		if(i == 3) return DEV_EMU_IMAGE_ADDR >> 16;
+		i = (i - 4) % 8 * 2;
+		//strings are read into host order on a little endian host
+		return (i < sizeof(Version) ? Version[i] : 0) | ((i + 1 < sizeof(Version) ? Version[i + 1] : 0) << 8);
+	}
+	}
+	Emu_Error(C, "read without a command that returns data");
+	return 0;
+}
+
+/******************************************************************************
+function:	One byte on the wire
+parameter:
+Info:
+	Written to every selected controller; a read answers from the first
+******************************************************************************/
+static UBYTE Emu_Byte(UBYTE Out)
+{
+	UBYTE In = 0, Answered = 0;
+
+	for(int i = 0; i < EMU_SCREENS; i++) {
+		EMU_CTRL *C = &Emu[i];
+		if(!C->Selected || C->In_Reset)
+			continue;
+
+		if(C->Preamble == 0x1000) {
+			if(Answered) {
+				Emu_Error(C, "read with several controllers selected");
+				continue;
+			}
+			Answered = 1;
+			C->Stats.Bytes_Read++;
+			//a dummy word comes first
+			if(C->Read_Bytes < 2) {
+				C->Read_Bytes++;
+				continue;
+			}
+			if(C->Read_Bytes++ % 2 == 0) {
+				C->Read_Word = Emu_Read_Word(C);
+				In = C->Read_Word >> 8;
+			} else {
+				In = C->Read_Word;
+			}
+			continue;
+		}
+
+		C->Stats.Bytes_Written++;
+		if(!C->Have_Byte) {
+			C->First_Byte = Out;
+			C->Have_Byte = 1;
+		} else {
+			C->Have_Byte = 0;
+			Emu_Word(C, (C->First_Byte << 8) | Out);
+		}
+	}
+	return In;
+}
+
+static void Emu_Wire(UDOUBLE Len, UDOUBLE Hz)
+{
+	for(int i = 0; i < EMU_SCREENS; i++)
+		if(Emu[i].Selected && Hz != 0)
+			Emu[i].Stats.Wire_ns += (uint64_t)Len * 8 * 1000000000 / Hz;
+}
+
+/******************************************************************************
+function:	Configuration and results
+parameter:
+	Screen : 1..3 as in DEV_Get_Screen_Pins
+Info:
+	Panel size, SDRAM size and time scale are taken at DEV_Module_Init,
+	from $EPD_EMU_PANEL ("1872x1404"), $EPD_EMU_SDRAM ("4M", "512K" or
+	bytes) and $EPD_EMU_TIME_SCALE when set. A time scale of 0.1 runs
+	every modeled wait ten times faster. A smaller SDRAM must still hold
+	the image buffer at DEV_EMU_IMAGE_ADDR; traffic past its end counts
+	as an error, give EPD_IT8951_Pool_Init the same end.
+******************************************************************************/
+void DEV_Emu_Set_Panel(UWORD Width, UWORD Height)
+{
+	Emu_Panel_W = Width;
+	Emu_Panel_H = Height;
+}
+
+void DEV_Emu_Set_SDRAM_Size(UDOUBLE Size)
+{
+	Emu_SDRAM_Size = (Size != 0 && Size < DEV_EMU_SDRAM_SIZE) ? Size : DEV_EMU_SDRAM_SIZE;
+}
+
+void DEV_Emu_Set_Time_Scale(double Scale)
+{
+	Emu_Time_Scale = Scale;
+}
+
+void DEV_Emu_Get_Stats(int Screen, DEV_EMU_STATS *Stats)
+{
+	memset(Stats, 0, sizeof(*Stats));
+	if(Screen < 1 || Screen > EMU_SCREENS)
+		return;
+	pthread_mutex_lock(&Emu_Lock);
+	*Stats = Emu[Screen - 1].Stats;
+	pthread_mutex_unlock(&Emu_Lock);
+}
+
+void DEV_Emu_Reset_Stats(void)
+{
+	pthread_mutex_lock(&Emu_Lock);
+	for(int i = 0; i < EMU_SCREENS; i++)
+		memset(&Emu[i].Stats, 0, sizeof(Emu[i].Stats));
+	pthread_mutex_unlock(&Emu_Lock);
+}
+
+/******************************************************************************
+function:	The visible image, 8 bits per pixel, Width x Height bytes
+parameter:
+Info:
+	NULL before DEV_Module_Init
+******************************************************************************/
+const UBYTE *DEV_Emu_Get_Panel(int Screen, UWORD *Width, UWORD *Height)
+{
+	*Width = Emu_Panel_W;
+	*Height = Emu_Panel_H;
+	if(Screen < 1 || Screen > EMU_SCREENS)
+		return NULL;
+	return Emu[Screen - 1].Panel;
+}
+
+/******************************************************************************
+function:	Write the visible image as a binary PGM
+parameter:
+Info:
+	return 0, or 1 when the file cannot be written
+******************************************************************************/
+UBYTE DEV_Emu_Dump_PGM(int Screen, const char *Path)
+{
+	UWORD Width, Height;
+	const UBYTE *Panel = DEV_Emu_Get_Panel(Screen, &Width, &Height);
+	FILE *File;
+	UBYTE Result = 0;
+
+	if(Panel == NULL)
+		return 1;
+	if((File = fopen(Path, "wb")) == NULL) {
+		Debug("Emu: cannot write %s\r\n", Path);
+		return 1;
+	}
+	pthread_mutex_lock(&Emu_Lock);
+	fprintf(File, "P5\n%d %d\n255\n", Width, Height);
+	if(fwrite(Panel, 1, (size_t)Width * Height, File) != (size_t)Width * Height)
+		Result = 1;
+	pthread_mutex_unlock(&Emu_Lock);
+	if(fclose(File) != 0)
+		Result = 1;
+	return Result;
+}
+
+static UBYTE Emu_Init(void)
+{
+	const char *Panel = getenv("EPD_EMU_PANEL");
+	const char *Scale = getenv("EPD_EMU_TIME_SCALE");
+	const char *SDRAM = getenv("EPD_EMU_SDRAM");
+	unsigned int Width, Height;
+	char *Unit;
+	unsigned long Size;
+	DEV_PINS Pins;
+	uint64_t Now = DEV_Time_us();
+
+	if(Panel != NULL && sscanf(Panel, "%ux%u", &Width, &Height) == 2 && Width > 0 && Height > 0)
+		DEV_Emu_Set_Panel(Width, Height);
+	if(Scale != NULL && atof(Scale) >= 0)
+		DEV_Emu_Set_Time_Scale(atof(Scale));
+	if(SDRAM != NULL && (Size = strtoul(SDRAM, &Unit, 0)) != 0)
+		DEV_Emu_Set_SDRAM_Size(Size << (*Unit == 'M' ? 20 : *Unit == 'K' ? 10 : 0));
+
+	for(int i = 0; i < EMU_SCREENS; i++) {
+		EMU_CTRL *C = &Emu[i];
+		memset(C, 0, sizeof(*C));
+		DEV_Get_Screen_Pins(i + 1, &Pins);
+		C->CS_Pin = Pins.CS;
+		C->Busy_Pin = Pins.BUSY;
+		C->Rst_Pin = Pins.RST;
+		C->SDRAM = (UBYTE *)calloc(Emu_SDRAM_Size, 1);
+		C->SDRAM_Size = Emu_SDRAM_Size;
+		C->Panel = (UBYTE *)malloc((size_t)Emu_Panel_W * Emu_Panel_H);
+		if(C->SDRAM == NULL || C->Panel == NULL) {
+			Debug("Emu: out of memory\r\n");
+			return 1;
+		}
+		memset(C->Panel, 0xFF, (size_t)Emu_Panel_W * Emu_Panel_H);
+		Emu_Boot(C, Now);
+	}
+	return 0;
+}
+
+//$EPD_EMU_DUMP names the PGMs written for the panels that were shown,
+//"out/panel" gives out/panel1.pgm and so on
+static void Emu_Exit(void)
+{
+	const char *Dump = getenv("EPD_EMU_DUMP");
+	char Path[256];
+
+	for(int i = 0; i < EMU_SCREENS; i++) {
+		if(Dump != NULL && Emu[i].Shown && Emu[i].Panel != NULL) {
+			snprintf(Path, sizeof(Path), "%s%d.pgm", Dump, i + 1);
+			DEV_Emu_Dump_PGM(i + 1, Path);
+		}
+		free(Emu[i].SDRAM);
+		free(Emu[i].Panel);
+		Emu[i].SDRAM = NULL;
+		Emu[i].Panel = NULL;
+	}
+}
+
+static void Emu_GPIO_Mode(UWORD Pin, UWORD Mode)
+{
+}
+
+static void Emu_Digital_Write(UWORD Pin, UBYTE Value)
+{
+	pthread_mutex_lock(&Emu_Lock);
+	for(int i = 0; i < EMU_SCREENS; i++) {
+		EMU_CTRL *C = &Emu[i];
+		if(Pin == C->CS_Pin) {
+			if(!C->Selected && Value == LOW) {
+				C->Stats.Transactions++;
+				C->Preamble = 0xFFFF;
+				C->Have_Byte = 0;
+				C->Read_Bytes = 0;
+			} else if(C->Selected && Value != LOW && C->Have_Byte) {
+				Emu_Error(C, "odd byte count");
+			}
+			C->Selected = (Value == LOW);
+		} else if(Pin == C->Rst_Pin) {
+			if(Value == LOW)
+				C->In_Reset = 1;
+			else if(C->In_Reset) {
+				C->In_Reset = 0;
+				Emu_Boot(C, DEV_Time_us());
+			}
+		}
+	}
+	pthread_mutex_unlock(&Emu_Lock);
+}
+
+static UBYTE Emu_Digital_Read(UWORD Pin)
+{
+	UBYTE Level = LOW;
+
+	pthread_mutex_lock(&Emu_Lock);
+	for(int i = 0; i < EMU_SCREENS; i++) {
+		EMU_CTRL *C = &Emu[i];
+		if(Pin == C->Busy_Pin) {
+			C->Stats.Busy_Reads++;
+			Level = (!C->In_Reset && DEV_Time_us() >= C->Busy_Until_us) ? HIGH : LOW;
+		}
+	}
+	pthread_mutex_unlock(&Emu_Lock);
+	return Level;
+}
+
+static UBYTE Emu_SPI_Transfer(UBYTE Value)
+{
+	UBYTE In;
+
+	pthread_mutex_lock(&Emu_Lock);
+	Emu_Wire(1, Emu_Read_Hz);
+	In = Emu_Byte(Value);
+	pthread_mutex_unlock(&Emu_Lock);
+	return In;
+}
+
+static void Emu_SPI_Write_nByte(UBYTE *pData, UDOUBLE Len)
+{
+	pthread_mutex_lock(&Emu_Lock);
+	Emu_Wire(Len, Emu_Write_Hz);
+	for(UDOUBLE i = 0; i < Len; i++)
+		Emu_Byte(pData[i]);
+	pthread_mutex_unlock(&Emu_Lock);
+}
+
+static void Emu_SPI_Read_nByte(UBYTE *pData, UDOUBLE Len)
+{
+	pthread_mutex_lock(&Emu_Lock);
+	Emu_Wire(Len, Emu_Read_Hz);
+	for(UDOUBLE i = 0; i < Len; i++)
+		pData[i] = Emu_Byte(0x00);
+	pthread_mutex_unlock(&Emu_Lock);
+}
+
+static void Emu_SPI_Set_Speed(UDOUBLE Write_Hz, UDOUBLE Read_Hz)
+{
+	Emu_Write_Hz = Write_Hz;
+	Emu_Read_Hz = Read_Hz;
+}
+
+static void Emu_Delay_us(UDOUBLE xus)
+{
+	struct timespec ts;
+	ts.tv_sec = xus / 1000000;
+	ts.tv_nsec = (xus % 1000000) * 1000;
+	while(nanosleep(&ts, &ts) != 0 && errno == EINTR);
+}
+
+//HRDY goes high at a known time, sleep until then
+static UBYTE Emu_Wait_Level(UWORD Pin, UBYTE Level, UDOUBLE Timeout_us)
+{
+	uint64_t Start = DEV_Time_us(), Until = 0, Now;
+	UBYTE Found = 0, In_Reset = 0;
+
+	pthread_mutex_lock(&Emu_Lock);
+	for(int i = 0; i < EMU_SCREENS; i++) {
+		if(Pin == Emu[i].Busy_Pin) {
+			Found = 1;
+			In_Reset = Emu[i].In_Reset;
+			Until = Emu[i].Busy_Until_us;
+		}
+	}
+	pthread_mutex_unlock(&Emu_Lock);
+
+	if(!Found)
+		return (Level == LOW) ? 0 : 1;
+	if(Level == LOW)
+		return (In_Reset || Start < Until) ? 0 : 1;
+	if(In_Reset || (Timeout_us != 0 && Until > Start + Timeout_us)) {
+		if(Timeout_us != 0)
+			Emu_Delay_us(Timeout_us);
+		return 1;
+	}
+	Now = DEV_Time_us();
+	if(Until > Now)
+		Emu_Delay_us(Until - Now);
+	return 0;
+}
+
+const DEV_BUS DEV_Bus_Emu = {
+	.Name            = "emu",
+	.Init            = Emu_Init,
+	.Exit            = Emu_Exit,
+	.GPIO_Mode       = Emu_GPIO_Mode,
+	.Digital_Write   = Emu_Digital_Write,
+	.Digital_Read    = Emu_Digital_Read,
+	.SPI_Transfer    = Emu_SPI_Transfer,
+	.SPI_Write_nByte = Emu_SPI_Write_nByte,
+	.SPI_Read_nByte  = Emu_SPI_Read_nByte,
+	.SPI_Set_Speed   = Emu_SPI_Set_Speed,
+	.Delay_us        = Emu_Delay_us,
+	.Wait_Level      = Emu_Wait_Level,
+};
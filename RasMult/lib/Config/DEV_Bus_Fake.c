@@ -0,0 +1,205 @@
+/*****************************************************************************
+* | File      	:   DEV_Bus_Fake.c
+* | Author      :   IT8951-ePaper contributors
+* | Function    :   In-process fake bus backend
+* | Info        :
+*                Records the SPI byte stream and counts transfers so the
+*                driver can be exercised and timed without hardware
+*----------------
+* |	This version:   V1.0
+* | Date        :   2026-10-18
+* | Info        :
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documnetation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to  whom the Software is
+# furished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS OR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+# THE SOFTWARE.
+#
+******************************************************************************/
+#include "DEV_Config.h"
+
+#define FAKE_MAX_PIN 64
+
+static UBYTE *Fake_Log = NULL;
+static UDOUBLE Fake_Log_Len = 0;
+static UDOUBLE Fake_Log_Size = 0;
+static UBYTE Fake_Level[FAKE_MAX_PIN];
+static DEV_FAKE_STATS Fake_Stats;
+static UBYTE (*Fake_Read_Handler)(void) = NULL;
+
+static void Fake_Log_Append(const UBYTE *pData, UDOUBLE Len)
+{
+	if(Fake_Log_Len + Len > Fake_Log_Size) {
+		UDOUBLE New_Size = Fake_Log_Size ? Fake_Log_Size : 65536;
+		while(New_Size < Fake_Log_Len + Len)
+			New_Size *= 2;
+		UBYTE *New_Log = (UBYTE *)realloc(Fake_Log, New_Size);
+		if(New_Log == NULL) {
+			Debug("Fake bus: out of log memory\r\n");
+			return;
+		}
+		Fake_Log = New_Log;
+		Fake_Log_Size = New_Size;
+	}
+	memcpy(Fake_Log + Fake_Log_Len, pData, Len);
+	Fake_Log_Len += Len;
+}
+
+static UBYTE Fake_Is_CS(UWORD Pin)
+{
+	return Pin == EPD_CS_PIN_1 || Pin == EPD_CS_PIN_2 || Pin == EPD_CS_PIN_3;
+}
+
+static UBYTE Fake_Is_Busy(UWORD Pin)
+{
+	return Pin == EPD_BUSY_PIN_1 || Pin == EPD_BUSY_PIN_2 || Pin == EPD_BUSY_PIN_3;
+}
+
+/******************************************************************************
+function:	Clear the recorded byte stream and counters
+******************************************************************************/
+void DEV_Fake_Reset(void)
+{
+	Fake_Log_Len = 0;
+	memset(&Fake_Stats, 0, sizeof(Fake_Stats));
+}
+
+/******************************************************************************
+function:	Get the recorded byte stream
+parameter:
+	Len : receives the number of bytes recorded
+Info:
+	The buffer stays owned by the fake bus and is valid until the next write
+******************************************************************************/
+UBYTE *DEV_Fake_Get_Log(UDOUBLE *Len)
+{
+	*Len = Fake_Log_Len;
+	return Fake_Log;
+}
+
+void DEV_Fake_Get_Stats(DEV_FAKE_STATS *Stats)
+{
+	*Stats = Fake_Stats;
+}
+
+/******************************************************************************
+function:	Supply the bytes returned by SPI reads
+parameter:
+	Handler : called once per byte read, NULL reads zeros
+******************************************************************************/
+void DEV_Fake_Set_Read_Handler(UBYTE (*Handler)(void))
+{
+	Fake_Read_Handler = Handler;
+}
+
+static UBYTE Fake_Init(void)
+{
+	memset(Fake_Level, HIGH, sizeof(Fake_Level));
+	DEV_Fake_Reset();
+	return 0;
+}
+
+static void Fake_Exit(void)
+{
+	free(Fake_Log);
+	Fake_Log = NULL;
+	Fake_Log_Len = 0;
+	Fake_Log_Size = 0;
+}
+
+static void Fake_GPIO_Mode(UWORD Pin, UWORD Mode)
+{
+}
+
+static void Fake_Digital_Write(UWORD Pin, UBYTE Value)
+{
+	if(Pin >= FAKE_MAX_PIN)
+		return;
+	if(Fake_Is_CS(Pin) && Fake_Level[Pin] == HIGH && Value == LOW)
+		Fake_Stats.CS_Assertions++;
+	Fake_Level[Pin] = Value ? HIGH : LOW;
+}
+
+static UBYTE Fake_Digital_Read(UWORD Pin)
+{
+	if(Fake_Is_Busy(Pin)) {
+		Fake_Stats.Busy_Reads++;
+		return HIGH;
+	}
+	return (Pin < FAKE_MAX_PIN) ? Fake_Level[Pin] : LOW;
+}
+
+static UBYTE Fake_SPI_Transfer(UBYTE Value)
+{
+	Fake_Stats.SPI_Calls++;
+	Fake_Stats.Bytes_Written++;
+	Fake_Log_Append(&Value, 1);
+	if(Fake_Read_Handler != NULL) {
+		Fake_Stats.Bytes_Read++;
+		return Fake_Read_Handler();
+	}
+	return 0x00;
+}
+
+static void Fake_SPI_Write_nByte(UBYTE *pData, UDOUBLE Len)
+{
+	Fake_Stats.SPI_Calls++;
+	Fake_Stats.Bytes_Written += Len;
+	Fake_Log_Append(pData, Len);
+}
+
+static void Fake_SPI_Read_nByte(UBYTE *pData, UDOUBLE Len)
+{
+	static const UBYTE Zero[64];
+
+	Fake_Stats.SPI_Calls++;
+	Fake_Stats.Bytes_Written += Len;
+	for(UDOUBLE i = 0; i < Len; i += sizeof(Zero))
+		Fake_Log_Append(Zero, (Len - i > sizeof(Zero)) ? sizeof(Zero) : Len - i);
+	if(Fake_Read_Handler != NULL) {
+		Fake_Stats.Bytes_Read += Len;
+		for(UDOUBLE i = 0; i < Len; i++)
+			pData[i] = Fake_Read_Handler();
+	} else {
+		memset(pData, 0, Len);
+	}
+}
+
+static void Fake_SPI_Set_Speed(UDOUBLE Write_Hz, UDOUBLE Read_Hz)
+{
+	Fake_Stats.Write_Hz = Write_Hz;
+	Fake_Stats.Read_Hz = Read_Hz;
+}
+
+static void Fake_Delay_us(UDOUBLE xus)
+{
+	Fake_Stats.Delay_us += xus;
+}
+
+const DEV_BUS DEV_Bus_Fake = {
+	.Name            = "fake",
+	.Init            = Fake_Init,
+	.Exit            = Fake_Exit,
+	.GPIO_Mode       = Fake_GPIO_Mode,
+	.Digital_Write   = Fake_Digital_Write,
+	.Digital_Read    = Fake_Digital_Read,
+	.SPI_Transfer    = Fake_SPI_Transfer,
+	.SPI_Write_nByte = Fake_SPI_Write_nByte,
+	.SPI_Read_nByte  = Fake_SPI_Read_nByte,
+	.SPI_Set_Speed   = Fake_SPI_Set_Speed,
+	.Delay_us        = Fake_Delay_us,
+	.Wait_Level      = NULL,
+};
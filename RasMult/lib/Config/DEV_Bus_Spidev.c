@@ -0,0 +1,322 @@
+/*****************************************************************************
+* | File      	:   DEV_Bus_Spidev.c
+* | Author      :   IT8951-ePaper contributors
+* | Function    :   Linux spidev + GPIO character device bus backend
+* | Info        :
+*                SPI through /dev/spidevX.Y, CS/RST/BUSY through the gpio v2
+*                character device uAPI, runs on any Pi model with a stock kernel
+*----------------
+* |	This version:   V1.0
+* | Date        :   2026-10-18
+* | Info        :
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documnetation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to  whom the Software is
+# furished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS OR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+# THE SOFTWARE.
+#
+******************************************************************************/
+#include "DEV_Config.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <linux/spi/spidev.h>
+#include <linux/gpio.h>
+
+//highest BCM GPIO number on the 40 pin header plus margin
+#define SPIDEV_MAX_PIN      64
+//spi_ioc_transfer segments per SPI_IOC_MESSAGE
+#define SPIDEV_MAX_SEGMENTS 16
+
+static int Spi_Fd = -1;
+static int Chip_Fd = -1;
+static int Line_Fd[SPIDEV_MAX_PIN];
+static UDOUBLE Spi_Bufsiz = 4096;
+static UDOUBLE Spi_Write_Hz = DEV_SPI_SPEED_HZ;
+static UDOUBLE Spi_Read_Hz = DEV_SPI_SPEED_HZ;
+
+/******************************************************************************
+function:	Read the spidev per-message limit
+Info:
+	spidev rejects messages larger than its bufsiz module parameter
+	(4096 by default, raise it with spidev.bufsiz=65536 on the kernel
+	command line to let the kernel move a whole frame in fewer calls)
+******************************************************************************/
+static void Spidev_Read_Bufsiz(void)
+{
+	FILE *fp = fopen("/sys/module/spidev/parameters/bufsiz", "r");
+	unsigned long Value;
+
+	if(fp == NULL)
+		return;
+	if(fscanf(fp, "%lu", &Value) == 1 && Value > 0)
+		Spi_Bufsiz = Value;
+	fclose(fp);
+}
+
+static UBYTE Spidev_Init(void)
+{
+	UBYTE Mode = SPI_MODE_0;
+	UBYTE Bits = 8;
+	UDOUBLE Speed = DEV_SPI_SPEED_HZ;
+
+	for(int i = 0; i < SPIDEV_MAX_PIN; i++)
+		Line_Fd[i] = -1;
+
+	Spi_Fd = open(DEV_SPIDEV_PATH, O_RDWR);
+	if(Spi_Fd < 0) {
+		Debug("open %s failed: %s\r\n", DEV_SPIDEV_PATH, strerror(errno));
+		return 1;
+	}
+
+	//CS is driven through GPIO, keep the controller's own CE inactive when supported
+	Mode |= SPI_NO_CS;
+	if(ioctl(Spi_Fd, SPI_IOC_WR_MODE, &Mode) < 0) {
+		Mode = SPI_MODE_0;
+		ioctl(Spi_Fd, SPI_IOC_WR_MODE, &Mode);
+	}
+	ioctl(Spi_Fd, SPI_IOC_WR_BITS_PER_WORD, &Bits);
+	ioctl(Spi_Fd, SPI_IOC_WR_MAX_SPEED_HZ, &Speed);
+	Spidev_Read_Bufsiz();
+
+	Chip_Fd = open(DEV_GPIOCHIP_PATH, O_RDWR);
+	if(Chip_Fd < 0) {
+		Debug("open %s failed: %s\r\n", DEV_GPIOCHIP_PATH, strerror(errno));
+		close(Spi_Fd);
+		Spi_Fd = -1;
+		return 1;
+	}
+	return 0;
+}
+
+static void Spidev_Exit(void)
+{
+	for(int i = 0; i < SPIDEV_MAX_PIN; i++) {
+		if(Line_Fd[i] >= 0) {
+			close(Line_Fd[i]);
+			Line_Fd[i] = -1;
+		}
+	}
+	if(Chip_Fd >= 0) {
+		close(Chip_Fd);
+		Chip_Fd = -1;
+	}
+	if(Spi_Fd >= 0) {
+		close(Spi_Fd);
+		Spi_Fd = -1;
+	}
+}
+
+/******************************************************************************
+function:	Request one line from the GPIO character device
+parameter:
+	Pin  : BCM GPIO number, which is the line offset on the SoC gpiochip
+	Mode : DEV_GPIO_INPUT or DEV_GPIO_OUTPUT, outputs start HIGH
+Info:
+	Inputs are requested with edge detection on both edges so that
+	Spidev_Wait_Level can sleep in poll() instead of reading in a loop
+******************************************************************************/
+static void Spidev_GPIO_Mode(UWORD Pin, UWORD Mode)
+{
+	struct gpio_v2_line_request Req;
+
+	if(Pin >= SPIDEV_MAX_PIN || Chip_Fd < 0)
+		return;
+	if(Line_Fd[Pin] >= 0) {
+		close(Line_Fd[Pin]);
+		Line_Fd[Pin] = -1;
+	}
+
+	memset(&Req, 0, sizeof(Req));
+	Req.offsets[0] = Pin;
+	Req.num_lines = 1;
+	strncpy(Req.consumer, "IT8951", sizeof(Req.consumer) - 1);
+	if(Mode == DEV_GPIO_INPUT) {
+		Req.config.flags = GPIO_V2_LINE_FLAG_INPUT | GPIO_V2_LINE_FLAG_EDGE_RISING | GPIO_V2_LINE_FLAG_EDGE_FALLING;
+	} else {
+		Req.config.flags = GPIO_V2_LINE_FLAG_OUTPUT;
+		Req.config.num_attrs = 1;
+		Req.config.attrs[0].attr.id = GPIO_V2_LINE_ATTR_ID_OUTPUT_VALUES;
+		Req.config.attrs[0].attr.values = 1;
+		Req.config.attrs[0].mask = 1;
+	}
+
+	if(ioctl(Chip_Fd, GPIO_V2_GET_LINE_IOCTL, &Req) < 0) {
+		Debug("request GPIO %d failed: %s\r\n", Pin, strerror(errno));
+		return;
+	}
+	Line_Fd[Pin] = Req.fd;
+	if(Mode == DEV_GPIO_INPUT)
+		fcntl(Req.fd, F_SETFL, fcntl(Req.fd, F_GETFL) | O_NONBLOCK);
+}
+
+static void Spidev_Digital_Write(UWORD Pin, UBYTE Value)
+{
+	struct gpio_v2_line_values Values;
+
+	if(Pin >= SPIDEV_MAX_PIN || Line_Fd[Pin] < 0)
+		return;
+	Values.mask = 1;
+	Values.bits = Value ? 1 : 0;
+	ioctl(Line_Fd[Pin], GPIO_V2_LINE_SET_VALUES_IOCTL, &Values);
+}
+
+static UBYTE Spidev_Digital_Read(UWORD Pin)
+{
+	struct gpio_v2_line_values Values;
+
+	if(Pin >= SPIDEV_MAX_PIN || Line_Fd[Pin] < 0)
+		return 0;
+	Values.mask = 1;
+	Values.bits = 0;
+	if(ioctl(Line_Fd[Pin], GPIO_V2_LINE_GET_VALUES_IOCTL, &Values) < 0)
+		return 0;
+	return Values.bits & 1;
+}
+
+/******************************************************************************
+function:	Sleep until an input line reads Level
+parameter:
+	Timeout_us : 0 waits forever
+Info:
+	Queued edge events are drained before the level is sampled, so an edge
+	that arrives between the sample and poll() still wakes us up
+******************************************************************************/
+static UBYTE Spidev_Wait_Level(UWORD Pin, UBYTE Level, UDOUBLE Timeout_us)
+{
+	struct gpio_v2_line_event Events[16];
+	struct pollfd Pfd;
+	uint64_t Deadline = DEV_Time_us() + Timeout_us;
+	int Timeout_ms;
+
+	if(Pin >= SPIDEV_MAX_PIN || Line_Fd[Pin] < 0)
+		return 1;
+
+	Pfd.fd = Line_Fd[Pin];
+	Pfd.events = POLLIN;
+	for(;;) {
+		while(read(Line_Fd[Pin], Events, sizeof(Events)) > 0);
+		if(Spidev_Digital_Read(Pin) == Level)
+			return 0;
+
+		if(Timeout_us == 0) {
+			Timeout_ms = -1;
+		} else {
+			uint64_t Now = DEV_Time_us();
+			if(Now >= Deadline)
+				return 1;
+			Timeout_ms = (Deadline - Now + 999) / 1000;
+		}
+		if(poll(&Pfd, 1, Timeout_ms) < 0 && errno != EINTR)
+			return 1;
+	}
+}
+
+/******************************************************************************
+function:	Full duplex transfer of Len bytes
+parameter:
+	Tx : bytes to send, NULL sends zeros
+	Rx : received bytes, NULL discards them
+	Hz : clock for this transfer
+Info:
+	The buffer is cut into at most SPIDEV_MAX_SEGMENTS segments per
+	SPI_IOC_MESSAGE, each message staying within the spidev bufsiz, so the
+	kernel moves large blocks without a user space round trip per byte
+******************************************************************************/
+static void Spidev_Transfer(const UBYTE *Tx, UBYTE *Rx, UDOUBLE Len, UDOUBLE Hz)
+{
+	struct spi_ioc_transfer Xfer[SPIDEV_MAX_SEGMENTS];
+	UDOUBLE Seg_Len = Spi_Bufsiz / SPIDEV_MAX_SEGMENTS;
+	UDOUBLE Msg_Len, Seg;
+
+	if(Seg_Len < 256)
+		Seg_Len = Spi_Bufsiz;
+
+	while(Len > 0) {
+		memset(Xfer, 0, sizeof(Xfer));
+		Msg_Len = 0;
+		for(Seg = 0; Seg < SPIDEV_MAX_SEGMENTS && Len > 0 && Msg_Len + Seg_Len <= Spi_Bufsiz; Seg++) {
+			UDOUBLE n = (Len > Seg_Len) ? Seg_Len : Len;
+			Xfer[Seg].tx_buf = (unsigned long)Tx;
+			Xfer[Seg].rx_buf = (unsigned long)Rx;
+			Xfer[Seg].len = n;
+			Xfer[Seg].bits_per_word = 8;
+			Xfer[Seg].speed_hz = Hz;
+			if(Tx != NULL)
+				Tx += n;
+			if(Rx != NULL)
+				Rx += n;
+			Len -= n;
+			Msg_Len += n;
+		}
+		if(ioctl(Spi_Fd, SPI_IOC_MESSAGE(Seg), Xfer) < 0) {
+			Debug("SPI_IOC_MESSAGE failed: %s\r\n", strerror(errno));
+			return;
+		}
+	}
+}
+
+static UBYTE Spidev_SPI_Transfer(UBYTE Value)
+{
+	UBYTE Read_Value = 0;
+	Spidev_Transfer(&Value, &Read_Value, 1, Spi_Read_Hz);
+	return Read_Value;
+}
+
+static void Spidev_SPI_Write_nByte(UBYTE *pData, UDOUBLE Len)
+{
+	Spidev_Transfer(pData, NULL, Len, Spi_Write_Hz);
+}
+
+static void Spidev_SPI_Read_nByte(UBYTE *pData, UDOUBLE Len)
+{
+	Spidev_Transfer(NULL, pData, Len, Spi_Read_Hz);
+}
+
+static void Spidev_SPI_Set_Speed(UDOUBLE Write_Hz, UDOUBLE Read_Hz)
+{
+	UDOUBLE Max_Hz = (Write_Hz > Read_Hz) ? Write_Hz : Read_Hz;
+
+	Spi_Write_Hz = Write_Hz;
+	Spi_Read_Hz = Read_Hz;
+	if(Spi_Fd >= 0)
+		ioctl(Spi_Fd, SPI_IOC_WR_MAX_SPEED_HZ, &Max_Hz);
+}
+
+static void Spidev_Delay_us(UDOUBLE xus)
+{
+	struct timespec ts;
+	ts.tv_sec = xus / 1000000;
+	ts.tv_nsec = (xus % 1000000) * 1000;
+	while(nanosleep(&ts, &ts) != 0 && errno == EINTR);
+}
+
+const DEV_BUS DEV_Bus_Spidev = {
+	.Name            = "spidev",
+	.Init            = Spidev_Init,
+	.Exit            = Spidev_Exit,
+	.GPIO_Mode       = Spidev_GPIO_Mode,
+	.Digital_Write   = Spidev_Digital_Write,
+	.Digital_Read    = Spidev_Digital_Read,
+	.SPI_Transfer    = Spidev_SPI_Transfer,
+	.SPI_Write_nByte = Spidev_SPI_Write_nByte,
+	.SPI_Read_nByte  = Spidev_SPI_Read_nByte,
+	.SPI_Set_Speed   = Spidev_SPI_Set_Speed,
+	.Delay_us        = Spidev_Delay_us,
+	.Wait_Level      = Spidev_Wait_Level,
+};
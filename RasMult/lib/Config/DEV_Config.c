@@ -29,8 +29,74 @@
 ******************************************************************************/
 #include "DEV_Config.h"
 #include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
 
 
+/**
+ * Active bus backend
+**/
+#ifdef USE_BCM2835_LIB
+static const DEV_BUS *Bus = &DEV_Bus_BCM2835;
+#else
+static const DEV_BUS *Bus = &DEV_Bus_Spidev;
+#endif
+
+static const DEV_BUS *Bus_List[] = {
+#ifdef USE_BCM2835_LIB
+	&DEV_Bus_BCM2835,
+#endif
+	&DEV_Bus_Spidev,
+	&DEV_Bus_Fake,
+	&DEV_Bus_Emu,
+};
+
+/******************************************************************************
+function:	Select the bus backend
+parameter:
+Info:
+	Must be called before DEV_Module_Init()
+******************************************************************************/
+void DEV_Set_Bus(const DEV_BUS *New_Bus)
+{
+	if(New_Bus != NULL)
+		Bus = New_Bus;
+}
+
+/******************************************************************************
+function:	Select the bus backend by name
+parameter:
+	Name : "bcm2835", "spidev", "fake" or "emu"
+Info:
+	return 0 on success, 1 if no backend of that name is built in
+******************************************************************************/
+UBYTE DEV_Select_Bus(const char *Name)
+{
+	for(UWORD i = 0; i < sizeof(Bus_List)/sizeof(Bus_List[0]); i++) {
+		if(strcmp(Bus_List[i]->Name, Name) == 0) {
+			Bus = Bus_List[i];
+			return 0;
+		}
+	}
+	Debug("Unknown bus backend: %s\r\n", Name);
+	return 1;
+}
+
+const DEV_BUS *DEV_Get_Bus(void)
+{
+	return Bus;
+}
+
+static UDOUBLE SPI_Write_Hz = DEV_SPI_SPEED_HZ;
+static UDOUBLE SPI_Read_Hz = DEV_SPI_SPEED_HZ;
+
+static UDOUBLE Busy_Spin_Count = DEV_BUSY_SPIN_COUNT;
+static DEV_WAIT_STATS Wait_Stats;
+static pthread_mutex_t Wait_Stats_Lock = PTHREAD_MUTEX_INITIALIZER;
+
+//one transaction at a time on the shared SPI bus, see DEV_Bus_Lock
+static pthread_mutex_t Bus_Lock = PTHREAD_MUTEX_INITIALIZER;
+
 /******************************************************************************
 function:	GPIO Write
 parameter:
@@ -38,7 +104,7 @@ Info:
 ******************************************************************************/
 void DEV_Digital_Write(UWORD Pin, UBYTE Value)
 {
-	bcm2835_gpio_write(Pin, Value);
+	Bus->Digital_Write(Pin, Value);
 }
 
 /******************************************************************************
@@ -49,7 +115,7 @@ Info:
 UBYTE DEV_Digital_Read(UWORD Pin)
 {
 	UBYTE Read_Value = 0;
-	Read_Value = bcm2835_gpio_lev(Pin);
+	Read_Value = Bus->Digital_Read(Pin);
 	return Read_Value;
 }
 
@@ -60,7 +126,71 @@ Info:
 ******************************************************************************/
 void DEV_SPI_WriteByte(UBYTE Value)
 {
-	bcm2835_spi_transfer(Value);
+	Bus->SPI_Transfer(Value);
+}
+
+/******************************************************************************
+function:	SPI Write n bytes
+parameter:
+    pData : buffer to send
+    Len   : number of bytes
+Info:
+    The whole buffer goes out in one backend call, CS is left to the caller
+******************************************************************************/
+void DEV_SPI_Write_nByte(UBYTE *pData, UDOUBLE Len)
+{
+	Bus->SPI_Write_nByte(pData, Len);
+}
+
+/******************************************************************************
+function:	SPI Read n bytes
+parameter:
+    pData : receives the bytes
+    Len   : number of bytes
+Info:
+    Zeros are clocked out, the whole block is one backend call
+******************************************************************************/
+void DEV_SPI_Read_nByte(UBYTE *pData, UDOUBLE Len)
+{
+	Bus->SPI_Read_nByte(pData, Len);
+}
+
+/******************************************************************************
+function:	SPI clock
+parameter:
+    Write_Hz : bulk writes (DEV_SPI_Write_nByte)
+    Read_Hz  : bulk reads and single byte transfers
+Info:
+    The backend rounds to what the hardware can do
+******************************************************************************/
+void DEV_SPI_Set_Speed(UDOUBLE Write_Hz, UDOUBLE Read_Hz)
+{
+	SPI_Write_Hz = Write_Hz;
+	SPI_Read_Hz = Read_Hz;
+	Bus->SPI_Set_Speed(Write_Hz, Read_Hz);
+}
+
+void DEV_SPI_Get_Speed(UDOUBLE *Write_Hz, UDOUBLE *Read_Hz)
+{
+	*Write_Hz = SPI_Write_Hz;
+	*Read_Hz = SPI_Read_Hz;
+}
+
+/******************************************************************************
+function:	SPI bus ownership
+parameter:
+Info:
+	All panels share MOSI/MISO/SCLK and only differ in CS, so a transaction
+	holds the lock from CS low to CS high. Not recursive.
+******************************************************************************/
+void DEV_Bus_Lock(void)
+{
+	pthread_mutex_lock(&Bus_Lock);
+}
+
+void DEV_Bus_Unlock(void)
+{
+	pthread_mutex_unlock(&Bus_Lock);
 }
 
 /******************************************************************************
@@ -71,7 +201,7 @@ Info:
 UBYTE DEV_SPI_ReadByte()
 {
 	UBYTE Read_Value = 0x00;
-	Read_Value = bcm2835_spi_transfer(0x00);
+	Read_Value = Bus->SPI_Transfer(0x00);
 	return Read_Value;
 }
 
@@ -82,7 +212,7 @@ Info:
 ******************************************************************************/
 void DEV_Delay_ms(UDOUBLE xms)
 {
-	bcm2835_delay(xms);
+	Bus->Delay_us(xms * 1000);
 }
 
 
@@ -93,7 +223,97 @@ Info:
 ******************************************************************************/
 void DEV_Delay_us(UDOUBLE xus)
 {
-	bcm2835_delayMicroseconds(xus);
+	Bus->Delay_us(xus);
+}
+
+/******************************************************************************
+function:	Monotonic time in us
+parameter:
+Info:
+******************************************************************************/
+uint64_t DEV_Time_us(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/******************************************************************************
+function:	Wait until a pin reads the given level
+parameter:
+	Pin        : GPIO to watch
+	Level      : HIGH or LOW
+	Timeout_ms : 0 waits forever
+Info:
+	Spins for DEV_BUSY_SPIN_COUNT reads first, which covers the short HRDY
+	gaps between words. After that the thread sleeps, on a GPIO edge event
+	when the backend has one, else with a poll interval that doubles from
+	DEV_BUSY_SLEEP_MIN_US up to DEV_BUSY_SLEEP_MAX_US.
+	return 0 when the level was seen, 1 on timeout
+******************************************************************************/
+UBYTE DEV_Wait_Pin(UWORD Pin, UBYTE Level, UDOUBLE Timeout_ms)
+{
+	uint64_t Start = DEV_Time_us();
+	uint64_t Deadline = Start + (uint64_t)Timeout_ms * 1000;
+	UDOUBLE Sleep_us = DEV_BUSY_SLEEP_MIN_US;
+	UDOUBLE Elapsed;
+	UBYTE Result = 0;
+
+	for(UDOUBLE i = 0; i < Busy_Spin_Count; i++) {
+		if(Bus->Digital_Read(Pin) == Level) {
+			pthread_mutex_lock(&Wait_Stats_Lock);
+			Wait_Stats.Waits++;
+			Wait_Stats.Spin_Hits++;
+			Wait_Stats.Total_Wait_us += DEV_Time_us() - Start;
+			pthread_mutex_unlock(&Wait_Stats_Lock);
+			return 0;
+		}
+	}
+
+	if(Bus->Wait_Level != NULL) {
+		Result = Bus->Wait_Level(Pin, Level, Timeout_ms == 0 ? 0 : Timeout_ms * 1000);
+	} else {
+		while(Bus->Digital_Read(Pin) != Level) {
+			if(Timeout_ms != 0 && DEV_Time_us() >= Deadline) {
+				Result = 1;
+				break;
+			}
+			Bus->Delay_us(Sleep_us);
+			if(Sleep_us < DEV_BUSY_SLEEP_MAX_US)
+				Sleep_us *= 2;
+		}
+	}
+
+	Elapsed = DEV_Time_us() - Start;
+	pthread_mutex_lock(&Wait_Stats_Lock);
+	Wait_Stats.Waits++;
+	Wait_Stats.Sleeps++;
+	Wait_Stats.Total_Wait_us += Elapsed;
+	if(Elapsed > Wait_Stats.Max_Wait_us)
+		Wait_Stats.Max_Wait_us = Elapsed;
+	if(Result != 0)
+		Wait_Stats.Timeouts++;
+	pthread_mutex_unlock(&Wait_Stats_Lock);
+	return Result;
+}
+
+void DEV_Set_Busy_Spin(UDOUBLE Spin_Count)
+{
+	Busy_Spin_Count = Spin_Count;
+}
+
+void DEV_Get_Wait_Stats(DEV_WAIT_STATS *Stats)
+{
+	pthread_mutex_lock(&Wait_Stats_Lock);
+	*Stats = Wait_Stats;
+	pthread_mutex_unlock(&Wait_Stats_Lock);
+}
+
+void DEV_Reset_Wait_Stats(void)
+{
+	pthread_mutex_lock(&Wait_Stats_Lock);
+	memset(&Wait_Stats, 0, sizeof(Wait_Stats));
+	pthread_mutex_unlock(&Wait_Stats_Lock);
 }
 
 
@@ -106,10 +326,10 @@ void DEV_Delay_us(UDOUBLE xus)
 **/
 static void DEV_GPIO_Mode(UWORD Pin, UWORD Mode)
 {
-	if(Mode == 0 || Mode == BCM2835_GPIO_FSEL_INPT) {
-		bcm2835_gpio_fsel(Pin, BCM2835_GPIO_FSEL_INPT);
+	if(Mode == 0 || Mode == DEV_GPIO_INPUT) {
+		Bus->GPIO_Mode(Pin, DEV_GPIO_INPUT);
 	} else {
-		bcm2835_gpio_fsel(Pin, BCM2835_GPIO_FSEL_OUTP);
+		Bus->GPIO_Mode(Pin, DEV_GPIO_OUTPUT);
 	}
 }
 
@@ -118,55 +338,54 @@ static void DEV_GPIO_Mode(UWORD Pin, UWORD Mode)
  * GPIO Init
 **/
 
-int EPD_CS_PIN = EPD_CS_PIN_1;
-int EPD_BUSY_PIN = EPD_BUSY_PIN_1;
-int EPD_RST_PIN = EPD_RST_PIN_1;
-
- void swapSCREEN(int screen)
-{
-	switch(screen) {
-	
-       case 1 :
-                EPD_CS_PIN = EPD_CS_PIN_1;
-                EPD_RST_PIN = EPD_RST_PIN_1;
-                EPD_BUSY_PIN = EPD_BUSY_PIN_1;
-                break;
-
-        case 2 :
-                EPD_CS_PIN = EPD_CS_PIN_2;
-                EPD_RST_PIN = EPD_RST_PIN_2;
-                EPD_BUSY_PIN = EPD_BUSY_PIN_2;
-                break;
-
-        case 3 :
-                EPD_CS_PIN = EPD_CS_PIN_3;
-                EPD_RST_PIN = EPD_RST_PIN_3;
-                EPD_BUSY_PIN = EPD_BUSY_PIN_3;
-                break;
-		
+/******************************************************************************
+function:	Pins of screen 1..3 on the V2 hardware
+parameter:
+Info:
+	return 0, or 1 with Pins untouched for an unknown screen
+******************************************************************************/
+UBYTE DEV_Get_Screen_Pins(int Screen, DEV_PINS *Pins)
+{
+	switch(Screen) {
+	case 1 :
+		Pins->CS = EPD_CS_PIN_1;
+		Pins->BUSY = EPD_BUSY_PIN_1;
+		Pins->RST = EPD_RST_PIN_1;
+		return 0;
+	case 2 :
+		Pins->CS = EPD_CS_PIN_2;
+		Pins->BUSY = EPD_BUSY_PIN_2;
+		Pins->RST = EPD_RST_PIN_2;
+		return 0;
+	case 3 :
+		Pins->CS = EPD_CS_PIN_3;
+		Pins->BUSY = EPD_BUSY_PIN_3;
+		Pins->RST = EPD_RST_PIN_3;
+		return 0;
 	default:
-		break;
-
+		return 1;
 	}
-
 }
 
 
 static void DEV_GPIO_Init(void)
 {
-	DEV_GPIO_Mode(EPD_RST_PIN_1, BCM2835_GPIO_FSEL_OUTP);
-	DEV_GPIO_Mode(EPD_RST_PIN_2, BCM2835_GPIO_FSEL_OUTP);
-	DEV_GPIO_Mode(EPD_RST_PIN_3, BCM2835_GPIO_FSEL_OUTP);
-	DEV_GPIO_Mode(EPD_CS_PIN_1, BCM2835_GPIO_FSEL_OUTP);
-	DEV_GPIO_Mode(EPD_CS_PIN_2, BCM2835_GPIO_FSEL_OUTP);
-	DEV_GPIO_Mode(EPD_CS_PIN_3, BCM2835_GPIO_FSEL_OUTP);
-	DEV_GPIO_Mode(EPD_BUSY_PIN_1, BCM2835_GPIO_FSEL_INPT);
-	DEV_GPIO_Mode(EPD_BUSY_PIN_2, BCM2835_GPIO_FSEL_INPT);
-	DEV_GPIO_Mode(EPD_BUSY_PIN_3, BCM2835_GPIO_FSEL_INPT);
+	DEV_GPIO_Mode(EPD_RST_PIN_1, DEV_GPIO_OUTPUT);
+	DEV_GPIO_Mode(EPD_RST_PIN_2, DEV_GPIO_OUTPUT);
+	DEV_GPIO_Mode(EPD_RST_PIN_3, DEV_GPIO_OUTPUT);
+	DEV_GPIO_Mode(EPD_CS_PIN_1, DEV_GPIO_OUTPUT);
+	DEV_GPIO_Mode(EPD_CS_PIN_2, DEV_GPIO_OUTPUT);
+	DEV_GPIO_Mode(EPD_CS_PIN_3, DEV_GPIO_OUTPUT);
+	DEV_GPIO_Mode(EPD_BUSY_PIN_1, DEV_GPIO_INPUT);
+	DEV_GPIO_Mode(EPD_BUSY_PIN_2, DEV_GPIO_INPUT);
+	DEV_GPIO_Mode(EPD_BUSY_PIN_3, DEV_GPIO_INPUT);
 	DEV_Digital_Write(EPD_CS_PIN_1, HIGH); //deactivating all cs pins
 	DEV_Digital_Write(EPD_CS_PIN_2, HIGH); 
 	DEV_Digital_Write(EPD_CS_PIN_3, HIGH);
-	
+	//out of reset, a controller left running by DEV_Module_Detach keeps its state
+	DEV_Digital_Write(EPD_RST_PIN_1, HIGH);
+	DEV_Digital_Write(EPD_RST_PIN_2, HIGH);
+	DEV_Digital_Write(EPD_RST_PIN_3, HIGH);
 }
 
 
@@ -180,20 +399,17 @@ UBYTE DEV_Module_Init(void)
 {
     Debug("/***********************************/ \r\n");
 
-	if(!bcm2835_init()) {
-		Debug("bcm2835 init failed  !!! \r\n");
+	char *Bus_Name = getenv("EPD_BUS");
+	if(Bus_Name != NULL && DEV_Select_Bus(Bus_Name) != 0) {
 		return 1;
-	} else {
-		Debug("bcm2835 init success !!! \r\n");
 	}
 
-	bcm2835_spi_begin();                                         //Start spi interface, set spi pin for the reuse function
-	bcm2835_spi_setBitOrder(BCM2835_SPI_BIT_ORDER_MSBFIRST);     //High first transmission
-	bcm2835_spi_setDataMode(BCM2835_SPI_MODE0);                  //spi mode 0
-	//bcm2835_spi_setClockDivider(BCM2835_SPI_CLOCK_DIVIDER_16);   //For RPi3/3B/3B+
-	bcm2835_spi_setClockDivider(BCM2835_SPI_CLOCK_DIVIDER_64);   //For RPi 4
-	/* SPI clock reference link：*/
-	/*http://www.airspayce.com/mikem/bcm2835/group__constants.html#gaf2e0ca069b8caef24602a02e8a00884e*/
+	if(Bus->Init() != 0) {
+		Debug("%s init failed  !!! \r\n", Bus->Name);
+		return 1;
+	} else {
+		Debug("%s init success !!! \r\n", Bus->Name);
+	}
 
 	//GPIO Config
 	DEV_GPIO_Init();
@@ -205,17 +421,35 @@ UBYTE DEV_Module_Init(void)
 
 
 /******************************************************************************
-function:	Module exits, closes SPI and BCM2835 library
+function:	Module exits, closes SPI and the bus backend
 parameter:
 Info:
 ******************************************************************************/
 void DEV_Module_Exit(void)
 {
-	DEV_Digital_Write(EPD_CS_PIN, LOW);
+	DEV_Digital_Write(EPD_CS_PIN_1, LOW);
+	DEV_Digital_Write(EPD_CS_PIN_2, LOW);
+	DEV_Digital_Write(EPD_CS_PIN_3, LOW);
 	DEV_Digital_Write(EPD_RST_PIN_1, LOW);
 	DEV_Digital_Write(EPD_RST_PIN_2, LOW);
 	DEV_Digital_Write(EPD_RST_PIN_3, LOW);
 
-	bcm2835_spi_end();
-	bcm2835_close();
+	Bus->Exit();
+}
+
+
+
+/******************************************************************************
+function:	Module detach, closes the bus backend and leaves the controllers
+            running with their SDRAM, for EPD_IT8951_Attach on the next start
+parameter:
+Info:
+******************************************************************************/
+void DEV_Module_Detach(void)
+{
+	DEV_Digital_Write(EPD_CS_PIN_1, HIGH);
+	DEV_Digital_Write(EPD_CS_PIN_2, HIGH);
+	DEV_Digital_Write(EPD_CS_PIN_3, HIGH);
+
+	Bus->Exit();
 }
@@ -57,7 +57,16 @@
 #include <string.h>
 #include "Debug.h"
 
-#include <bcm2835.h>
+#ifdef USE_BCM2835_LIB
+    #include <bcm2835.h>
+#endif
+
+#ifndef HIGH
+    #define HIGH 1
+#endif
+#ifndef LOW
+    #define LOW  0
+#endif
 
 
 /**
@@ -103,24 +112,173 @@ extern int EPD_BUSY_PIN;
 #define UWORD   uint16_t
 #define UDOUBLE uint32_t
 
-extern int EPD_CS_PIN;
-extern int EPD_BUSY_PIN;
-extern int EPD_RST_PIN;
+/**
+ * Pins of one panel, see DEV_Get_Screen_Pins
+**/
+typedef struct {
+    UWORD CS;
+    UWORD BUSY;
+    UWORD RST;
+} DEV_PINS;
+
+/**
+ * GPIO direction for DEV_BUS.GPIO_Mode
+**/
+#define DEV_GPIO_INPUT  0
+#define DEV_GPIO_OUTPUT 1
+
+/**
+ * spidev backend defaults, can be overridden from the Makefile
+**/
+#ifndef DEV_SPIDEV_PATH
+    #define DEV_SPIDEV_PATH   "/dev/spidev0.0"
+#endif
+#ifndef DEV_GPIOCHIP_PATH
+    #define DEV_GPIOCHIP_PATH "/dev/gpiochip0"
+#endif
+#ifndef DEV_SPI_SPEED_HZ
+    #define DEV_SPI_SPEED_HZ  3906250     //same as BCM2835_SPI_CLOCK_DIVIDER_64 on a 250MHz core
+#endif
+
+/**
+ * Bus backend
+ * Everything DEV_Config.c does to the hardware goes through one of these.
+ * Select one with DEV_Set_Bus()/DEV_Select_Bus() before DEV_Module_Init(),
+ * or with the EPD_BUS environment variable ("bcm2835", "spidev", "fake",
+ * "emu").
+**/
+typedef struct DEV_BUS {
+    const char *Name;
+    UBYTE (*Init)(void);                                //0: success
+    void  (*Exit)(void);
+    void  (*GPIO_Mode)(UWORD Pin, UWORD Mode);
+    void  (*Digital_Write)(UWORD Pin, UBYTE Value);
+    UBYTE (*Digital_Read)(UWORD Pin);
+    UBYTE (*SPI_Transfer)(UBYTE Value);
+    void  (*SPI_Write_nByte)(UBYTE *pData, UDOUBLE Len);
+    void  (*SPI_Read_nByte)(UBYTE *pData, UDOUBLE Len);   //clocks out zeros
+    //bulk writes run at Write_Hz, reads and single byte transfers at Read_Hz
+    void  (*SPI_Set_Speed)(UDOUBLE Write_Hz, UDOUBLE Read_Hz);
+    void  (*Delay_us)(UDOUBLE xus);
+    //optional, sleep until Pin reads Level (0) or Timeout_us passes (1),
+    //NULL falls back to polling with a growing sleep
+    UBYTE (*Wait_Level)(UWORD Pin, UBYTE Level, UDOUBLE Timeout_us);
+} DEV_BUS;
+
+#ifdef USE_BCM2835_LIB
+extern const DEV_BUS DEV_Bus_BCM2835;
+#endif
+extern const DEV_BUS DEV_Bus_Spidev;
+extern const DEV_BUS DEV_Bus_Fake;
+extern const DEV_BUS DEV_Bus_Emu;
+
+/**
+ * Fake bus: records every byte written, BUSY always reads idle
+**/
+typedef struct {
+    UDOUBLE Bytes_Written;
+    UDOUBLE Bytes_Read;
+    UDOUBLE SPI_Calls;          //number of backend SPI calls
+    UDOUBLE CS_Assertions;      //falling edges on EPD_CS_PIN_1..3
+    UDOUBLE Busy_Reads;         //reads of EPD_BUSY_PIN_1..3
+    UDOUBLE Delay_us;           //requested delay, not slept
+    UDOUBLE Write_Hz;           //last DEV_SPI_Set_Speed
+    UDOUBLE Read_Hz;
+} DEV_FAKE_STATS;
+
+void DEV_Fake_Reset(void);
+UBYTE *DEV_Fake_Get_Log(UDOUBLE *Len);
+void DEV_Fake_Get_Stats(DEV_FAKE_STATS *Stats);
+void DEV_Fake_Set_Read_Handler(UBYTE (*Handler)(void));
+
+/**
+ * Emulator bus: an IT8951 model behind each of EPD_CS_PIN_1..3, with SDRAM,
+ * panel image and HRDY / LUTAFSR timing, see DEV_Bus_Emu.c
+**/
+#ifndef DEV_EMU_PANEL_W
+    #define DEV_EMU_PANEL_W     1872
+#endif
+#ifndef DEV_EMU_PANEL_H
+    #define DEV_EMU_PANEL_H     1404
+#endif
+#define DEV_EMU_SDRAM_SIZE      0x4000000   //26 address bits, the most DEV_Emu_Set_SDRAM_Size takes
+#define DEV_EMU_IMAGE_ADDR      0x001236E0  //reported by GET_DEV_INFO, shown by DPY_AREA
+#define DEV_EMU_BOOT_US         5000        //HRDY low after reset
+#define DEV_EMU_WAKE_US         1000        //HRDY low after SYS_RUN from standby or sleep
+
+typedef struct {
+    UDOUBLE Transactions;       //CS assertions
+    UDOUBLE Bytes_Written;
+    UDOUBLE Bytes_Read;
+    UDOUBLE Commands;
+    UDOUBLE Displays;           //DPY_AREA and DPY_BUF_AREA
+    UDOUBLE Pixels_Loaded;
+    UDOUBLE Busy_Reads;         //HRDY reads
+    UDOUBLE Overlaps;           //display commands over a running waveform
+    UDOUBLE Errors;             //traffic a controller would not take
+    uint64_t Wire_ns;           //bytes at the clocks of DEV_SPI_Set_Speed
+    uint64_t Waveform_us;       //modeled LUT time of the display commands
+} DEV_EMU_STATS;
+
+void DEV_Emu_Set_Panel(UWORD Width, UWORD Height);
+void DEV_Emu_Set_SDRAM_Size(UDOUBLE Size);
+void DEV_Emu_Set_Time_Scale(double Scale);
+void DEV_Emu_Get_Stats(int Screen, DEV_EMU_STATS *Stats);
+void DEV_Emu_Reset_Stats(void);
+const UBYTE *DEV_Emu_Get_Panel(int Screen, UWORD *Width, UWORD *Height);
+UBYTE DEV_Emu_Dump_PGM(int Screen, const char *Path);
+
+
+/**
+ * Pin wait: a short bounded spin, then edge events or a backoff sleep
+**/
+#ifndef DEV_BUSY_SPIN_COUNT
+    #define DEV_BUSY_SPIN_COUNT   200     //pin reads before going to sleep
+#endif
+#define DEV_BUSY_SLEEP_MIN_US     20      //first poll interval without edge events
+#define DEV_BUSY_SLEEP_MAX_US     2000    //poll interval cap without edge events
+
+typedef struct {
+    UDOUBLE Waits;              //calls to DEV_Wait_Pin
+    UDOUBLE Spin_Hits;          //satisfied during the spin phase
+    UDOUBLE Sleeps;             //had to sleep (edge event or poll)
+    UDOUBLE Timeouts;
+    uint64_t Total_Wait_us;     //time spent inside DEV_Wait_Pin
+    UDOUBLE Max_Wait_us;
+} DEV_WAIT_STATS;
 
 
 /*------------------------------------------------------------------------------------------------------*/
+void DEV_Set_Bus(const DEV_BUS *Bus);
+UBYTE DEV_Select_Bus(const char *Name);
+const DEV_BUS *DEV_Get_Bus(void);
+
 void DEV_Digital_Write(UWORD Pin, UBYTE Value);
 UBYTE DEV_Digital_Read(UWORD Pin);
 
 void DEV_SPI_WriteByte(UBYTE Value);
+void DEV_SPI_Write_nByte(UBYTE *pData, UDOUBLE Len);
+void DEV_SPI_Read_nByte(UBYTE *pData, UDOUBLE Len);
+void DEV_SPI_Set_Speed(UDOUBLE Write_Hz, UDOUBLE Read_Hz);
+void DEV_SPI_Get_Speed(UDOUBLE *Write_Hz, UDOUBLE *Read_Hz);
 UBYTE DEV_SPI_ReadByte();
 
 void DEV_Delay_ms(UDOUBLE xms);
 void DEV_Delay_us(UDOUBLE xus);
+uint64_t DEV_Time_us(void);
+
+UBYTE DEV_Wait_Pin(UWORD Pin, UBYTE Level, UDOUBLE Timeout_ms);
+void DEV_Set_Busy_Spin(UDOUBLE Spin_Count);
+void DEV_Get_Wait_Stats(DEV_WAIT_STATS *Stats);
+void DEV_Reset_Wait_Stats(void);
+
+void DEV_Bus_Lock(void);
+void DEV_Bus_Unlock(void);
 
 UBYTE DEV_Module_Init(void);
 void DEV_Module_Exit(void);
+void DEV_Module_Detach(void);
 
-void swapSCREEN(int screen);
+UBYTE DEV_Get_Screen_Pins(int Screen, DEV_PINS *Pins);
 
 #endif
@@ -0,0 +1,287 @@
+/*****************************************************************************
+* | File      	:   GUI_Canvas.c
+* | Author      :   IT8951-ePaper contributors
+* | Function    :   One drawing surface spanning several IT8951 panels
+* | Info        :
+*                The canvas is a Paint image as large as the panels put side
+*                by side or stacked, with Bezel pixels between neighbours
+*                that no panel shows, so lines cross the gap at the right
+*                place. Draw with the Paint functions, mark what changed with
+*                Canvas_Damage and Canvas_Refresh cuts the damage up per
+*                panel and hands the pieces to one scheduler worker each
+*----------------
+* |	This version:   V1.0
+* | Date        :   2026-10-18
+* | Info        :
+* -----------------------------------------------------------------------------
+* -----------------------------------------------------------------------------
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documnetation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to  whom the Software is
+# furished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS OR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+# THE SOFTWARE.
+#
+******************************************************************************/
+#include "GUI_Canvas.h"
+#include "GUI_Paint.h"
+#include "../Config/Debug.h"
+#include <stdlib.h>
+#include <string.h> //memcpy()
+
+/******************************************************************************
+function: Set up a canvas over the panels
+parameter:
+    Devs         : Opened and initialized panels, left to right or top to bottom
+    Layout       : CANVAS_ROW or CANVAS_COLUMN
+    Bezel        : Pixels hidden between two panels
+    BitsPerPixel : 1, 2, 4 or 8
+Info:
+    Selects the canvas for Paint. Returns 0, or 1 on bad parameters or
+    when memory or the scheduler threads are not available.
+******************************************************************************/
+UBYTE Canvas_Init(CANVAS *Canvas, IT8951_Dev **Devs, UBYTE Count, UBYTE Layout, UWORD Bezel, UBYTE BitsPerPixel)
+{
+    UWORD Pos = 0;
+
+    memset(Canvas, 0, sizeof(CANVAS));
+    if(Count == 0 || Count > IT8951_SCHED_PANELS) {
+        Debug("Canvas: 1 to %d panels\r\n", IT8951_SCHED_PANELS);
+        return 1;
+    }
+    if(BitsPerPixel != 1 && BitsPerPixel != 2 && BitsPerPixel != 4 && BitsPerPixel != 8) {
+        Debug("Canvas: BitsPerPixel Only support: 1 2 4 8\r\n");
+        return 1;
+    }
+
+    for(UBYTE i = 0; i < Count; i++) {
+        CANVAS_PANEL *Panel = &Canvas->Panel[i];
+        IT8951_Dev *Dev = Devs[i];
+        UWORD Width, Height;
+
+        //upright, whatever orientation the panel was given
+        EPD_IT8951_Get_Canvas_Size(Dev, &Width, &Height);
+        Panel->Dev = Dev;
+        Panel->Width = Width;
+        if(Dev->Four_Byte_Align == true)
+            Panel->Width -= Width % 32;
+        Panel->Height = Height;
+        Panel->Target_Memory_Addr = Dev->Info.Memory_Addr_L | (Dev->Info.Memory_Addr_H << 16);
+
+        if(Layout == CANVAS_ROW) {
+            Panel->X = Pos;
+            Panel->Y = 0;
+            Pos += Width + Bezel;
+            if(Canvas->Height < Height)
+                Canvas->Height = Height;
+        } else {
+            Panel->X = 0;
+            Panel->Y = Pos;
+            Pos += Height + Bezel;
+            if(Canvas->Width < Width)
+                Canvas->Width = Width;
+        }
+
+        Panel->Stage = (UBYTE *)malloc(((Panel->Width * BitsPerPixel + 7) / 8) * Panel->Height);
+        if(Panel->Stage == NULL) {
+            Debug("Canvas: Failed to apply for panel memory...\r\n");
+            Canvas->Panel_Count = i + 1;
+            Canvas_Exit(Canvas);
+            return 1;
+        }
+    }
+    Canvas->Panel_Count = Count;
+    if(Layout == CANVAS_ROW)
+        Canvas->Width = Pos - Bezel;
+    else
+        Canvas->Height = Pos - Bezel;
+    Canvas->BitsPerPixel = BitsPerPixel;
+
+    //one spare byte, rows are read two bytes at a time when a panel starts mid-byte
+    UDOUBLE Imagesize = ((Canvas->Width * BitsPerPixel + 7) / 8) * Canvas->Height + 1;
+    Canvas->Image = (UBYTE *)malloc(Imagesize);
+    if(Canvas->Image == NULL) {
+        Debug("Canvas: Failed to apply for canvas memory...\r\n");
+        Canvas_Exit(Canvas);
+        return 1;
+    }
+    memset(Canvas->Image, WHITE, Imagesize);
+
+    if(EPD_IT8951_Sched_Start(&Canvas->Sched, Devs, Count) != 0) {
+        free(Canvas->Image);
+        Canvas->Image = NULL;
+        Canvas_Exit(Canvas);
+        return 1;
+    }
+
+    Canvas_Select(Canvas);
+    return 0;
+}
+
+/******************************************************************************
+function: Make the canvas the Paint image again
+parameter:
+Info:
+    After Paint was used on another image in between
+******************************************************************************/
+void Canvas_Select(CANVAS *Canvas)
+{
+    Paint_NewImage(Canvas->Image, Canvas->Width, Canvas->Height, ROTATE_0, WHITE);
+    Paint_SelectImage(Canvas->Image);
+    Paint_SetBitsPerPixel(Canvas->BitsPerPixel);
+}
+
+/******************************************************************************
+function: Mark a changed rectangle
+parameter:
+    Xend, Yend : exclusive, as for Paint_ClearWindows
+Info:
+    Grows the damaged rectangle, the next Canvas_Refresh sends it
+******************************************************************************/
+void Canvas_Damage(CANVAS *Canvas, UWORD Xstart, UWORD Ystart, UWORD Xend, UWORD Yend)
+{
+    if(Xend > Canvas->Width)
+        Xend = Canvas->Width;
+    if(Yend > Canvas->Height)
+        Yend = Canvas->Height;
+    if(Xstart >= Xend || Ystart >= Yend)
+        return;
+
+    if(Canvas->Damage_Xstart >= Canvas->Damage_Xend) {
+        Canvas->Damage_Xstart = Xstart;
+        Canvas->Damage_Ystart = Ystart;
+        Canvas->Damage_Xend = Xend;
+        Canvas->Damage_Yend = Yend;
+        return;
+    }
+    if(Canvas->Damage_Xstart > Xstart)
+        Canvas->Damage_Xstart = Xstart;
+    if(Canvas->Damage_Ystart > Ystart)
+        Canvas->Damage_Ystart = Ystart;
+    if(Canvas->Damage_Xend < Xend)
+        Canvas->Damage_Xend = Xend;
+    if(Canvas->Damage_Yend < Yend)
+        Canvas->Damage_Yend = Yend;
+}
+
+void Canvas_Damage_All(CANVAS *Canvas)
+{
+    Canvas_Damage(Canvas, 0, 0, Canvas->Width, Canvas->Height);
+}
+
+/******************************************************************************
+function: Copy a panel's share of the canvas into its stage buffer
+parameter:
+    Xstart, Width : panel coordinates, whole bytes of the stage
+Info:
+    Rows are copied as they are when the panel starts on a byte boundary
+    of the canvas, otherwise shifted into place a byte at a time. Paint
+    keeps the leftmost pixel of a byte in the low bits.
+******************************************************************************/
+static void Canvas_Stage(CANVAS *Canvas, CANVAS_PANEL *Panel, UWORD Xstart, UWORD Ystart, UWORD Width, UWORD Height)
+{
+    UWORD WidthByte = (Canvas->Width * Canvas->BitsPerPixel + 7) / 8;
+    UWORD Stage_WidthByte = Width * Canvas->BitsPerPixel / 8;
+    UDOUBLE Bit = (UDOUBLE)(Panel->X + Xstart) * Canvas->BitsPerPixel;
+    UBYTE Shift = Bit % 8;
+
+    for(UWORD j = 0; j < Height; j++) {
+        UBYTE *Src = Canvas->Image + (UDOUBLE)(Panel->Y + Ystart + j) * WidthByte + Bit / 8;
+        UBYTE *Dst = Panel->Stage + (UDOUBLE)j * Stage_WidthByte;
+
+        if(Shift == 0) {
+            memcpy(Dst, Src, Stage_WidthByte);
+        } else {
+            for(UWORD i = 0; i < Stage_WidthByte; i++)
+                Dst[i] = (Src[i] >> Shift) | (Src[i + 1] << (8 - Shift));
+        }
+    }
+}
+
+/******************************************************************************
+function: Send the damaged rectangle to the panels
+parameter:
+    Mode : waveform for 1bpp canvases, the others refresh with GC16_Mode
+Info:
+    Each panel gets the part of the damage it shows, widened to its write
+    alignment, in its own Target_Memory_Addr. The uploads go through the
+    scheduler so they overlap each other's HRDY and waveform waits.
+    Returns once every panel has started its waveform, with the first
+    error a panel reported.
+******************************************************************************/
+UBYTE Canvas_Refresh(CANVAS *Canvas, UBYTE Mode)
+{
+    if(Canvas->Damage_Xstart >= Canvas->Damage_Xend)
+        return IT8951_OK;
+
+    for(UBYTE i = 0; i < Canvas->Panel_Count; i++) {
+        CANVAS_PANEL *Panel = &Canvas->Panel[i];
+        UWORD Align = (Panel->Dev->Four_Byte_Align == true) ? 32 : 16;
+        IT8951_Sched_Job Job;
+
+        //intersect, then to panel coordinates
+        if(Canvas->Damage_Xend <= Panel->X || Canvas->Damage_Xstart >= Panel->X + Panel->Width
+            || Canvas->Damage_Yend <= Panel->Y || Canvas->Damage_Ystart >= Panel->Y + Panel->Height)
+            continue;
+        UWORD Xstart = (Canvas->Damage_Xstart > Panel->X) ? Canvas->Damage_Xstart - Panel->X : 0;
+        UWORD Ystart = (Canvas->Damage_Ystart > Panel->Y) ? Canvas->Damage_Ystart - Panel->Y : 0;
+        UWORD Xend = Canvas->Damage_Xend - Panel->X;
+        UWORD Yend = Canvas->Damage_Yend - Panel->Y;
+        if(Xend > Panel->Width)
+            Xend = Panel->Width;
+        if(Yend > Panel->Height)
+            Yend = Panel->Height;
+
+        Xstart -= Xstart % Align;
+        Xend += (Xend % Align) ? Align - Xend % Align : 0;
+        if(Xend > Panel->Width)
+            Xend = Panel->Width;
+
+        Canvas_Stage(Canvas, Panel, Xstart, Ystart, Xend - Xstart, Yend - Ystart);
+
+        Job.Bits_Per_Pixel = Canvas->BitsPerPixel;
+        Job.Frame_Buf = Panel->Stage;
+        Job.X = Xstart;
+        Job.Y = Ystart;
+        Job.W = Xend - Xstart;
+        Job.H = Yend - Ystart;
+        Job.Mode = Mode;
+        Job.Hold = false;
+        Job.Target_Memory_Addr = Panel->Target_Memory_Addr;
+        Job.Priority = IT8951_SCHED_BULK;
+        EPD_IT8951_Sched_Submit(&Canvas->Sched, i, &Job);
+    }
+
+    Canvas->Damage_Xstart = Canvas->Damage_Xend = 0;
+    //the stage buffers are free again once the queues are empty
+    return EPD_IT8951_Sched_Flush(&Canvas->Sched, false);
+}
+
+/******************************************************************************
+function: Stop the scheduler and free the canvas
+parameter:
+******************************************************************************/
+void Canvas_Exit(CANVAS *Canvas)
+{
+    //the scheduler runs once the image is there
+    if(Canvas->Image != NULL)
+        EPD_IT8951_Sched_Stop(&Canvas->Sched);
+    for(UBYTE i = 0; i < Canvas->Panel_Count; i++) {
+        free(Canvas->Panel[i].Stage);
+        Canvas->Panel[i].Stage = NULL;
+    }
+    free(Canvas->Image);
+    Canvas->Image = NULL;
+}
@@ -0,0 +1,80 @@
+/*****************************************************************************
+* | File      	:   GUI_Canvas.h
+* | Author      :   IT8951-ePaper contributors
+* | Function    :   One drawing surface spanning several IT8951 panels
+* | Info        :
+*----------------
+* |	This version:   V1.0
+* | Date        :   2026-10-18
+* | Info        :
+* -----------------------------------------------------------------------------
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documnetation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to  whom the Software is
+# furished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS OR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+# THE SOFTWARE.
+#
+******************************************************************************/
+#ifndef __GUI_CANVAS_H
+#define __GUI_CANVAS_H
+
+#include "../Config/DEV_Config.h"
+#include "../e-Paper/EPD_IT8951_Sched.h"
+
+/**
+ * Panel arrangement, panels are placed in the order they are given
+**/
+#define CANVAS_ROW          0   //side by side, left to right
+#define CANVAS_COLUMN       1   //stacked, top to bottom
+
+/**
+ * One physical panel, in canvas coordinates
+**/
+typedef struct {
+    IT8951_Dev *Dev;
+    UWORD X;
+    UWORD Y;
+    UWORD Width;                //the part that is refreshed, 4-byte aligned if the panel needs it
+    UWORD Height;
+    UDOUBLE Target_Memory_Addr;
+    UBYTE *Stage;               //the panel's share of the damage, kept until the refresh returns
+} CANVAS_PANEL;
+
+/**
+ * Canvas attributes
+**/
+typedef struct {
+    UBYTE *Image;               //Paint image of the whole canvas, bezels included
+    UWORD Width;
+    UWORD Height;
+    UWORD BitsPerPixel;
+    CANVAS_PANEL Panel[IT8951_SCHED_PANELS];
+    UBYTE Panel_Count;
+    UWORD Damage_Xstart;        //damaged rectangle, Xend/Yend exclusive, empty while Xstart >= Xend
+    UWORD Damage_Ystart;
+    UWORD Damage_Xend;
+    UWORD Damage_Yend;
+    IT8951_Sched Sched;
+} CANVAS;
+
+UBYTE Canvas_Init(CANVAS *Canvas, IT8951_Dev **Devs, UBYTE Count, UBYTE Layout, UWORD Bezel, UBYTE BitsPerPixel);
+void Canvas_Select(CANVAS *Canvas);
+void Canvas_Damage(CANVAS *Canvas, UWORD Xstart, UWORD Ystart, UWORD Xend, UWORD Yend);
+void Canvas_Damage_All(CANVAS *Canvas);
+UBYTE Canvas_Refresh(CANVAS *Canvas, UBYTE Mode);
+void Canvas_Exit(CANVAS *Canvas);
+
+#endif
@@ -179,44 +179,48 @@ void Paint_SetPixel(UWORD Xpoint, UWORD Ypoint, UWORD Color)
         //Debug("Exceeding display boundaries\r\n");
         return;
     }      
-    UWORD X, Y;
-
-    switch(Paint.Rotate) {
-    case 0:
-        X = Xpoint;
-        Y = Ypoint;  
-        break;
-    case 90:
-        X = Paint.WidthMemory - Ypoint - 1;
-        Y = Xpoint;
-        break;
-    case 180:
-        X = Paint.WidthMemory - Xpoint - 1;
-        Y = Paint.HeightMemory - Ypoint - 1;
-        break;
-    case 270:
-        X = Ypoint;
-        Y = Paint.HeightMemory - Xpoint - 1;
-        break;
-    default:
-        return;
-    }
+    UWORD X = Xpoint, Y = Ypoint;
+
+    //canvases are drawn upright and turned by EPD_IT8951_Set_Orientation,
+    //only a rotated or mirrored Paint image pays for the transform
+    if(Paint.Rotate != 0 || Paint.Mirror != MIRROR_NONE) {
+        switch(Paint.Rotate) {
+        case 0:
+            X = Xpoint;
+            Y = Ypoint;  
+            break;
+        case 90:
+            X = Paint.WidthMemory - Ypoint - 1;
+            Y = Xpoint;
+            break;
+        case 180:
+            X = Paint.WidthMemory - Xpoint - 1;
+            Y = Paint.HeightMemory - Ypoint - 1;
+            break;
+        case 270:
+            X = Ypoint;
+            Y = Paint.HeightMemory - Xpoint - 1;
+            break;
+        default:
+            return;
+        }
     
-    switch(Paint.Mirror) {
-    case MIRROR_NONE:
-        break;
-    case MIRROR_HORIZONTAL:
-        X = Paint.WidthMemory - X - 1;
-        break;
-    case MIRROR_VERTICAL:
-        Y = Paint.HeightMemory - Y - 1;
-        break;
-    case MIRROR_ORIGIN:
-        X = Paint.WidthMemory - X - 1;
-        Y = Paint.HeightMemory - Y - 1;
-        break;
-    default:
-        return;
+        switch(Paint.Mirror) {
+        case MIRROR_NONE:
+            break;
+        case MIRROR_HORIZONTAL:
+            X = Paint.WidthMemory - X - 1;
+            break;
+        case MIRROR_VERTICAL:
+            Y = Paint.HeightMemory - Y - 1;
+            break;
+        case MIRROR_ORIGIN:
+            X = Paint.WidthMemory - X - 1;
+            Y = Paint.HeightMemory - Y - 1;
+            break;
+        default:
+            return;
+        }
     }
 
     if(X > Paint.WidthMemory || Y > Paint.HeightMemory){
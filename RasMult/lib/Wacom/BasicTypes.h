@@ -49,6 +49,7 @@ struct TabletData{
     double transformedX;
     double transformedY;
     bool   touchDown;
+    bool   inProximity;     // pen within sensing range, hovering or touching
 };
 
 
@@ -410,6 +410,8 @@ void WacomI2CHandler::prepareDataForMouseEmulator()
     tabletData->transformedX = (x * deviceInfo->xScale) + deviceInfo->xOffset;
     tabletData->transformedY = (y * deviceInfo->yScale) + deviceInfo->yOffset;
     
+    tabletData->inProximity = inRange;
+
     if (penData.hoverHeight <= deviceInfo->touchdownHeight){
         tabletData->touchDown = true;
     } else{
@@ -31,40 +31,343 @@
 #include "EPD_IT8951.h"
 #include <time.h>
 
-//basic mode definition
-UBYTE INIT_Mode = 0;
-UBYTE GC16_Mode = 2;
-//A2_Mode's value is not fixed, is decide by firmware's LUT 
-UBYTE A2_Mode = 6;
+//staging buffer for bulk transfers, see EPD_IT8951_WriteMuitiData; only
+//used between EPD_IT8951_Select and _Deselect, so the bus lock covers it
+static UBYTE SPI_Chunk_Buf[IT8951_SPI_CHUNK_SIZE];
+
+//registers only the host changes, kept in IT8951_Dev.Shadow_Reg, see
+//EPD_IT8951_ReadReg / EPD_IT8951_WriteReg
+static const UWORD Shadow_Reg_Addr[IT8951_SHADOW_REGS] = {
+    I80CPCR, LISAR, LISAR+2, UP1SR, UP1SR+2, BGVR,
+};
+
+
+/******************************************************************************
+function :	Take / release the SPI bus for one transaction
+parameter:
+Info:
+    Switches the bus clock to the panel's own when it has one, other
+    handles may have left it elsewhere. Mirrors are selected along, see
+    EPD_IT8951_Broadcast_Refresh.
+******************************************************************************/
+static void EPD_IT8951_Select(IT8951_Dev* Dev)
+{
+    UDOUBLE Write_Hz, Read_Hz;
+
+    DEV_Bus_Lock();
+    if(Dev->SPI_Write_Hz != 0 && Dev->SPI_Read_Hz != 0) {
+        DEV_SPI_Get_Speed(&Write_Hz, &Read_Hz);
+        if(Write_Hz != Dev->SPI_Write_Hz || Read_Hz != Dev->SPI_Read_Hz)
+            DEV_SPI_Set_Speed(Dev->SPI_Write_Hz, Dev->SPI_Read_Hz);
+    }
+    DEV_Digital_Write(Dev->CS_Pin, LOW);
+    for(UBYTE i = 0; i < Dev->Mirror_Count; i++)
+        DEV_Digital_Write(Dev->Mirror[i]->CS_Pin, LOW);
+}
+
+static void EPD_IT8951_Deselect(IT8951_Dev* Dev)
+{
+    DEV_Digital_Write(Dev->CS_Pin, HIGH);
+    for(UBYTE i = 0; i < Dev->Mirror_Count; i++)
+        DEV_Digital_Write(Dev->Mirror[i]->CS_Pin, HIGH);
+    DEV_Bus_Unlock();
+}
+
+
+/******************************************************************************
+function :	Public call prologue / epilogue
+parameter:
+Info:
+    Holds the handle's lock for the whole call and clears the sticky
+    error, Leave returns it
+******************************************************************************/
+static void EPD_IT8951_Enter(IT8951_Dev* Dev)
+{
+    pthread_mutex_lock(&Dev->Lock);
+    Dev->Busy_Error = IT8951_OK;
+}
+
+static UBYTE EPD_IT8951_Leave(IT8951_Dev* Dev)
+{
+    UBYTE Error = Dev->Busy_Error;
+
+    //a stream with a failed call in it does not replay the same
+    if(Error != IT8951_OK && Dev->Recording != NULL && Dev->Recording->Error == IT8951_OK)
+        Dev->Recording->Error = Error;
+    pthread_mutex_unlock(&Dev->Lock);
+    return Error;
+}
+
+
+/******************************************************************************
+function :	Append to the stream being recorded
+parameter:
+Info:
+    Fields are little endian, transfer words are kept in wire order so a
+    replay hands them to the SPI layer untouched. The op layouts:
+    CMD    command word
+    DATA   word count, then the words
+    READ   word count, the words are read and dropped
+    WAIT   match, then an area, see EPD_IT8951_Wait_Regions
+    REGION the display command just sent, see EPD_IT8951_Region_Start
+******************************************************************************/
+#define IT8951_RECORD_VERSION      1
+#define IT8951_RECORD_HEADER       12   //magic, version, panel W, H and image pitch
+#define IT8951_RECORD_AREA         22   //X, Y, W, H, Mem_Addr, Mem_X, _Y, _W, _H, Mode
+
+#define IT8951_OP_CMD              1
+#define IT8951_OP_DATA             2
+#define IT8951_OP_READ             3
+#define IT8951_OP_WAIT             4
+#define IT8951_OP_REGION           5
+
+#define IT8951_MATCH_ALL           0
+#define IT8951_MATCH_PANEL         1
+#define IT8951_MATCH_MEMORY        2
+
+static const UBYTE Record_Magic[4] = {'I', 'T', '8', 'R'};
+
+static void EPD_IT8951_Put16(UBYTE* Buf, UWORD Value)
+{
+    Buf[0] = Value;
+    Buf[1] = Value >> 8;
+}
+
+static void EPD_IT8951_Put32(UBYTE* Buf, UDOUBLE Value)
+{
+    EPD_IT8951_Put16(Buf, Value);
+    EPD_IT8951_Put16(Buf + 2, Value >> 16);
+}
+
+static UWORD EPD_IT8951_Get16(const UBYTE* Buf)
+{
+    return Buf[0] | (Buf[1] << 8);
+}
+
+static UDOUBLE EPD_IT8951_Get32(const UBYTE* Buf)
+{
+    return EPD_IT8951_Get16(Buf) | ((UDOUBLE)EPD_IT8951_Get16(Buf + 2) << 16);
+}
+
+//room for Len more bytes at the end of the stream, NULL when recording
+//is off or out of memory
+static UBYTE* EPD_IT8951_Record_Grow(IT8951_Dev* Dev, UDOUBLE Len)
+{
+    IT8951_Recording* Rec = Dev->Recording;
+    UBYTE* Tail;
+
+    if(Rec == NULL || Dev->Record_Hold != 0 || Rec->Error != IT8951_OK)
+        return NULL;
+
+    if(Rec->Len + Len > Rec->Size) {
+        UDOUBLE New_Size = Rec->Size ? Rec->Size : 65536;
+        while(New_Size < Rec->Len + Len)
+            New_Size *= 2;
+        UBYTE* New_Data = (UBYTE*)realloc(Rec->Data, New_Size);
+        if(New_Data == NULL) {
+            Debug("Recording: out of memory at %d bytes\r\n", Rec->Len);
+            Rec->Error = IT8951_ERR_RECORDING;
+            return NULL;
+        }
+        Rec->Data = New_Data;
+        Rec->Size = New_Size;
+    }
+    Tail = Rec->Data + Rec->Len;
+    Rec->Len += Len;
+    return Tail;
+}
+
+static void EPD_IT8951_Record_Cmd(IT8951_Dev* Dev, UWORD Command)
+{
+    UBYTE* Op = EPD_IT8951_Record_Grow(Dev, 3);
+
+    if(Op == NULL)
+        return;
+    Op[0] = IT8951_OP_CMD;
+    EPD_IT8951_Put16(Op + 1, Command);
+}
+
+//Words in host order, or Wire already in wire order
+static void EPD_IT8951_Record_Data(IT8951_Dev* Dev, const UWORD* Words, const UBYTE* Wire, UDOUBLE Length)
+{
+    UBYTE* Op = EPD_IT8951_Record_Grow(Dev, 5 + Length*2);
+
+    if(Op == NULL)
+        return;
+    Op[0] = IT8951_OP_DATA;
+    EPD_IT8951_Put32(Op + 1, Length);
+    if(Wire != NULL) {
+        memcpy(Op + 5, Wire, Length*2);
+    } else {
+        for(UDOUBLE i = 0; i < Length; i++)
+        {
+            Op[5 + 2*i] = Words[i]>>8;
+            Op[5 + 2*i+1] = Words[i];
+        }
+    }
+}
+
+//Length copies of Value
+static void EPD_IT8951_Record_Repeat(IT8951_Dev* Dev, UWORD Value, UDOUBLE Length)
+{
+    UBYTE* Op = EPD_IT8951_Record_Grow(Dev, 5 + Length*2);
+
+    if(Op == NULL)
+        return;
+    Op[0] = IT8951_OP_DATA;
+    EPD_IT8951_Put32(Op + 1, Length);
+    for(UDOUBLE i = 0; i < Length; i++)
+    {
+        Op[5 + 2*i] = Value>>8;
+        Op[5 + 2*i+1] = Value;
+    }
+}
+
+static void EPD_IT8951_Record_Read(IT8951_Dev* Dev, UDOUBLE Length)
+{
+    UBYTE* Op = EPD_IT8951_Record_Grow(Dev, 5);
+
+    if(Op == NULL)
+        return;
+    Op[0] = IT8951_OP_READ;
+    EPD_IT8951_Put32(Op + 1, Length);
+}
+
+static void EPD_IT8951_Record_Area(IT8951_Dev* Dev, UBYTE Kind, UBYTE Match, const IT8951_Region* Area)
+{
+    UBYTE* Op = EPD_IT8951_Record_Grow(Dev, 2 + IT8951_RECORD_AREA);
+    IT8951_Region None;
+
+    if(Op == NULL)
+        return;
+    if(Area == NULL) {
+        memset(&None, 0, sizeof(None));
+        Area = &None;
+    }
+    Op[0] = Kind;
+    Op[1] = Match;
+    Op += 2;
+    EPD_IT8951_Put16(Op + 0, Area->X);
+    EPD_IT8951_Put16(Op + 2, Area->Y);
+    EPD_IT8951_Put16(Op + 4, Area->W);
+    EPD_IT8951_Put16(Op + 6, Area->H);
+    EPD_IT8951_Put32(Op + 8, Area->Mem_Addr);
+    EPD_IT8951_Put16(Op + 12, Area->Mem_X);
+    EPD_IT8951_Put16(Op + 14, Area->Mem_Y);
+    EPD_IT8951_Put16(Op + 16, Area->Mem_W);
+    EPD_IT8951_Put16(Op + 18, Area->Mem_H);
+    EPD_IT8951_Put16(Op + 20, Area->Mode);
+}
+
+static void EPD_IT8951_Get_Area(const UBYTE* Op, IT8951_Region* Area)
+{
+    memset(Area, 0, sizeof(*Area));
+    Area->X = EPD_IT8951_Get16(Op + 0);
+    Area->Y = EPD_IT8951_Get16(Op + 2);
+    Area->W = EPD_IT8951_Get16(Op + 4);
+    Area->H = EPD_IT8951_Get16(Op + 6);
+    Area->Mem_Addr = EPD_IT8951_Get32(Op + 8);
+    Area->Mem_X = EPD_IT8951_Get16(Op + 12);
+    Area->Mem_Y = EPD_IT8951_Get16(Op + 14);
+    Area->Mem_W = EPD_IT8951_Get16(Op + 16);
+    Area->Mem_H = EPD_IT8951_Get16(Op + 18);
+    Area->Mode = EPD_IT8951_Get16(Op + 20);
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Open
+parameter:
+    Pins : CS, BUSY and RST of the panel, see DEV_Get_Screen_Pins
+Info:
+    Fills in the defaults, no bus traffic; EPD_IT8951_Init or _Attach
+    next. DEV_Module_Init is done once for all handles.
+    return 0, or 1 when the lock could not be created
+******************************************************************************/
+UBYTE EPD_IT8951_Open(IT8951_Dev* Dev, const DEV_PINS* Pins)
+{
+    pthread_mutexattr_t Attr;
+    int Result;
+
+    memset(Dev, 0, sizeof(*Dev));
+    Dev->CS_Pin = Pins->CS;
+    Dev->Busy_Pin = Pins->BUSY;
+    Dev->Rst_Pin = Pins->RST;
+
+    Dev->INIT_Mode = 0;
+    Dev->GC16_Mode = 2;
+    Dev->A2_Mode = 6;
+
+    Dev->Load_Endian_Type = IT8951_LDIMG_B_ENDIAN;
+    Dev->Busy_Timeout_ms = IT8951_BUSY_TIMEOUT_MS;
+    Dev->Display_Timeout_ms = IT8951_DISPLAY_TIMEOUT_MS;
+    Dev->Power_State = IT8951_POWER_RUN;
+    Dev->Standby_Idle_ms = IT8951_STANDBY_IDLE_MS;
+    Dev->Sleep_Idle_ms = IT8951_SLEEP_IDLE_MS;
+
+    pthread_mutexattr_init(&Attr);
+    pthread_mutexattr_settype(&Attr, PTHREAD_MUTEX_RECURSIVE);
+    Result = pthread_mutex_init(&Dev->Lock, &Attr);
+    pthread_mutexattr_destroy(&Attr);
+
+    return Result == 0 ? 0 : 1;
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Close
+parameter:
+Info:
+    Leaves the controller as it is
+******************************************************************************/
+void EPD_IT8951_Close(IT8951_Dev* Dev)
+{
+    pthread_mutex_destroy(&Dev->Lock);
+}
+
 
 /******************************************************************************
 function :	Software reset
 parameter:
+Info:
+    Only the pulse is timed, readiness is HRDY seen by the next command
 ******************************************************************************/
-static void EPD_IT8951_Reset(void)
+static void EPD_IT8951_Reset(IT8951_Dev* Dev)
 {
-    DEV_Digital_Write(EPD_RST_PIN, HIGH);
-    DEV_Delay_ms(200);
-    DEV_Digital_Write(EPD_RST_PIN, LOW);
-    DEV_Delay_ms(10);
-    DEV_Digital_Write(EPD_RST_PIN, HIGH);
-    DEV_Delay_ms(200);
+    DEV_Digital_Write(Dev->Rst_Pin, LOW);
+    DEV_Delay_ms(IT8951_RESET_PULSE_MS);
+    DEV_Digital_Write(Dev->Rst_Pin, HIGH);
+    //HRDY drops while the firmware boots, the first command waits it out
+    DEV_Delay_ms(IT8951_RESET_SETTLE_MS);
 }
 
 
 /******************************************************************************
 function :	Wait until the busy_pin goes HIGH
 parameter:
+Info:
+    return IT8951_OK, or IT8951_ERR_BUSY_TIMEOUT which is latched in
+    Busy_Error so the rest of the sequence is skipped
 ******************************************************************************/
-static void EPD_IT8951_ReadBusy(void)
+static UBYTE EPD_IT8951_ReadBusy(IT8951_Dev* Dev)
 {
-	// Debug("Busy ------\r\n");
-    UBYTE Busy_State = DEV_Digital_Read(EPD_BUSY_PIN);
+    if(Dev->Busy_Error != IT8951_OK)
+        return Dev->Busy_Error;
+
     //0: busy, 1: idle
-    while(Busy_State == 0) {
-        Busy_State = DEV_Digital_Read(EPD_BUSY_PIN);
+    if(DEV_Wait_Pin(Dev->Busy_Pin, HIGH, Dev->Busy_Timeout_ms) != 0) {
+        Debug("Busy timeout after %d ms\r\n", Dev->Busy_Timeout_ms);
+        Dev->Busy_Error = IT8951_ERR_BUSY_TIMEOUT;
     }
-	// Debug("Busy Release ------\r\n");
+    //a broadcast goes on when every panel is ready
+    for(UBYTE i = 0; i < Dev->Mirror_Count && Dev->Busy_Error == IT8951_OK; i++)
+    {
+        if(DEV_Wait_Pin(Dev->Mirror[i]->Busy_Pin, HIGH, Dev->Busy_Timeout_ms) != 0) {
+            Debug("Busy timeout on CS %d after %d ms\r\n", Dev->Mirror[i]->CS_Pin, Dev->Busy_Timeout_ms);
+            Dev->Busy_Error = IT8951_ERR_BUSY_TIMEOUT;
+        }
+    }
+    return Dev->Busy_Error;
 }
 
 
@@ -72,24 +375,29 @@ static void EPD_IT8951_ReadBusy(void)
 function :	write command
 parameter:  command
 ******************************************************************************/
-static void EPD_IT8951_WriteCommand(UWORD Command)
+static void EPD_IT8951_WriteCommand(IT8951_Dev* Dev, UWORD Command)
 {
 	//Set Preamble for Write Command
 	UWORD Write_Preamble = 0x6000;
 	
-	EPD_IT8951_ReadBusy();
+	if(EPD_IT8951_ReadBusy(Dev) != IT8951_OK)
+        return;
 
-    DEV_Digital_Write(EPD_CS_PIN, LOW);
+    EPD_IT8951_Select(Dev);
 	
 	DEV_SPI_WriteByte(Write_Preamble>>8);
 	DEV_SPI_WriteByte(Write_Preamble);
 	
-	EPD_IT8951_ReadBusy();	
+    if(EPD_IT8951_ReadBusy(Dev) != IT8951_OK) {
+        EPD_IT8951_Deselect(Dev);
+        return;
+    }
 	
 	DEV_SPI_WriteByte(Command>>8);
 	DEV_SPI_WriteByte(Command);
+    EPD_IT8951_Record_Cmd(Dev, Command);
 	
-	DEV_Digital_Write(EPD_CS_PIN, HIGH);
+	EPD_IT8951_Deselect(Dev);
 }
 
 
@@ -97,51 +405,153 @@ static void EPD_IT8951_WriteCommand(UWORD Command)
 function :	write data
 parameter:  data
 ******************************************************************************/
-static void EPD_IT8951_WriteData(UWORD Data)
+static void EPD_IT8951_WriteData(IT8951_Dev* Dev, UWORD Data)
 {
     //Set Preamble for Write Command
 	UWORD Write_Preamble = 0x0000;
 
-    EPD_IT8951_ReadBusy();
+    if(EPD_IT8951_ReadBusy(Dev) != IT8951_OK)
+        return;
 
-    DEV_Digital_Write(EPD_CS_PIN, LOW);
+    EPD_IT8951_Select(Dev);
 
 	DEV_SPI_WriteByte(Write_Preamble>>8);
 	DEV_SPI_WriteByte(Write_Preamble);
 
-    EPD_IT8951_ReadBusy();
+    if(EPD_IT8951_ReadBusy(Dev) != IT8951_OK) {
+        EPD_IT8951_Deselect(Dev);
+        return;
+    }
 
 	DEV_SPI_WriteByte(Data>>8);
 	DEV_SPI_WriteByte(Data);
+    EPD_IT8951_Record_Data(Dev, &Data, NULL, 1);
 
-    DEV_Digital_Write(EPD_CS_PIN, HIGH);
+    EPD_IT8951_Deselect(Dev);
 }
 
 
 /******************************************************************************
 function :	write multi data
 parameter:  data
+Info:
+    One preamble and one CS assertion for the whole buffer, the words are
+    converted to wire order in IT8951_SPI_CHUNK_SIZE pieces and each piece
+    is handed to the SPI layer in a single call
 ******************************************************************************/
-static void EPD_IT8951_WriteMuitiData(UWORD* Data_Buf, UDOUBLE Length)
+static void EPD_IT8951_WriteMuitiData(IT8951_Dev* Dev, UWORD* Data_Buf, UDOUBLE Length)
 {
     //Set Preamble for Write Command
 	UWORD Write_Preamble = 0x0000;
+    UDOUBLE Chunk_Length;
 
-    EPD_IT8951_ReadBusy();
+    if(EPD_IT8951_ReadBusy(Dev) != IT8951_OK)
+        return;
 
-    DEV_Digital_Write(EPD_CS_PIN, LOW);
+    EPD_IT8951_Select(Dev);
 
 	DEV_SPI_WriteByte(Write_Preamble>>8);
 	DEV_SPI_WriteByte(Write_Preamble);
 
-    EPD_IT8951_ReadBusy();
+    if(EPD_IT8951_ReadBusy(Dev) != IT8951_OK) {
+        EPD_IT8951_Deselect(Dev);
+        return;
+    }
+    EPD_IT8951_Record_Data(Dev, Data_Buf, NULL, Length);
 
-    for(UDOUBLE i = 0; i<Length; i++)
+    while(Length > 0)
+    {
+        Chunk_Length = (Length > IT8951_SPI_CHUNK_SIZE/2) ? IT8951_SPI_CHUNK_SIZE/2 : Length;
+        for(UDOUBLE i = 0; i<Chunk_Length; i++)
+        {
+            SPI_Chunk_Buf[2*i] = Data_Buf[i]>>8;
+            SPI_Chunk_Buf[2*i+1] = Data_Buf[i];
+        }
+        DEV_SPI_Write_nByte(SPI_Chunk_Buf, Chunk_Length*2);
+        Data_Buf += Chunk_Length;
+        Length -= Chunk_Length;
+    }
+
+    EPD_IT8951_Deselect(Dev);
+}
+
+
+
+/******************************************************************************
+function :	write multi byte
+parameter:  
+    Data_Buf : raw bytes, already in wire order
+    Length   : number of bytes, must be even
+Info:
+    Zero copy, the caller's buffer is handed straight to the SPI layer
+******************************************************************************/
+static void EPD_IT8951_WriteMultiByte(IT8951_Dev* Dev, UBYTE* Data_Buf, UDOUBLE Length)
+{
+    //Set Preamble for Write Command
+	UWORD Write_Preamble = 0x0000;
+
+    if(EPD_IT8951_ReadBusy(Dev) != IT8951_OK)
+        return;
+
+    EPD_IT8951_Select(Dev);
+
+	DEV_SPI_WriteByte(Write_Preamble>>8);
+	DEV_SPI_WriteByte(Write_Preamble);
+
+    if(EPD_IT8951_ReadBusy(Dev) != IT8951_OK) {
+        EPD_IT8951_Deselect(Dev);
+        return;
+    }
+
+    DEV_SPI_Write_nByte(Data_Buf, Length);
+    EPD_IT8951_Record_Data(Dev, NULL, Data_Buf, Length/2);
+
+    EPD_IT8951_Deselect(Dev);
+}
+
+
+
+/******************************************************************************
+function :	write repeated data
+parameter:  
+    Value  : word sent Length times
+Info:
+    Like EPD_IT8951_WriteMuitiData for a constant, one transaction with
+    no buffer of the whole length behind it
+******************************************************************************/
+static void EPD_IT8951_WriteRepeatData(IT8951_Dev* Dev, UWORD Value, UDOUBLE Length)
+{
+    //Set Preamble for Write Command
+	UWORD Write_Preamble = 0x0000;
+    UDOUBLE Chunk_Length;
+
+    if(EPD_IT8951_ReadBusy(Dev) != IT8951_OK)
+        return;
+
+    EPD_IT8951_Select(Dev);
+
+	DEV_SPI_WriteByte(Write_Preamble>>8);
+	DEV_SPI_WriteByte(Write_Preamble);
+
+    if(EPD_IT8951_ReadBusy(Dev) != IT8951_OK) {
+        EPD_IT8951_Deselect(Dev);
+        return;
+    }
+    EPD_IT8951_Record_Repeat(Dev, Value, Length);
+
+    for(UDOUBLE i = 0; i < IT8951_SPI_CHUNK_SIZE/2; i++)
+    {
+        SPI_Chunk_Buf[2*i] = Value>>8;
+        SPI_Chunk_Buf[2*i+1] = Value;
+    }
+    while(Length > 0)
     {
-	    DEV_SPI_WriteByte(Data_Buf[i]>>8);
-	    DEV_SPI_WriteByte(Data_Buf[i]);
+        Chunk_Length = (Length > IT8951_SPI_CHUNK_SIZE/2) ? IT8951_SPI_CHUNK_SIZE/2 : Length;
+        DEV_SPI_Write_nByte(SPI_Chunk_Buf, Chunk_Length*2);
+        Length -= Chunk_Length;
     }
-    DEV_Digital_Write(EPD_CS_PIN, HIGH);
+
+    EPD_IT8951_Deselect(Dev);
 }
 
 
@@ -150,31 +560,39 @@ static void EPD_IT8951_WriteMuitiData(UWORD* Data_Buf, UDOUBLE Length)
 function :	read data
 parameter:  data
 ******************************************************************************/
-static UWORD EPD_IT8951_ReadData()
+static UWORD EPD_IT8951_ReadData(IT8951_Dev* Dev)
 {
     UWORD ReadData;
 	UWORD Write_Preamble = 0x1000;
     UWORD Read_Dummy;
 
-    EPD_IT8951_ReadBusy();
+    if(EPD_IT8951_ReadBusy(Dev) != IT8951_OK)
+        return 0;
 
-    DEV_Digital_Write(EPD_CS_PIN, LOW);
+    EPD_IT8951_Select(Dev);
 
 	DEV_SPI_WriteByte(Write_Preamble>>8);
 	DEV_SPI_WriteByte(Write_Preamble);
 
-    EPD_IT8951_ReadBusy();
+    if(EPD_IT8951_ReadBusy(Dev) != IT8951_OK) {
+        EPD_IT8951_Deselect(Dev);
+        return 0;
+    }
 
     //dummy
     Read_Dummy = DEV_SPI_ReadByte()<<8;
     Read_Dummy |= DEV_SPI_ReadByte();
 
-    EPD_IT8951_ReadBusy();
+    if(EPD_IT8951_ReadBusy(Dev) != IT8951_OK) {
+        EPD_IT8951_Deselect(Dev);
+        return 0;
+    }
 
     ReadData = DEV_SPI_ReadByte()<<8;
     ReadData |= DEV_SPI_ReadByte();
+    EPD_IT8951_Record_Read(Dev, 1);
 
-    DEV_Digital_Write(EPD_CS_PIN, HIGH);
+    EPD_IT8951_Deselect(Dev);
 
     return ReadData;
 }
@@ -185,34 +603,46 @@ static UWORD EPD_IT8951_ReadData()
 /******************************************************************************
 function :	read multi data
 parameter:  data
+Info:
+    The words are clocked in with one bulk SPI read and put into host
+    order in place
 ******************************************************************************/
-static void EPD_IT8951_ReadMultiData(UWORD* Data_Buf, UDOUBLE Length)
+static void EPD_IT8951_ReadMultiData(IT8951_Dev* Dev, UWORD* Data_Buf, UDOUBLE Length)
 {
 	UWORD Write_Preamble = 0x1000;
     UWORD Read_Dummy;
 
-    EPD_IT8951_ReadBusy();
+    if(EPD_IT8951_ReadBusy(Dev) != IT8951_OK)
+        return;
 
-    DEV_Digital_Write(EPD_CS_PIN, LOW);
+    EPD_IT8951_Select(Dev);
 
 	DEV_SPI_WriteByte(Write_Preamble>>8);
 	DEV_SPI_WriteByte(Write_Preamble);
 
-    EPD_IT8951_ReadBusy();
+    if(EPD_IT8951_ReadBusy(Dev) != IT8951_OK) {
+        EPD_IT8951_Deselect(Dev);
+        return;
+    }
 
     //dummy
     Read_Dummy = DEV_SPI_ReadByte()<<8;
     Read_Dummy |= DEV_SPI_ReadByte();
 
-    EPD_IT8951_ReadBusy();
+    if(EPD_IT8951_ReadBusy(Dev) != IT8951_OK) {
+        EPD_IT8951_Deselect(Dev);
+        return;
+    }
 
+    DEV_SPI_Read_nByte((UBYTE*)Data_Buf, Length*2);
+    EPD_IT8951_Record_Read(Dev, Length);
     for(UDOUBLE i = 0; i<Length; i++)
     {
-	    Data_Buf[i] = DEV_SPI_ReadByte()<<8;
-	    Data_Buf[i] |= DEV_SPI_ReadByte();
+        UBYTE* Wire = (UBYTE*)&Data_Buf[i];
+        Data_Buf[i] = (Wire[0]<<8) | Wire[1];
     }
 
-    DEV_Digital_Write(EPD_CS_PIN, HIGH);
+    EPD_IT8951_Deselect(Dev);
 }
 
 
@@ -224,29 +654,75 @@ description:	some situation like this:
 * 1 commander     0    argument
 * 1 commander     1    argument
 * 1 commander   multi  argument
+* the arguments follow the command in a single data transaction
 ******************************************************************************/
-static void EPD_IT8951_WriteMultiArg(UWORD Arg_Cmd, UWORD* Arg_Buf, UWORD Arg_Num)
+static void EPD_IT8951_WriteMultiArg(IT8951_Dev* Dev, UWORD Arg_Cmd, UWORD* Arg_Buf, UWORD Arg_Num)
 {
      //Send Cmd code
-     EPD_IT8951_WriteCommand(Arg_Cmd);
+     EPD_IT8951_WriteCommand(Dev, Arg_Cmd);
      //Send Data
-     for(UWORD i=0; i<Arg_Num; i++)
+     if(Arg_Num > 0)
      {
-         EPD_IT8951_WriteData(Arg_Buf[i]);
+         EPD_IT8951_WriteMuitiData(Dev, Arg_Buf, Arg_Num);
      }
 }
 
 
+/******************************************************************************
+function :	EPD_IT8951_Shadow_Slot
+parameter:  
+Info:
+    Index of Reg_Address in the shadow cache, -1 for registers the
+    controller changes by itself (LUTAFSR and friends)
+******************************************************************************/
+static int EPD_IT8951_Shadow_Slot(UWORD Reg_Address)
+{
+    for(int i = 0; i < IT8951_SHADOW_REGS; i++)
+    {
+        if(Shadow_Reg_Addr[i] == Reg_Address)
+            return i;
+    }
+    return -1;
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Shadow_Invalidate
+parameter:  
+Info:
+    After a reset or sleep, or when a transfer failed half way, the
+    controller state is unknown again
+******************************************************************************/
+static void EPD_IT8951_Shadow_Invalidate(IT8951_Dev* Dev)
+{
+    for(int i = 0; i < IT8951_SHADOW_REGS; i++)
+        Dev->Shadow_Reg[i].Valid = false;
+}
+
+
 /******************************************************************************
 function :	Cmd4 ReadReg
 parameter:  
+Info:
+    Shadowed registers are read from the controller once, then answered
+    from the cache
 ******************************************************************************/
-static UWORD EPD_IT8951_ReadReg(UWORD Reg_Address)
+static UWORD EPD_IT8951_ReadReg(IT8951_Dev* Dev, UWORD Reg_Address)
 {
     UWORD Reg_Value;
-    EPD_IT8951_WriteCommand(IT8951_TCON_REG_RD);
-    EPD_IT8951_WriteData(Reg_Address);
-    Reg_Value =  EPD_IT8951_ReadData();
+    int Slot = EPD_IT8951_Shadow_Slot(Reg_Address);
+
+    if(Slot >= 0 && Dev->Shadow_Reg[Slot].Valid)
+        return Dev->Shadow_Reg[Slot].Value;
+
+    EPD_IT8951_WriteCommand(Dev, IT8951_TCON_REG_RD);
+    EPD_IT8951_WriteData(Dev, Reg_Address);
+    Reg_Value =  EPD_IT8951_ReadData(Dev);
+
+    if(Slot >= 0 && Dev->Busy_Error == IT8951_OK) {
+        Dev->Shadow_Reg[Slot].Value = Reg_Value;
+        Dev->Shadow_Reg[Slot].Valid = true;
+    }
     return Reg_Value;
 }
 
@@ -255,12 +731,28 @@ static UWORD EPD_IT8951_ReadReg(UWORD Reg_Address)
 /******************************************************************************
 function :	Cmd5 WriteReg
 parameter:  
+Info:
+    Write-through, a shadowed register that already holds Reg_Value is
+    not written again
 ******************************************************************************/
-static void EPD_IT8951_WriteReg(UWORD Reg_Address,UWORD Reg_Value)
+static void EPD_IT8951_WriteReg(IT8951_Dev* Dev, UWORD Reg_Address,UWORD Reg_Value)
 {
-    EPD_IT8951_WriteCommand(IT8951_TCON_REG_WR);
-    EPD_IT8951_WriteData(Reg_Address);
-    EPD_IT8951_WriteData(Reg_Value);
+    UWORD Args[2];
+    int Slot = EPD_IT8951_Shadow_Slot(Reg_Address);
+
+    if(Slot >= 0 && Dev->Shadow_Reg[Slot].Valid && Dev->Shadow_Reg[Slot].Value == Reg_Value)
+        return;
+
+    Args[0] = Reg_Address;
+    Args[1] = Reg_Value;
+    EPD_IT8951_WriteMultiArg(Dev, IT8951_TCON_REG_WR, Args, 2);
+
+    if(Dev->Busy_Error != IT8951_OK) {
+        EPD_IT8951_Shadow_Invalidate(Dev);
+    } else if(Slot >= 0) {
+        Dev->Shadow_Reg[Slot].Value = Reg_Value;
+        Dev->Shadow_Reg[Slot].Valid = true;
+    }
 }
 
 
@@ -269,12 +761,12 @@ static void EPD_IT8951_WriteReg(UWORD Reg_Address,UWORD Reg_Value)
 function :	get VCOM
 parameter:  
 ******************************************************************************/
-static UWORD EPD_IT8951_GetVCOM(void)
+static UWORD EPD_IT8951_GetVCOM(IT8951_Dev* Dev)
 {
     UWORD VCOM;
-    EPD_IT8951_WriteCommand(USDEF_I80_CMD_VCOM);
-    EPD_IT8951_WriteData(0x0000);
-    VCOM =  EPD_IT8951_ReadData();
+    EPD_IT8951_WriteCommand(Dev, USDEF_I80_CMD_VCOM);
+    EPD_IT8951_WriteData(Dev, 0x0000);
+    VCOM =  EPD_IT8951_ReadData(Dev);
     return VCOM;
 }
 
@@ -284,11 +776,12 @@ static UWORD EPD_IT8951_GetVCOM(void)
 function :	set VCOM
 parameter:  
 ******************************************************************************/
-static void EPD_IT8951_SetVCOM(UWORD VCOM)
+static void EPD_IT8951_SetVCOM(IT8951_Dev* Dev, UWORD VCOM)
 {
-    EPD_IT8951_WriteCommand(USDEF_I80_CMD_VCOM);
-    EPD_IT8951_WriteData(0x0001);
-    EPD_IT8951_WriteData(VCOM);
+    UWORD Args[2];
+    Args[0] = 0x0001;
+    Args[1] = VCOM;
+    EPD_IT8951_WriteMultiArg(Dev, USDEF_I80_CMD_VCOM, Args, 2);
 }
 
 
@@ -297,7 +790,7 @@ static void EPD_IT8951_SetVCOM(UWORD VCOM)
 function :	Cmd10 LD_IMG
 parameter:  
 ******************************************************************************/
-static void EPD_IT8951_LoadImgStart( IT8951_Load_Img_Info* Load_Img_Info )
+static void EPD_IT8951_LoadImgStart(IT8951_Dev* Dev, IT8951_Load_Img_Info* Load_Img_Info )
 {
     UWORD Args;
     Args = (\
@@ -305,8 +798,8 @@ static void EPD_IT8951_LoadImgStart( IT8951_Load_Img_Info* Load_Img_Info )
         Load_Img_Info->Pixel_Format<<4 | \
         Load_Img_Info->Rotate\
     );
-    EPD_IT8951_WriteCommand(IT8951_TCON_LD_IMG);
-    EPD_IT8951_WriteData(Args);
+    EPD_IT8951_WriteCommand(Dev, IT8951_TCON_LD_IMG);
+    EPD_IT8951_WriteData(Dev, Args);
 }
 
 
@@ -314,7 +807,7 @@ static void EPD_IT8951_LoadImgStart( IT8951_Load_Img_Info* Load_Img_Info )
 function :	Cmd11 LD_IMG_Area
 parameter:  
 ******************************************************************************/
-static void EPD_IT8951_LoadImgAreaStart( IT8951_Load_Img_Info* Load_Img_Info, IT8951_Area_Img_Info* Area_Img_Info )
+static void EPD_IT8951_LoadImgAreaStart(IT8951_Dev* Dev, IT8951_Load_Img_Info* Load_Img_Info, IT8951_Area_Img_Info* Area_Img_Info )
 {
     UWORD Args[5];
     Args[0] = (\
@@ -326,16 +819,16 @@ static void EPD_IT8951_LoadImgAreaStart( IT8951_Load_Img_Info* Load_Img_Info, IT
     Args[2] = Area_Img_Info->Area_Y;
     Args[3] = Area_Img_Info->Area_W;
     Args[4] = Area_Img_Info->Area_H;
-    EPD_IT8951_WriteMultiArg(IT8951_TCON_LD_IMG_AREA, Args,5);
+    EPD_IT8951_WriteMultiArg(Dev, IT8951_TCON_LD_IMG_AREA, Args,5);
 }
 
 /******************************************************************************
 function :	Cmd12 LD_IMG_End
 parameter:  
 ******************************************************************************/
-static void EPD_IT8951_LoadImgEnd(void)
+static void EPD_IT8951_LoadImgEnd(IT8951_Dev* Dev)
 {
-    EPD_IT8951_WriteCommand(IT8951_TCON_LD_IMG_END);
+    EPD_IT8951_WriteCommand(Dev, IT8951_TCON_LD_IMG_END);
 }
 
 
@@ -343,13 +836,13 @@ static void EPD_IT8951_LoadImgEnd(void)
 function :	EPD_IT8951_Get_System_Info
 parameter:  
 ******************************************************************************/
-static void EPD_IT8951_GetSystemInfo(void* Buf)
+static void EPD_IT8951_GetSystemInfo(IT8951_Dev* Dev, void* Buf)
 {
     IT8951_Dev_Info* Dev_Info; 
 
-    EPD_IT8951_WriteCommand(USDEF_I80_CMD_GET_DEV_INFO);
+    EPD_IT8951_WriteCommand(Dev, USDEF_I80_CMD_GET_DEV_INFO);
 
-    EPD_IT8951_ReadMultiData((UWORD*)Buf, sizeof(IT8951_Dev_Info)/2);
+    EPD_IT8951_ReadMultiData(Dev, (UWORD*)Buf, sizeof(IT8951_Dev_Info)/2);
 
     Dev_Info = (IT8951_Dev_Info*)Buf;
 	Debug("Panel(W,H) = (%d,%d)\r\n",Dev_Info->Panel_W, Dev_Info->Panel_H );
@@ -363,151 +856,702 @@ static void EPD_IT8951_GetSystemInfo(void* Buf)
 function :	EPD_IT8951_Set_Target_Memory_Addr
 parameter:  
 ******************************************************************************/
-static void EPD_IT8951_SetTargetMemoryAddr(UDOUBLE Target_Memory_Addr)
+static void EPD_IT8951_SetTargetMemoryAddr(IT8951_Dev* Dev, UDOUBLE Target_Memory_Addr)
 {
 	UWORD WordH = (UWORD)((Target_Memory_Addr >> 16) & 0x0000FFFF);
 	UWORD WordL = (UWORD)( Target_Memory_Addr & 0x0000FFFF);
 
-    EPD_IT8951_WriteReg(LISAR+2, WordH);
-    EPD_IT8951_WriteReg(LISAR  , WordL);
+    EPD_IT8951_WriteReg(Dev, LISAR+2, WordH);
+    EPD_IT8951_WriteReg(Dev, LISAR  , WordL);
 }
 
 
 /******************************************************************************
-function :	EPD_IT8951_WaitForDisplayReady
+function :	EPD_IT8951_LUT_Predict
 parameter:  
+    Mode   : waveform mode
+    Pixels : area of the display command
+Info:
+    Weighted least squares line through the observed durations, the mean
+    alone until areas differ enough to give a slope. 0 for a mode that
+    was never seen.
 ******************************************************************************/
-static void EPD_IT8951_WaitForDisplayReady(void)
+static UDOUBLE EPD_IT8951_LUT_Predict(IT8951_Dev* Dev, UWORD Mode, UDOUBLE Pixels)
 {
-    //Check IT8951 Register LUTAFSR => NonZero Busy, Zero - Free
-    while( EPD_IT8951_ReadReg(LUTAFSR) )
-    {
-        //wait in idle state
-    }
+    IT8951_LUT_Model* Model = &Dev->LUT_Model[Mode % IT8951_LUT_MODES];
+    double Mean_A, Mean_T, Var_A, Slope = 0, T;
+
+    if(Model->Weight <= 0)
+        return 0;
+
+    Mean_A = Model->Sum_A / Model->Weight;
+    Mean_T = Model->Sum_T / Model->Weight;
+    Var_A = Model->Sum_AA / Model->Weight - Mean_A * Mean_A;
+    if(Var_A > 1e-4)
+        Slope = (Model->Sum_AT / Model->Weight - Mean_A * Mean_T) / Var_A;
+    if(Slope < 0)
+        Slope = 0;
+
+    T = Mean_T + Slope * (Pixels / 1e6 - Mean_A);
+    return (T > 0) ? (UDOUBLE)T : 0;
 }
 
 
-
+/******************************************************************************
+function :	EPD_IT8951_LUT_Observe
+parameter:  
+    Duration_us : measured time from the display command to LUTAFSR == 0
+******************************************************************************/
+static void EPD_IT8951_LUT_Observe(IT8951_Dev* Dev, UWORD Mode, UDOUBLE Pixels, UDOUBLE Duration_us)
+{
+    IT8951_LUT_Model* Model = &Dev->LUT_Model[Mode % IT8951_LUT_MODES];
+    double A = Pixels / 1e6;
+
+    Model->Weight = Model->Weight * IT8951_LUT_DECAY + 1;
+    Model->Sum_A  = Model->Sum_A  * IT8951_LUT_DECAY + A;
+    Model->Sum_T  = Model->Sum_T  * IT8951_LUT_DECAY + Duration_us;
+    Model->Sum_AA = Model->Sum_AA * IT8951_LUT_DECAY + A * A;
+    Model->Sum_AT = Model->Sum_AT * IT8951_LUT_DECAY + A * Duration_us;
+}
 
 
 /******************************************************************************
-function :	EPD_IT8951_HostAreaPackedPixelWrite_1bp
+function :	EPD_IT8951_LUT_Wake
 parameter:  
+Info:
+    When it is worth polling a region for the first time, its start plus
+    IT8951_LUT_GUARD of the predicted waveform time
 ******************************************************************************/
-static void EPD_IT8951_HostAreaPackedPixelWrite_1bp(IT8951_Load_Img_Info*Load_Img_Info,IT8951_Area_Img_Info*Area_Img_Info, bool Packed_Write)
+static uint64_t EPD_IT8951_LUT_Wake(IT8951_Dev* Dev, const IT8951_Region* R)
 {
-    UWORD Source_Buffer_Width, Source_Buffer_Height;
-    UWORD Source_Buffer_Length;
-
-    UWORD* Source_Buffer = (UWORD*)Load_Img_Info->Source_Buffer_Addr;
-    EPD_IT8951_SetTargetMemoryAddr(Load_Img_Info->Target_Memory_Addr);
-    EPD_IT8951_LoadImgAreaStart(Load_Img_Info,Area_Img_Info);
+    UDOUBLE Predicted = EPD_IT8951_LUT_Predict(Dev, R->Mode, (UDOUBLE)R->W * R->H);
+    return R->Start_us + (uint64_t)(Predicted * IT8951_LUT_GUARD);
+}
 
-    //from byte to word
-    //use 8bp to display 1bp, so here, divide by 2, because every byte has full bit.
-    Source_Buffer_Width = Area_Img_Info->Area_W/2;
-    Source_Buffer_Height = Area_Img_Info->Area_H;
-    Source_Buffer_Length = Source_Buffer_Width * Source_Buffer_Height;
-    
-    if(Packed_Write == true)
-    {
-        EPD_IT8951_WriteMuitiData(Source_Buffer, Source_Buffer_Length);
-    }
-    else
-    {
-        for(UDOUBLE i=0; i<Source_Buffer_Height; i++)
-        {
-            for(UDOUBLE j=0; j<Source_Buffer_Width; j++)
-            {
-                EPD_IT8951_WriteData(*Source_Buffer);
-                Source_Buffer++;
-            }
-        }
-    }
 
-    EPD_IT8951_LoadImgEnd();
+/******************************************************************************
+function :	EPD_IT8951_Rect_Overlap
+parameter:  
+******************************************************************************/
+static bool EPD_IT8951_Rect_Overlap(UWORD X1, UWORD Y1, UWORD W1, UWORD H1, UWORD X2, UWORD Y2, UWORD W2, UWORD H2)
+{
+    return X1 < X2 + W2 && X2 < X1 + W1 && Y1 < Y2 + H2 && Y2 < Y1 + H1;
 }
 
 
+/******************************************************************************
+function :	EPD_IT8951_Match_All / _Panel / _Memory
+parameter:  
+    R    : an active region
+    Area : what the caller is about to touch
+Info:
+    Selects the regions EPD_IT8951_Wait_Regions waits for. Buffers are
+    Image_Pitch bytes per line, areas in different buffers are compared
+    by their byte ranges.
+******************************************************************************/
+static bool EPD_IT8951_Match_All(IT8951_Dev* Dev, const IT8951_Region* R, const IT8951_Region* Area)
+{
+    return true;
+}
+
+static bool EPD_IT8951_Match_Panel(IT8951_Dev* Dev, const IT8951_Region* R, const IT8951_Region* Area)
+{
+    return EPD_IT8951_Rect_Overlap(R->X, R->Y, R->W, R->H, Area->X, Area->Y, Area->W, Area->H);
+}
 
+static bool EPD_IT8951_Match_Memory(IT8951_Dev* Dev, const IT8951_Region* R, const IT8951_Region* Area)
+{
+    UDOUBLE Start1, End1, Start2, End2;
+
+    if(R->Mem_Addr == Area->Mem_Addr)
+        return EPD_IT8951_Rect_Overlap(R->Mem_X, R->Mem_Y, R->Mem_W, R->Mem_H, Area->Mem_X, Area->Mem_Y, Area->Mem_W, Area->Mem_H);
+    if(Dev->Image_Pitch == 0)
+        return true;
+
+    Start1 = R->Mem_Addr + (UDOUBLE)R->Mem_Y * Dev->Image_Pitch + R->Mem_X;
+    End1 = R->Mem_Addr + (UDOUBLE)(R->Mem_Y + R->Mem_H) * Dev->Image_Pitch;
+    Start2 = Area->Mem_Addr + (UDOUBLE)Area->Mem_Y * Dev->Image_Pitch + Area->Mem_X;
+    End2 = Area->Mem_Addr + (UDOUBLE)(Area->Mem_Y + Area->Mem_H) * Dev->Image_Pitch;
+    return Start1 < End2 && Start2 < End1;
+}
 
 
 /******************************************************************************
-function :	EPD_IT8951_HostAreaPackedPixelWrite_2bp
+function :	EPD_IT8951_Region_Update
 parameter:  
+    Status : LUTAFSR as just read
+Info:
+    Retires the regions whose engines are idle and feeds their duration to
+    the LUT model. A region with an unknown engine counts as running until
+    all of LUTAFSR is zero. The end lies between the last poll that saw a
+    region busy and this one; a region that is already done at the first
+    poll after its predicted wake means the model runs long, pull it in.
 ******************************************************************************/
-static void EPD_IT8951_HostAreaPackedPixelWrite_2bp(IT8951_Load_Img_Info*Load_Img_Info, IT8951_Area_Img_Info*Area_Img_Info, bool Packed_Write)
+static void EPD_IT8951_Region_Update(IT8951_Dev* Dev, UWORD Status, uint64_t Now)
 {
-    UWORD Source_Buffer_Width, Source_Buffer_Height;
-    UWORD Source_Buffer_Length;
+    IT8951_Region* R;
+    uint64_t Wake;
+    bool Done;
 
-    UWORD* Source_Buffer = (UWORD*)Load_Img_Info->Source_Buffer_Addr;
-    EPD_IT8951_SetTargetMemoryAddr(Load_Img_Info->Target_Memory_Addr);
-    EPD_IT8951_LoadImgAreaStart(Load_Img_Info,Area_Img_Info);
-
-    //from byte to word
-    Source_Buffer_Width = (Area_Img_Info->Area_W*2/8)/2;
-    Source_Buffer_Height = Area_Img_Info->Area_H;
-    Source_Buffer_Length = Source_Buffer_Width * Source_Buffer_Height;
-
-    if(Packed_Write == true)
-    {
-        EPD_IT8951_WriteMuitiData(Source_Buffer, Source_Buffer_Length);
-    }
-    else
+    for(int i = 0; i < IT8951_MAX_REGIONS; i++)
     {
-        for(UDOUBLE i=0; i<Source_Buffer_Height; i++)
-        {
-            for(UDOUBLE j=0; j<Source_Buffer_Width; j++)
-            {
-                EPD_IT8951_WriteData(*Source_Buffer);
-                Source_Buffer++;
-            }
+        R = &Dev->Region[i];
+        if(!R->Active)
+            continue;
+
+        Done = (R->Engine_Mask != 0) ? (Status & R->Engine_Mask) == 0 : Status == 0;
+        if(!Done) {
+            R->Last_Busy_us = Now;
+            continue;
         }
-    }
 
-    EPD_IT8951_LoadImgEnd();
+        Wake = EPD_IT8951_LUT_Wake(Dev, R);
+        if(R->Mode >= IT8951_LUT_MODES) {
+            //inherited by EPD_IT8951_Attach, nothing to learn from
+        } else if(R->Last_Busy_us != 0) {
+            EPD_IT8951_LUT_Observe(Dev, R->Mode, (UDOUBLE)R->W * R->H, (R->Last_Busy_us + Now) / 2 - R->Start_us);
+        } else if(Wake > R->Start_us && Now < Wake + IT8951_LUT_POLL_MAX_US) {
+            EPD_IT8951_LUT_Observe(Dev, R->Mode, (UDOUBLE)R->W * R->H, (Wake - R->Start_us) * IT8951_LUT_GUARD);
+        }
+        R->Active = false;
+    }
 }
 
 
-
-
-
 /******************************************************************************
-function :	EPD_IT8951_HostAreaPackedPixelWrite_4bp
+function :	EPD_IT8951_Poll_Regions
 parameter:  
+    Match : picks the regions to wait for
+    Area  : passed to Match
+Info:
+    Every LUTAFSR poll is a command, an address and a dummy read on the
+    bus. Sleep until the earliest predicted wake of the regions waited
+    for, then poll with a doubling interval until none of them runs.
+    Each poll also retires the other regions that are done.
 ******************************************************************************/
-static void EPD_IT8951_HostAreaPackedPixelWrite_4bp(IT8951_Load_Img_Info*Load_Img_Info, IT8951_Area_Img_Info*Area_Img_Info, bool Packed_Write)
+static void EPD_IT8951_Poll_Regions(IT8951_Dev* Dev, bool (*Match)(IT8951_Dev*, const IT8951_Region*, const IT8951_Region*), const IT8951_Region* Area)
 {
-    UWORD Source_Buffer_Width, Source_Buffer_Height;
-    UWORD Source_Buffer_Length;
-	
-    UWORD* Source_Buffer = (UWORD*)Load_Img_Info->Source_Buffer_Addr;
-    EPD_IT8951_SetTargetMemoryAddr(Load_Img_Info->Target_Memory_Addr);
-    EPD_IT8951_LoadImgAreaStart(Load_Img_Info,Area_Img_Info);
-
-    //from byte to word
-    Source_Buffer_Width = (Area_Img_Info->Area_W*4/8)/2;
-    Source_Buffer_Height = Area_Img_Info->Area_H;
-    Source_Buffer_Length = Source_Buffer_Width * Source_Buffer_Height;
+    uint64_t Deadline = DEV_Time_us() + (uint64_t)Dev->Display_Timeout_ms * 1000;
+    uint64_t Now, Wake;
+    UDOUBLE Poll_us = IT8951_LUT_POLL_MIN_US;
+    UWORD Status;
+    bool Waiting, Polled = false;
 
-    if(Packed_Write == true)
-    {
-        EPD_IT8951_WriteMuitiData(Source_Buffer, Source_Buffer_Length);
-    }
-    else
+    for(;;)
     {
-        for(UDOUBLE i=0; i<Source_Buffer_Height; i++)
+        Waiting = false;
+        Wake = UINT64_MAX;
+        for(int i = 0; i < IT8951_MAX_REGIONS; i++)
         {
-            for(UDOUBLE j=0; j<Source_Buffer_Width; j++)
-            {
-                EPD_IT8951_WriteData(*Source_Buffer);
-                Source_Buffer++;
-            }
+            IT8951_Region* R = &Dev->Region[i];
+            if(!R->Active || !Match(Dev, R, Area))
+                continue;
+            Waiting = true;
+            //once a region was seen running, only the poll interval counts
+            Now = (R->Last_Busy_us == 0) ? EPD_IT8951_LUT_Wake(Dev, R) : 0;
+            if(Now < Wake)
+                Wake = Now;
+        }
+        if(!Waiting || Dev->Busy_Error != IT8951_OK)
+            return;
+
+        Now = DEV_Time_us();
+        if(Dev->Display_Timeout_ms != 0 && Now >= Deadline) {
+            Debug("LUT timeout after %d ms\r\n", Dev->Display_Timeout_ms);
+            Dev->Busy_Error = IT8951_ERR_LUT_TIMEOUT;
+            return;
+        }
+        if(Wake > Now) {
+            DEV_Delay_us(Wake - Now);
+        } else if(Polled) {
+            DEV_Delay_us(Poll_us);
+            if(Poll_us < IT8951_LUT_POLL_MAX_US)
+                Poll_us *= 2;
         }
-    }
 
-    EPD_IT8951_LoadImgEnd();
+        //Check IT8951 Register LUTAFSR => NonZero Busy, Zero - Free
+        Status = EPD_IT8951_ReadReg(Dev, LUTAFSR);
+        if(Dev->Busy_Error != IT8951_OK)
+            return;
+        EPD_IT8951_Region_Update(Dev, Status, DEV_Time_us());
+        Polled = true;
+    }
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Wait_Regions
+parameter:  
+Info:
+    EPD_IT8951_Poll_Regions; a recording keeps the wait itself, how many
+    polls it took is a matter of timing
+******************************************************************************/
+static void EPD_IT8951_Wait_Regions(IT8951_Dev* Dev, bool (*Match)(IT8951_Dev*, const IT8951_Region*, const IT8951_Region*), const IT8951_Region* Area)
+{
+    UBYTE Kind = IT8951_MATCH_ALL;
+
+    if(Match == EPD_IT8951_Match_Panel)
+        Kind = IT8951_MATCH_PANEL;
+    else if(Match == EPD_IT8951_Match_Memory)
+        Kind = IT8951_MATCH_MEMORY;
+    EPD_IT8951_Record_Area(Dev, IT8951_OP_WAIT, Kind, Area);
+
+    Dev->Record_Hold++;
+    EPD_IT8951_Poll_Regions(Dev, Match, Area);
+    Dev->Record_Hold--;
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_WaitForDisplayReady
+parameter:  
+Info:
+    Until every waveform the driver started has finished
+******************************************************************************/
+static void EPD_IT8951_WaitForDisplayReady(IT8951_Dev* Dev)
+{
+    EPD_IT8951_Wait_Regions(Dev, EPD_IT8951_Match_All, NULL);
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Region_Track
+parameter:  
+Info:
+    Called right after DPY_AREA / DPY_BUF_AREA went out. The engine the
+    controller picked is the LUTAFSR bit that was not set by any region
+    we know of; when that is ambiguous the mask stays 0.
+******************************************************************************/
+static void EPD_IT8951_Region_Track(IT8951_Dev* Dev, UWORD X, UWORD Y, UWORD W, UWORD H, UWORD Mode)
+{
+    IT8951_Region* R = NULL;
+    UWORD Status, Known = 0;
+    uint64_t Start = DEV_Time_us();
+
+    if(Dev->Busy_Error != IT8951_OK)
+        return;
+
+    Status = EPD_IT8951_ReadReg(Dev, LUTAFSR);
+    if(Dev->Busy_Error != IT8951_OK)
+        return;
+    EPD_IT8951_Region_Update(Dev, Status, DEV_Time_us());
+
+    for(int i = 0; i < IT8951_MAX_REGIONS; i++)
+    {
+        if(Dev->Region[i].Active)
+            Known |= Dev->Region[i].Engine_Mask;
+        else if(R == NULL)
+            R = &Dev->Region[i];
+    }
+    //EPD_IT8951_Reserve_Region made room before the command
+    if(R == NULL)
+        return;
+
+    *R = Dev->Display_Source;
+    R->Active = true;
+    R->X = X;
+    R->Y = Y;
+    R->W = W;
+    R->H = H;
+    R->Mode = Mode;
+    R->Start_us = Start;
+    R->Last_Busy_us = 0;
+    R->Engine_Mask = Status & ~Known;
+    if(R->Engine_Mask & (R->Engine_Mask - 1))
+        R->Engine_Mask = 0;
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Region_Start
+parameter:  
+Info:
+    EPD_IT8951_Region_Track; a recording keeps the display command with
+    the source of its pixels, the replay tracks it the same way
+******************************************************************************/
+static void EPD_IT8951_Region_Start(IT8951_Dev* Dev, UWORD X, UWORD Y, UWORD W, UWORD H, UWORD Mode)
+{
+    IT8951_Region Area = Dev->Display_Source;
+
+    Area.X = X;
+    Area.Y = Y;
+    Area.W = W;
+    Area.H = H;
+    Area.Mode = Mode;
+    if(Dev->Busy_Error == IT8951_OK)
+        EPD_IT8951_Record_Area(Dev, IT8951_OP_REGION, 0, &Area);
+
+    Dev->Record_Hold++;
+    EPD_IT8951_Region_Track(Dev, X, Y, W, H, Mode);
+    Dev->Record_Hold--;
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Reserve_Region
+parameter:  
+******************************************************************************/
+static void EPD_IT8951_Reserve_Region(IT8951_Dev* Dev)
+{
+    for(int i = 0; i < IT8951_MAX_REGIONS; i++)
+    {
+        if(!Dev->Region[i].Active)
+            return;
+    }
+    EPD_IT8951_WaitForDisplayReady(Dev);
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_HostAreaWritePixels
+parameter:  
+    Source_Buffer_Length : number of words in the area
+Info:
+    With IT8951_LDIMG_L_ENDIAN every word of the frame buffer has to be sent
+    high byte first, which swaps each byte pair on the host. With
+    IT8951_LDIMG_B_ENDIAN the controller takes the first byte on the wire as
+    the first pixels, so the buffer already is in wire order and is sent as is.
+******************************************************************************/
+static void EPD_IT8951_HostAreaWritePixels(IT8951_Dev* Dev, IT8951_Load_Img_Info*Load_Img_Info, UDOUBLE Source_Buffer_Length)
+{
+    if(Load_Img_Info->Endian_Type == IT8951_LDIMG_B_ENDIAN)
+    {
+        EPD_IT8951_WriteMultiByte(Dev, Load_Img_Info->Source_Buffer_Addr, Source_Buffer_Length*2);
+    }
+    else
+    {
+        EPD_IT8951_WriteMuitiData(Dev, (UWORD*)Load_Img_Info->Source_Buffer_Addr, Source_Buffer_Length);
+    }
+}
+
+
+
+
+
+/******************************************************************************
+function :	EPD_IT8951_Reverse_Init
+parameter:  
+Info:
+    Reverse_Table[n] turns the pixels of a byte of 1, 2 or 4 bpp (n = 0,
+    1, 2) end for end; the first pixel is in the low bits
+******************************************************************************/
+static UBYTE Reverse_Table[3][256];
+static pthread_once_t Reverse_Once = PTHREAD_ONCE_INIT;
+
+static void EPD_IT8951_Reverse_Init(void)
+{
+    for(int n = 0; n < 3; n++)
+    {
+        UBYTE Bpp = 1 << n, Mask = (1 << Bpp) - 1;
+
+        for(int Value = 0; Value < 256; Value++)
+        {
+            UBYTE Reversed = 0;
+            for(int Shift = 0; Shift < 8; Shift += Bpp)
+                Reversed |= ((Value >> Shift) & Mask) << (8 - Bpp - Shift);
+            Reverse_Table[n][Value] = Reversed;
+        }
+    }
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Oriented_W
+parameter:  
+Info:
+    Width of the panel the canvas is turned on. Once turned, areas are
+    mirrored about a width that keeps the 32 pixel alignment of X and W.
+******************************************************************************/
+static UWORD EPD_IT8951_Oriented_W(IT8951_Dev* Dev)
+{
+    if(Dev->Load_Rotate == IT8951_ROTATE_0 && !Dev->Load_Mirror)
+        return Dev->Info.Panel_W;
+    return Dev->Info.Panel_W - Dev->Info.Panel_W % 32;
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Canvas_To_Panel
+parameter:  
+Info:
+    Canvas area to panel area: mirrored first, then turned clockwise
+******************************************************************************/
+static void EPD_IT8951_Canvas_To_Panel(IT8951_Dev* Dev, UWORD* X, UWORD* Y, UWORD* W, UWORD* H)
+{
+    UWORD Panel_W = EPD_IT8951_Oriented_W(Dev), Panel_H = Dev->Info.Panel_H;
+    UWORD Canvas_W = (Dev->Load_Rotate & 1) ? Panel_H : Panel_W;
+    UWORD Swap;
+
+    if(Dev->Load_Mirror)
+        *X = Canvas_W - *X - *W;
+
+    switch(Dev->Load_Rotate) {
+    case IT8951_ROTATE_90:
+        Swap = *X;
+        *X = Panel_W - *Y - *H;
+        *Y = Swap;
+        break;
+    case IT8951_ROTATE_180:
+        *X = Panel_W - *X - *W;
+        *Y = Panel_H - *Y - *H;
+        return;
+    case IT8951_ROTATE_270:
+        Swap = *X;
+        *X = *Y;
+        *Y = Panel_H - Swap - *W;
+        break;
+    default:
+        return;
+    }
+    Swap = *W;
+    *W = *H;
+    *H = Swap;
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Orient_1bp
+parameter:  
+    Src  : canvas area as given to EPD_IT8951_1bp_Refresh
+    Area : its panel area, X and W in bytes
+Info:
+    The controller turns whole 8bpp pixels, each of which carries 8 dots
+    here, so 1bpp areas are turned on the host. Rows that only change
+    direction go through the reverse table, quarter turns dot by dot.
+******************************************************************************/
+static void EPD_IT8951_Orient_1bp(IT8951_Dev* Dev, UBYTE* Dst, const UBYTE* Src, const IT8951_Area_Img_Info* Area)
+{
+    UWORD Row_Bytes = Area->Area_W, Rows = Area->Area_H;
+
+    if(!(Dev->Load_Rotate & 1))
+    {
+        bool Flip = (Dev->Load_Rotate == IT8951_ROTATE_180);
+        bool Reverse = (Dev->Load_Mirror != Flip);
+
+        for(UWORD r = 0; r < Rows; r++)
+        {
+            const UBYTE* Src_Row = Src + (UDOUBLE)(Flip ? Rows - 1 - r : r) * Row_Bytes;
+            UBYTE* Dst_Row = Dst + (UDOUBLE)r * Row_Bytes;
+
+            if(!Reverse)
+            {
+                memcpy(Dst_Row, Src_Row, Row_Bytes);
+                continue;
+            }
+            for(UWORD b = 0; b < Row_Bytes; b++)
+                Dst_Row[b] = Reverse_Table[0][Src_Row[Row_Bytes - 1 - b]];
+        }
+        return;
+    }
+
+    //the canvas is Rows dots wide and Row_Bytes * 8 lines high
+    UWORD Canvas_W = Rows, Canvas_H = Row_Bytes * 8, Canvas_Bytes = Canvas_W / 8;
+
+    memset(Dst, 0, (UDOUBLE)Row_Bytes * Rows);
+    for(UWORD j = 0; j < Canvas_H; j++)
+    {
+        const UBYTE* Src_Row = Src + (UDOUBLE)j * Canvas_Bytes;
+
+        for(UWORD i = 0; i < Canvas_W; i++)
+        {
+            UWORD Mi = Dev->Load_Mirror ? Canvas_W - 1 - i : i;
+            UWORD Px, Py;
+
+            if(!((Src_Row[i / 8] >> (i % 8)) & 1))
+                continue;
+            if(Dev->Load_Rotate == IT8951_ROTATE_90) {
+                Px = Canvas_H - 1 - j;
+                Py = Mi;
+            } else {
+                Px = j;
+                Py = Canvas_W - 1 - Mi;
+            }
+            Dst[(UDOUBLE)Py * Row_Bytes + Px / 8] |= 1 << (Px % 8);
+        }
+    }
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Orient_Load
+parameter:  
+    Area : panel area about to be loaded, X and W in bytes for 1bpp
+Info:
+    Applies EPD_IT8951_Set_Orientation to a load: Load_Img_Info and
+    Area_Img_Info are changed to what goes on the wire. The 2, 4 and 8bpp
+    formats are turned by LD_IMG_AREA, which wants the area before the
+    turn, and mirrored one row at a time here. Returns the buffer that
+    holds the changed pixels, to be freed after the load, or NULL when
+    the frame buffer goes out as it is. A quarter turned 1bpp area of H
+    rows is a canvas H dots wide, which must be whole bytes: other
+    heights are refused with IT8951_ERR_AREA. IT8951_ERR_NO_MEMORY when
+    the changed pixels find no room. Nothing is loaded after either.
+******************************************************************************/
+static UBYTE* EPD_IT8951_Orient_Load(IT8951_Dev* Dev, IT8951_Load_Img_Info* Load_Img_Info, IT8951_Area_Img_Info* Area, UBYTE Bits_Per_Pixel)
+{
+    UWORD X = Area->Area_X, Y = Area->Area_Y, W = Area->Area_W, H = Area->Area_H;
+    UDOUBLE Size = (Bits_Per_Pixel == 1) ? (UDOUBLE)W * H : (UDOUBLE)W * Bits_Per_Pixel / 8 * H;
+    UBYTE* Oriented = NULL;
+
+    if(Dev->Load_Rotate == IT8951_ROTATE_0 && !Dev->Load_Mirror)
+        return NULL;
+    if(Bits_Per_Pixel == 1 && (Dev->Load_Rotate & 1) && H % 8 != 0) {
+        Debug("Orient: 1bpp area %d dots wide on the canvas, not whole bytes\r\n", H);
+        Dev->Busy_Error = IT8951_ERR_AREA;
+        return NULL;
+    }
+
+    if(Bits_Per_Pixel == 1 || Dev->Load_Mirror)
+    {
+        Oriented = malloc(Size);
+        if(Oriented == NULL) {
+            Debug("Orient: out of memory, area not loaded\r\n");
+            Dev->Busy_Error = IT8951_ERR_NO_MEMORY;
+            return NULL;
+        }
+    }
+
+    if(Bits_Per_Pixel == 1)
+    {
+        EPD_IT8951_Orient_1bp(Dev, Oriented, Load_Img_Info->Source_Buffer_Addr, Area);
+        Load_Img_Info->Source_Buffer_Addr = Oriented;
+        return Oriented;
+    }
+
+    if(Oriented != NULL)
+    {
+        //rows of the canvas area, which LD_IMG_AREA takes unturned
+        UWORD Rows = (Dev->Load_Rotate & 1) ? W : H;
+        UDOUBLE Row_Bytes = Size / Rows;
+        const UBYTE* Table = (Bits_Per_Pixel == 8) ? NULL : Reverse_Table[Bits_Per_Pixel / 2];
+
+        for(UWORD r = 0; r < Rows; r++)
+        {
+            const UBYTE* Src_Row = Load_Img_Info->Source_Buffer_Addr + r * Row_Bytes;
+            UBYTE* Dst_Row = Oriented + r * Row_Bytes;
+
+            for(UDOUBLE b = 0; b < Row_Bytes; b++)
+            {
+                UBYTE Value = Src_Row[Row_Bytes - 1 - b];
+                Dst_Row[b] = (Table == NULL) ? Value : Table[Value];
+            }
+        }
+        Load_Img_Info->Source_Buffer_Addr = Oriented;
+    }
+
+    Load_Img_Info->Rotate = Dev->Load_Rotate;
+    switch(Dev->Load_Rotate) {
+    case IT8951_ROTATE_90:
+        Area->Area_X = Y;
+        Area->Area_Y = Dev->Info.Panel_W - X - W;
+        Area->Area_W = H;
+        Area->Area_H = W;
+        break;
+    case IT8951_ROTATE_180:
+        Area->Area_X = Dev->Info.Panel_W - X - W;
+        Area->Area_Y = Dev->Info.Panel_H - Y - H;
+        break;
+    case IT8951_ROTATE_270:
+        Area->Area_X = Dev->Info.Panel_H - Y - H;
+        Area->Area_Y = X;
+        Area->Area_W = H;
+        Area->Area_H = W;
+        break;
+    }
+    return Oriented;
+}
+
+
+
+
+/******************************************************************************
+function :	EPD_IT8951_HostAreaPackedPixelWrite_1bp
+parameter:  
+******************************************************************************/
+static void EPD_IT8951_HostAreaPackedPixelWrite_1bp(IT8951_Dev* Dev, IT8951_Load_Img_Info*Load_Img_Info,IT8951_Area_Img_Info*Area_Img_Info)
+{
+    UWORD Source_Buffer_Width, Source_Buffer_Height;
+    UDOUBLE Source_Buffer_Length;
+    UBYTE* Oriented;
+
+    Oriented = EPD_IT8951_Orient_Load(Dev, Load_Img_Info, Area_Img_Info, 1);
+    if(Dev->Busy_Error != IT8951_OK)
+        return;
+    EPD_IT8951_SetTargetMemoryAddr(Dev, Load_Img_Info->Target_Memory_Addr);
+    EPD_IT8951_LoadImgAreaStart(Dev, Load_Img_Info,Area_Img_Info);
+
+    //from byte to word
+    //use 8bp to display 1bp, so here, divide by 2, because every byte has full bit.
+    Source_Buffer_Width = Area_Img_Info->Area_W/2;
+    Source_Buffer_Height = Area_Img_Info->Area_H;
+    Source_Buffer_Length = Source_Buffer_Width * Source_Buffer_Height;
+    
+    EPD_IT8951_HostAreaWritePixels(Dev, Load_Img_Info, Source_Buffer_Length);
+
+    EPD_IT8951_LoadImgEnd(Dev);
+    free(Oriented);
+}
+
+
+
+
+
+/******************************************************************************
+function :	EPD_IT8951_HostAreaPackedPixelWrite_2bp
+parameter:  
+******************************************************************************/
+static void EPD_IT8951_HostAreaPackedPixelWrite_2bp(IT8951_Dev* Dev, IT8951_Load_Img_Info*Load_Img_Info, IT8951_Area_Img_Info*Area_Img_Info)
+{
+    UWORD Source_Buffer_Width, Source_Buffer_Height;
+    UDOUBLE Source_Buffer_Length;
+    UBYTE* Oriented;
+
+    Oriented = EPD_IT8951_Orient_Load(Dev, Load_Img_Info, Area_Img_Info, 2);
+    if(Dev->Busy_Error != IT8951_OK)
+        return;
+    EPD_IT8951_SetTargetMemoryAddr(Dev, Load_Img_Info->Target_Memory_Addr);
+    EPD_IT8951_LoadImgAreaStart(Dev, Load_Img_Info,Area_Img_Info);
+
+    //from byte to word
+    Source_Buffer_Width = (Area_Img_Info->Area_W*2/8)/2;
+    Source_Buffer_Height = Area_Img_Info->Area_H;
+    Source_Buffer_Length = Source_Buffer_Width * Source_Buffer_Height;
+
+    EPD_IT8951_HostAreaWritePixels(Dev, Load_Img_Info, Source_Buffer_Length);
+
+    EPD_IT8951_LoadImgEnd(Dev);
+    free(Oriented);
+}
+
+
+
+
+
+/******************************************************************************
+function :	EPD_IT8951_HostAreaPackedPixelWrite_4bp
+parameter:  
+******************************************************************************/
+static void EPD_IT8951_HostAreaPackedPixelWrite_4bp(IT8951_Dev* Dev, IT8951_Load_Img_Info*Load_Img_Info, IT8951_Area_Img_Info*Area_Img_Info)
+{
+    UWORD Source_Buffer_Width, Source_Buffer_Height;
+    UDOUBLE Source_Buffer_Length;
+    UBYTE* Oriented;
+	
+    Oriented = EPD_IT8951_Orient_Load(Dev, Load_Img_Info, Area_Img_Info, 4);
+    if(Dev->Busy_Error != IT8951_OK)
+        return;
+    EPD_IT8951_SetTargetMemoryAddr(Dev, Load_Img_Info->Target_Memory_Addr);
+    EPD_IT8951_LoadImgAreaStart(Dev, Load_Img_Info,Area_Img_Info);
+
+    //from byte to word
+    Source_Buffer_Width = (Area_Img_Info->Area_W*4/8)/2;
+    Source_Buffer_Height = Area_Img_Info->Area_H;
+    Source_Buffer_Length = Source_Buffer_Width * Source_Buffer_Height;
+
+    EPD_IT8951_HostAreaWritePixels(Dev, Load_Img_Info, Source_Buffer_Length);
+
+    EPD_IT8951_LoadImgEnd(Dev);
+    free(Oriented);
 }
 
 
@@ -519,41 +1563,358 @@ static void EPD_IT8951_HostAreaPackedPixelWrite_4bp(IT8951_Load_Img_Info*Load_Im
 /******************************************************************************
 function :	EPD_IT8951_HostAreaPackedPixelWrite_8bp
 parameter:  
-Precautions: Can't Packed Write
+Precautions: streamed like the other formats, one transaction per area
 ******************************************************************************/
-static void EPD_IT8951_HostAreaPackedPixelWrite_8bp(IT8951_Load_Img_Info*Load_Img_Info,IT8951_Area_Img_Info*Area_Img_Info)
+static void EPD_IT8951_HostAreaPackedPixelWrite_8bp(IT8951_Dev* Dev, IT8951_Load_Img_Info*Load_Img_Info,IT8951_Area_Img_Info*Area_Img_Info)
 {
     UWORD Source_Buffer_Width, Source_Buffer_Height;
+    UDOUBLE Source_Buffer_Length;
+    UBYTE* Oriented;
 
-    UWORD* Source_Buffer = (UWORD*)Load_Img_Info->Source_Buffer_Addr;
-    EPD_IT8951_SetTargetMemoryAddr(Load_Img_Info->Target_Memory_Addr);
-    EPD_IT8951_LoadImgAreaStart(Load_Img_Info,Area_Img_Info);
+    Oriented = EPD_IT8951_Orient_Load(Dev, Load_Img_Info, Area_Img_Info, 8);
+    if(Dev->Busy_Error != IT8951_OK)
+        return;
+    EPD_IT8951_SetTargetMemoryAddr(Dev, Load_Img_Info->Target_Memory_Addr);
+    EPD_IT8951_LoadImgAreaStart(Dev, Load_Img_Info,Area_Img_Info);
 
     //from byte to word
     Source_Buffer_Width = (Area_Img_Info->Area_W*8/8)/2;
     Source_Buffer_Height = Area_Img_Info->Area_H;
+    Source_Buffer_Length = Source_Buffer_Width * Source_Buffer_Height;
+
+    EPD_IT8951_HostAreaWritePixels(Dev, Load_Img_Info, Source_Buffer_Length);
+
+    EPD_IT8951_LoadImgEnd(Dev);
+    free(Oriented);
+}
+
+
+
+
+
+
+/******************************************************************************
+function :	EPD_IT8951_Claim_Memory
+parameter:  
+    Mem_Addr         : image buffer
+    X, Y, W, H       : area of that buffer about to be loaded or shown,
+                       in buffer pixels (X/8, W/8 for the 1bpp trick)
+Info:
+    Waits for the waveforms that show from this part of the buffer and
+    records it as the source of the next display command
+******************************************************************************/
+static void EPD_IT8951_Claim_Memory(IT8951_Dev* Dev, UDOUBLE Mem_Addr, UWORD X, UWORD Y, UWORD W, UWORD H)
+{
+    Dev->Display_Source.Mem_Addr = Mem_Addr;
+    Dev->Display_Source.Mem_X = X;
+    Dev->Display_Source.Mem_Y = Y;
+    Dev->Display_Source.Mem_W = W;
+    Dev->Display_Source.Mem_H = H;
+    EPD_IT8951_Wait_Regions(Dev, EPD_IT8951_Match_Memory, &Dev->Display_Source);
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Claim_Bytes
+parameter:  
+    Mem_Addr   : first byte about to be written
+    Byte_Count : length of the write
+Info:
+    EPD_IT8951_Claim_Memory for the raw writers, the range is taken as
+    whole Image_Pitch lines from Mem_Addr on. Display_Source is left
+    alone, no display command follows.
+******************************************************************************/
+static void EPD_IT8951_Claim_Bytes(IT8951_Dev* Dev, UDOUBLE Mem_Addr, UDOUBLE Byte_Count)
+{
+    IT8951_Region Area;
+    UDOUBLE Lines;
+
+    memset(&Area, 0, sizeof(Area));
+    Area.Mem_Addr = Mem_Addr;
+    if(Dev->Image_Pitch == 0) {
+        Area.Mem_W = 0xFFFF;
+        Area.Mem_H = 0xFFFF;
+    } else {
+        Lines = (Byte_Count + Dev->Image_Pitch - 1) / Dev->Image_Pitch;
+        Area.Mem_W = Dev->Image_Pitch;
+        Area.Mem_H = (Lines > 0xFFFF) ? 0xFFFF : Lines;
+    }
+    EPD_IT8951_Wait_Regions(Dev, EPD_IT8951_Match_Memory, &Area);
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Begin_Upload
+parameter:  
+    Target_Memory_Addr : buffer the caller asked for
+    X, Y, W, H         : area of the buffer to be loaded
+Info:
+    Returns the buffer the frame is loaded into. Without a pipeline that
+    is Target_Memory_Addr, with a pipeline the frames alternate between
+    Target_Memory_Addr and Pipeline_Addr. Either way the upload only
+    waits for waveforms still showing from the same bytes.
+******************************************************************************/
+static UDOUBLE EPD_IT8951_Begin_Upload(IT8951_Dev* Dev, UDOUBLE Target_Memory_Addr, UWORD X, UWORD Y, UWORD W, UWORD H)
+{
+    if(Dev->Pipeline_Addr != 0) {
+        Dev->Pipeline_Next ^= 1;
+        if(Dev->Pipeline_Next == 0)
+            Target_Memory_Addr = Dev->Pipeline_Addr;
+    }
+
+    EPD_IT8951_Claim_Memory(Dev, Target_Memory_Addr, X, Y, W, H);
+    return Target_Memory_Addr;
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Begin_Display
+parameter:  
+Info:
+    Waits for the waveforms running on an overlapping panel area, the
+    rest keep going on their own LUT engines
+******************************************************************************/
+static void EPD_IT8951_Begin_Display(IT8951_Dev* Dev, UWORD X, UWORD Y, UWORD W, UWORD H)
+{
+    IT8951_Region Area;
+
+    Area.X = X;
+    Area.Y = Y;
+    Area.W = W;
+    Area.H = H;
+    EPD_IT8951_Wait_Regions(Dev, EPD_IT8951_Match_Panel, &Area);
+    EPD_IT8951_Reserve_Region(Dev);
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Fill_Write
+parameter:  
+    X, Y, W, H     : panel area, X and W multiples of 8 for 1bpp
+    Bits_Per_Pixel : 1, 2, 4 or 8, the format the area is shown in
+Info:
+    Gray into the area of Target_Memory_Addr. The pixels are one word
+    sent over and over, nothing the size of the area is allocated.
+    Makes no reads, the area has to be claimed before.
+******************************************************************************/
+static void EPD_IT8951_Fill_Write(IT8951_Dev* Dev, UWORD X, UWORD Y, UWORD W, UWORD H, UBYTE Gray, UBYTE Bits_Per_Pixel, UDOUBLE Target_Memory_Addr)
+{
+    IT8951_Load_Img_Info Load_Img_Info;
+    IT8951_Area_Img_Info Area_Img_Info;
+    UBYTE Value;
+
+    switch(Bits_Per_Pixel) {
+    case 1:
+        //Use 8bpp to set 1bpp, a set bit shows the white of BGVR
+        Load_Img_Info.Pixel_Format = IT8951_8BPP;
+        Value = (Gray & 0x80) ? 0xFF : 0x00;
+        break;
+    case 2:
+        Load_Img_Info.Pixel_Format = IT8951_2BPP;
+        Value = (Gray >> 6) * 0x55;
+        break;
+    case 4:
+        Load_Img_Info.Pixel_Format = IT8951_4BPP;
+        Value = (Gray & 0xF0) | (Gray >> 4);
+        break;
+    default:
+        Load_Img_Info.Pixel_Format = IT8951_8BPP;
+        Value = Gray;
+        Bits_Per_Pixel = 8;
+        break;
+    }
+    Load_Img_Info.Source_Buffer_Addr = NULL;
+    Load_Img_Info.Endian_Type = Dev->Load_Endian_Type;
+    Load_Img_Info.Rotate = IT8951_ROTATE_0;
+    Load_Img_Info.Target_Memory_Addr = Target_Memory_Addr;
+
+    Area_Img_Info.Area_X = (Bits_Per_Pixel == 1) ? X/8 : X;
+    Area_Img_Info.Area_Y = Y;
+    Area_Img_Info.Area_W = (Bits_Per_Pixel == 1) ? W/8 : W;
+    Area_Img_Info.Area_H = H;
 
-    for(UDOUBLE i=0; i<Source_Buffer_Height; i++)
+    EPD_IT8951_SetTargetMemoryAddr(Dev, Target_Memory_Addr);
+    EPD_IT8951_LoadImgAreaStart(Dev, &Load_Img_Info, &Area_Img_Info);
+    //from byte to word, 1bpp areas are loaded as 8bpp
+    EPD_IT8951_WriteRepeatData(Dev, (Value << 8) | Value,
+        (UDOUBLE)((Area_Img_Info.Area_W * ((Bits_Per_Pixel == 1) ? 8 : Bits_Per_Pixel) / 8) / 2) * H);
+    EPD_IT8951_LoadImgEnd(Dev);
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Fill_Load
+parameter:  
+Info:
+    EPD_IT8951_Fill_Write after the waveforms showing from the area,
+    which becomes the source of the next display command
+******************************************************************************/
+static void EPD_IT8951_Fill_Load(IT8951_Dev* Dev, UWORD X, UWORD Y, UWORD W, UWORD H, UBYTE Gray, UBYTE Bits_Per_Pixel, UDOUBLE Target_Memory_Addr)
+{
+    if(Bits_Per_Pixel == 1)
+        EPD_IT8951_Claim_Memory(Dev, Target_Memory_Addr, X/8, Y, W/8, H);
+    else
+        EPD_IT8951_Claim_Memory(Dev, Target_Memory_Addr, X, Y, W, H);
+    EPD_IT8951_Fill_Write(Dev, X, Y, W, H, Gray, Bits_Per_Pixel, Target_Memory_Addr);
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Stale_Clear
+parameter:  
+    X, Y, W, H     : panel area of Target_Memory_Addr that now holds what
+                     it is meant to
+    Bits_Per_Pixel : format it was written in
+Info:
+    Takes the area out of the stale ones, what is left of each is kept
+    as up to four pieces. A piece that finds no free entry gets its gray
+    loaded right away in the same format, so no stale pixel is ever
+    forgotten. Nothing changes after a failed call.
+******************************************************************************/
+static void EPD_IT8951_Stale_Clear(IT8951_Dev* Dev, UDOUBLE Target_Memory_Addr, UWORD X, UWORD Y, UWORD W, UWORD H, UBYTE Bits_Per_Pixel)
+{
+    if(Dev->Busy_Error != IT8951_OK)
+        return;
+
+    for(UBYTE i = 0; i < IT8951_MAX_STALE; i++)
     {
-        for(UDOUBLE j=0; j<Source_Buffer_Width; j++)
+        IT8951_Stale Old = Dev->Stale[i];
+        IT8951_Stale Piece[4];
+        UWORD Top, Bottom;
+
+        if(!Old.Active || Old.Mem_Addr != Target_Memory_Addr
+           || !EPD_IT8951_Rect_Overlap(Old.X, Old.Y, Old.W, Old.H, X, Y, W, H))
+            continue;
+        Dev->Stale[i].Active = false;
+
+        //the rows above and below the area, then the columns beside it
+        Top = (Y > Old.Y) ? Y : Old.Y;
+        Bottom = (Y + H < Old.Y + Old.H) ? Y + H : Old.Y + Old.H;
+        for(UBYTE p = 0; p < 4; p++)
+            Piece[p] = Old;
+        Piece[0].H = Top - Old.Y;
+        Piece[1].Y = Bottom;
+        Piece[1].H = Old.Y + Old.H - Bottom;
+        Piece[2].Y = Piece[3].Y = Top;
+        Piece[2].H = Piece[3].H = Bottom - Top;
+        Piece[2].W = (X > Old.X) ? X - Old.X : 0;
+        Piece[3].X = (X + W < Old.X + Old.W) ? X + W : Old.X + Old.W;
+        Piece[3].W = Old.X + Old.W - Piece[3].X;
+
+        for(UBYTE p = 0; p < 4; p++)
         {
-            EPD_IT8951_WriteData(*Source_Buffer);
-            Source_Buffer++;
+            UBYTE Free = 0;
+
+            if(Piece[p].W == 0 || Piece[p].H == 0)
+                continue;
+            while(Free < IT8951_MAX_STALE && Dev->Stale[Free].Active)
+                Free++;
+            if(Free < IT8951_MAX_STALE) {
+                Dev->Stale[Free] = Piece[p];
+            } else {
+                IT8951_Region Source = Dev->Display_Source;
+
+                EPD_IT8951_Fill_Load(Dev, Piece[p].X, Piece[p].Y, Piece[p].W, Piece[p].H, Piece[p].Gray, Bits_Per_Pixel, Target_Memory_Addr);
+                Dev->Display_Source = Source;
+            }
         }
     }
-    EPD_IT8951_LoadImgEnd();
 }
 
 
+/******************************************************************************
+function :	EPD_IT8951_Stale_Mark
+parameter:  
+Info:
+    Records the area of Target_Memory_Addr as showing Gray on the panel
+    while the buffer holds something else. A later fill of the same
+    pixels replaces the earlier one, the entries never overlap. False
+    when no entry is free, the buffer has to be loaded then.
+******************************************************************************/
+static bool EPD_IT8951_Stale_Mark(IT8951_Dev* Dev, UDOUBLE Target_Memory_Addr, UWORD X, UWORD Y, UWORD W, UWORD H, UBYTE Gray)
+{
+    //pieces of older fills that find no room are loaded as 4bpp, like a fill
+    EPD_IT8951_Stale_Clear(Dev, Target_Memory_Addr, X, Y, W, H, 4);
+
+    for(UBYTE i = 0; i < IT8951_MAX_STALE; i++)
+    {
+        if(Dev->Stale[i].Active)
+            continue;
+        Dev->Stale[i].Active = true;
+        Dev->Stale[i].Mem_Addr = Target_Memory_Addr;
+        Dev->Stale[i].X = X;
+        Dev->Stale[i].Y = Y;
+        Dev->Stale[i].W = W;
+        Dev->Stale[i].H = H;
+        Dev->Stale[i].Gray = Gray;
+        return true;
+    }
+    return false;
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Stale_Load
+parameter:  
+    X, Y, W, H     : panel area about to be shown from Target_Memory_Addr
+                     without loading it
+    Bits_Per_Pixel : format it is shown in
+Info:
+    For the display-only calls: the parts of the area a fill left stale
+    get their gray loaded first, so what is shown is the fill and not
+    what the buffer held before it. Free when nothing is stale.
+******************************************************************************/
+static void EPD_IT8951_Stale_Load(IT8951_Dev* Dev, UDOUBLE Target_Memory_Addr, UWORD X, UWORD Y, UWORD W, UWORD H, UBYTE Bits_Per_Pixel)
+{
+    bool Found = false;
+
+    for(UBYTE i = 0; i < IT8951_MAX_STALE; i++)
+    {
+        IT8951_Stale* Stale = &Dev->Stale[i];
+        UWORD X0, Y0, X1, Y1;
+
+        if(!Stale->Active || Stale->Mem_Addr != Target_Memory_Addr
+           || !EPD_IT8951_Rect_Overlap(Stale->X, Stale->Y, Stale->W, Stale->H, X, Y, W, H))
+            continue;
+        X0 = (X > Stale->X) ? X : Stale->X;
+        Y0 = (Y > Stale->Y) ? Y : Stale->Y;
+        X1 = (X + W < Stale->X + Stale->W) ? X + W : Stale->X + Stale->W;
+        Y1 = (Y + H < Stale->Y + Stale->H) ? Y + H : Stale->Y + Stale->H;
+        EPD_IT8951_Fill_Load(Dev, X0, Y0, X1 - X0, Y1 - Y0, Stale->Gray, Bits_Per_Pixel, Target_Memory_Addr);
+        Found = true;
+    }
+    if(Found)
+        EPD_IT8951_Stale_Clear(Dev, Target_Memory_Addr, X, Y, W, H, Bits_Per_Pixel);
+}
+
 
+/******************************************************************************
+function :	EPD_IT8951_Stale_Flush
+parameter:  
+Info:
+    Loads every stale area with its gray as 4bpp and forgets them all.
+    For the calls that write buffers behind the table's back, a replay
+    or a raw burst write, which a later Stale_Load would undo.
+******************************************************************************/
+static void EPD_IT8951_Stale_Flush(IT8951_Dev* Dev)
+{
+    for(UBYTE i = 0; i < IT8951_MAX_STALE && Dev->Busy_Error == IT8951_OK; i++)
+    {
+        IT8951_Stale* Stale = &Dev->Stale[i];
 
+        if(!Stale->Active)
+            continue;
+        EPD_IT8951_Fill_Load(Dev, Stale->X, Stale->Y, Stale->W, Stale->H, Stale->Gray, 4, Stale->Mem_Addr);
+        Stale->Active = false;
+    }
+}
 
 
 /******************************************************************************
 function :	EPD_IT8951_Display_Area
 parameter:  
 ******************************************************************************/
-static void EPD_IT8951_Display_Area(UWORD X,UWORD Y,UWORD W,UWORD H,UWORD Mode)
+static void EPD_IT8951_Display_Area(IT8951_Dev* Dev, UWORD X,UWORD Y,UWORD W,UWORD H,UWORD Mode)
 {
     UWORD Args[5];
     Args[0] = X;
@@ -562,7 +1923,8 @@ static void EPD_IT8951_Display_Area(UWORD X,UWORD Y,UWORD W,UWORD H,UWORD Mode)
     Args[3] = H;
     Args[4] = Mode;
     //0x0034
-    EPD_IT8951_WriteMultiArg(USDEF_I80_CMD_DPY_AREA, Args,5);
+    EPD_IT8951_WriteMultiArg(Dev, USDEF_I80_CMD_DPY_AREA, Args,5);
+    EPD_IT8951_Region_Start(Dev, X, Y, W, H, Mode);
 }
 
 
@@ -571,7 +1933,7 @@ static void EPD_IT8951_Display_Area(UWORD X,UWORD Y,UWORD W,UWORD H,UWORD Mode)
 function :	EPD_IT8951_Display_AreaBuf
 parameter:  
 ******************************************************************************/
-static void EPD_IT8951_Display_AreaBuf(UWORD X,UWORD Y,UWORD W,UWORD H,UWORD Mode, UDOUBLE Target_Memory_Addr)
+static void EPD_IT8951_Display_AreaBuf(IT8951_Dev* Dev, UWORD X,UWORD Y,UWORD W,UWORD H,UWORD Mode, UDOUBLE Target_Memory_Addr)
 {
     UWORD Args[7];
     Args[0] = X;
@@ -582,34 +1944,111 @@ static void EPD_IT8951_Display_AreaBuf(UWORD X,UWORD Y,UWORD W,UWORD H,UWORD Mod
     Args[5] = (UWORD)Target_Memory_Addr;
     Args[6] = (UWORD)(Target_Memory_Addr>>16);
     //0x0037
-    EPD_IT8951_WriteMultiArg(USDEF_I80_CMD_DPY_BUF_AREA, Args,7); 
+    EPD_IT8951_WriteMultiArg(Dev, USDEF_I80_CMD_DPY_BUF_AREA, Args,7); 
+    EPD_IT8951_Region_Start(Dev, X, Y, W, H, Mode);
 }
 
 
 
+/******************************************************************************
+function :	EPD_IT8951_Write_Display_Reg
+parameter:  
+Info:
+    For registers every LUT engine shares (1bpp mode, BGVR). Changing one
+    waits for the running waveforms; writing the value it already has is
+    free thanks to the shadow cache. While recording it is always
+    written, the controller the stream is replayed on may hold another
+    value.
+******************************************************************************/
+static void EPD_IT8951_Write_Display_Reg(IT8951_Dev* Dev, UWORD Reg_Address, UWORD Reg_Value)
+{
+    int Slot = EPD_IT8951_Shadow_Slot(Reg_Address);
+
+    if(Dev->Recording != NULL) {
+        if(Slot >= 0)
+            Dev->Shadow_Reg[Slot].Valid = false;
+    } else if(EPD_IT8951_ReadReg(Dev, Reg_Address) == Reg_Value) {
+        return;
+    }
+    EPD_IT8951_WaitForDisplayReady(Dev);
+    EPD_IT8951_WriteReg(Dev, Reg_Address, Reg_Value);
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Set_1bpp_Mode
+parameter:  
+Info:
+    Display mode 1 bpp - 0x18001138 Bit[18](0x1800113A Bit[2]). With the
+    shadow cache this is free while the bit already has the wanted value,
+    except while recording.
+******************************************************************************/
+static void EPD_IT8951_Set_1bpp_Mode(IT8951_Dev* Dev, bool Enable)
+{
+    UWORD Reg_Value = EPD_IT8951_ReadReg(Dev, UP1SR+2);
+
+    if(Enable)
+        Reg_Value |= (1<<2);
+    else
+        Reg_Value &= ~(1<<2);
+    EPD_IT8951_Write_Display_Reg(Dev, UP1SR+2, Reg_Value);
+}
+
+
 /******************************************************************************
 function :	EPD_IT8951_Display_1bp
 parameter:  
+Info:
+    The 1bpp bit is left set, so back to back 1bpp refreshes cost no
+    register traffic and do not wait for their waveform. Refreshes in
+    other modes clear it again.
 ******************************************************************************/
-static void EPD_IT8951_Display_1bp(UWORD X, UWORD Y, UWORD W, UWORD H, UWORD Mode,UDOUBLE Target_Memory_Addr, UBYTE Back_Gray_Val,UBYTE Front_Gray_Val)
+static void EPD_IT8951_Display_1bp(IT8951_Dev* Dev, UWORD X, UWORD Y, UWORD W, UWORD H, UWORD Mode,UDOUBLE Target_Memory_Addr, UBYTE Back_Gray_Val,UBYTE Front_Gray_Val)
 {
     //Set Display mode to 1 bpp mode - Set 0x18001138 Bit[18](0x1800113A Bit[2])to 1
-    EPD_IT8951_WriteReg(UP1SR+2, EPD_IT8951_ReadReg(UP1SR+2) | (1<<2) );
+    EPD_IT8951_Set_1bpp_Mode(Dev, true);
 
-    EPD_IT8951_WriteReg(BGVR, (Front_Gray_Val<<8) | Back_Gray_Val);
+    EPD_IT8951_Write_Display_Reg(Dev, BGVR, (Front_Gray_Val<<8) | Back_Gray_Val);
 
     if(Target_Memory_Addr == 0)
     {
-        EPD_IT8951_Display_Area(X,Y,W,H,Mode);
+        EPD_IT8951_Display_Area(Dev, X,Y,W,H,Mode);
     }
     else
     {
-        EPD_IT8951_Display_AreaBuf(X,Y,W,H,Mode,Target_Memory_Addr);
+        EPD_IT8951_Display_AreaBuf(Dev, X,Y,W,H,Mode,Target_Memory_Addr);
     }
-    
-    EPD_IT8951_WaitForDisplayReady();
+}
+
 
-    EPD_IT8951_WriteReg(UP1SR+2, EPD_IT8951_ReadReg(UP1SR+2) & ~(1<<2) );
+/******************************************************************************
+function :	EPD_IT8951_Wake
+parameter:  
+Info:
+    At the start of every public call that touches the panel or its memory.
+    Leaving standby or sleep is SYS_RUN until HRDY, its duration is kept
+    per state as a running average.
+******************************************************************************/
+static void EPD_IT8951_Wake(IT8951_Dev* Dev)
+{
+    uint64_t Start = DEV_Time_us();
+    UBYTE From = Dev->Power_State;
+
+    Dev->Last_Access_us = Start;
+    if(From == IT8951_POWER_RUN)
+        return;
+
+    EPD_IT8951_WriteCommand(Dev, IT8951_TCON_SYS_RUN);
+    EPD_IT8951_ReadBusy(Dev);
+    if(Dev->Busy_Error != IT8951_OK)
+        return;
+
+    Dev->Power_State = IT8951_POWER_RUN;
+    Dev->Last_Access_us = DEV_Time_us();
+    if(Dev->Wake_us[From] == 0)
+        Dev->Wake_us[From] = Dev->Last_Access_us - Start;
+    else
+        Dev->Wake_us[From] = (Dev->Wake_us[From] * 3 + (Dev->Last_Access_us - Start)) / 4;
 }
 
 
@@ -617,15 +2056,19 @@ static void EPD_IT8951_Display_1bp(UWORD X, UWORD Y, UWORD W, UWORD H, UWORD Mod
 function :	Enhanced driving capability
 parameter:  Enhanced driving capability for IT8951, in case the blurred display effect
 ******************************************************************************/
-void Enhance_Driving_Capability(void)
+void Enhance_Driving_Capability(IT8951_Dev* Dev)
 {
-    UWORD RegValue = EPD_IT8951_ReadReg(0x0038);
+    EPD_IT8951_Enter(Dev);
+
+    UWORD RegValue = EPD_IT8951_ReadReg(Dev, 0x0038);
     Debug("The reg value before writing is %x\r\n", RegValue);
 
-    EPD_IT8951_WriteReg(0x0038, 0x0602);
+    EPD_IT8951_WriteReg(Dev, 0x0038, 0x0602);
 
-    RegValue = EPD_IT8951_ReadReg(0x0038);
+    RegValue = EPD_IT8951_ReadReg(Dev, 0x0038);
     Debug("The reg value after writing is %x\r\n", RegValue);
+
+    EPD_IT8951_Leave(Dev);
 }
 
 
@@ -635,29 +2078,471 @@ void Enhance_Driving_Capability(void)
 function :	Cmd1 SYS_RUN
 parameter:  Run the system
 ******************************************************************************/
-void EPD_IT8951_SystemRun(void)
+UBYTE EPD_IT8951_SystemRun(IT8951_Dev* Dev)
+{
+    EPD_IT8951_Enter(Dev);
+
+    if(Dev->Power_State != IT8951_POWER_RUN) {
+        EPD_IT8951_Wake(Dev);
+    } else {
+        EPD_IT8951_WriteCommand(Dev, IT8951_TCON_SYS_RUN);
+        Dev->Last_Access_us = DEV_Time_us();
+    }
+
+    return EPD_IT8951_Leave(Dev);
+}
+
+
+/******************************************************************************
+function :	Cmd2 STANDBY
+parameter:  Standby
+******************************************************************************/
+UBYTE EPD_IT8951_Standby(IT8951_Dev* Dev)
+{
+    EPD_IT8951_Enter(Dev);
+
+    EPD_IT8951_WaitForDisplayReady(Dev);
+    EPD_IT8951_WriteCommand(Dev, IT8951_TCON_STANDBY);
+    if(Dev->Busy_Error == IT8951_OK && Dev->Power_State == IT8951_POWER_RUN)
+        Dev->Power_State = IT8951_POWER_STANDBY;
+
+    return EPD_IT8951_Leave(Dev);
+}
+
+
+/******************************************************************************
+function :	Cmd3 SLEEP
+parameter:  Sleep
+******************************************************************************/
+UBYTE EPD_IT8951_Sleep(IT8951_Dev* Dev)
+{
+    EPD_IT8951_Enter(Dev);
+
+    EPD_IT8951_WaitForDisplayReady(Dev);
+    EPD_IT8951_WriteCommand(Dev, IT8951_TCON_SLEEP);
+    EPD_IT8951_Shadow_Invalidate(Dev);
+    if(Dev->Busy_Error == IT8951_OK)
+        Dev->Power_State = IT8951_POWER_SLEEP;
+
+    return EPD_IT8951_Leave(Dev);
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Set_Load_Endian
+parameter:  Endian_Type: IT8951_LDIMG_B_ENDIAN (default, zero copy) or
+            IT8951_LDIMG_L_ENDIAN (words swapped on the host)
+******************************************************************************/
+void EPD_IT8951_Set_Load_Endian(IT8951_Dev* Dev, UWORD Endian_Type)
+{
+    pthread_mutex_lock(&Dev->Lock);
+    Dev->Load_Endian_Type = (Endian_Type == IT8951_LDIMG_L_ENDIAN) ? IT8951_LDIMG_L_ENDIAN : IT8951_LDIMG_B_ENDIAN;
+    pthread_mutex_unlock(&Dev->Lock);
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Set_Orientation
+parameter:  Rotate : IT8951_ROTATE_0/90/180/270, clockwise
+            Mirror : canvas mirrored left to right before it is turned
+Info:
+    Frame buffers are then drawn upright, on a canvas of the size
+    EPD_IT8951_Get_Canvas_Size gives, and every X, Y, W, H the driver is
+    passed is on that canvas. The 2, 4 and 8bpp formats are turned by the
+    controller as they are loaded; mirrored rows and 1bpp areas are
+    reordered on the host, a row at a time where it can. A quarter turn
+    puts Y and H of 1bpp areas where X and W were, aligned like them,
+    and their W must be whole bytes; other areas fail with
+    IT8951_ERR_AREA.
+******************************************************************************/
+void EPD_IT8951_Set_Orientation(IT8951_Dev* Dev, UBYTE Rotate, bool Mirror)
+{
+    pthread_once(&Reverse_Once, EPD_IT8951_Reverse_Init);
+
+    pthread_mutex_lock(&Dev->Lock);
+    Dev->Load_Rotate = Rotate & 3;
+    Dev->Load_Mirror = Mirror;
+    pthread_mutex_unlock(&Dev->Lock);
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Get_Canvas_Size
+parameter:  
+Info:
+    Size of the upright canvas, the panel's own once a quarter turn is set
+    swapped. A turned or mirrored canvas is cut to a multiple of 32 wide.
+******************************************************************************/
+void EPD_IT8951_Get_Canvas_Size(IT8951_Dev* Dev, UWORD* W, UWORD* H)
+{
+    pthread_mutex_lock(&Dev->Lock);
+    if(Dev->Load_Rotate & 1) {
+        *W = Dev->Info.Panel_H;
+        *H = EPD_IT8951_Oriented_W(Dev);
+    } else {
+        *W = EPD_IT8951_Oriented_W(Dev);
+        *H = Dev->Info.Panel_H;
+    }
+    pthread_mutex_unlock(&Dev->Lock);
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Map_Area
+parameter:  
+Info:
+    Canvas area to the panel area it ends up on, in place; for code that
+    places things in controller memory itself
+******************************************************************************/
+void EPD_IT8951_Map_Area(IT8951_Dev* Dev, UWORD* X, UWORD* Y, UWORD* W, UWORD* H)
+{
+    pthread_mutex_lock(&Dev->Lock);
+    EPD_IT8951_Canvas_To_Panel(Dev, X, Y, W, H);
+    pthread_mutex_unlock(&Dev->Lock);
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Set_Pipeline
+parameter:  Second_Memory_Addr : a second image buffer in controller SDRAM,
+                                 0 turns pipelining off
+Info:
+    While on, the 1/2/4/8bp refreshes load frame N+1 into the buffer frame
+    N is not shown from while frame N's waveform runs, and show it with
+    DPY_BUF_AREA as soon as the LUT engines are free. The buffer has to
+    hold a full frame, Dev_Info.Memory_Addr + Panel_W * Panel_H is the
+    usual choice. Areas are shown from the buffer they were loaded into,
+    so the Hold flag has no effect while pipelining.
+******************************************************************************/
+void EPD_IT8951_Set_Pipeline(IT8951_Dev* Dev, UDOUBLE Second_Memory_Addr)
+{
+    pthread_mutex_lock(&Dev->Lock);
+    Dev->Pipeline_Addr = Second_Memory_Addr;
+    Dev->Pipeline_Next = 0;
+    pthread_mutex_unlock(&Dev->Lock);
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Set_Busy_Timeout
+parameter:  Busy_ms    : longest wait for HRDY before a transfer
+            Display_ms : longest wait for LUTAFSR to clear
+            0 waits forever, as the driver used to
+******************************************************************************/
+void EPD_IT8951_Set_Busy_Timeout(IT8951_Dev* Dev, UDOUBLE Busy_ms, UDOUBLE Display_ms)
+{
+    pthread_mutex_lock(&Dev->Lock);
+    Dev->Busy_Timeout_ms = Busy_ms;
+    Dev->Display_Timeout_ms = Display_ms;
+    pthread_mutex_unlock(&Dev->Lock);
+}
+
+void EPD_IT8951_Get_Busy_Timeout(IT8951_Dev* Dev, UDOUBLE* Busy_ms, UDOUBLE* Display_ms)
+{
+    *Busy_ms = Dev->Busy_Timeout_ms;
+    *Display_ms = Dev->Display_Timeout_ms;
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Get_Error
+parameter:  
+Info:
+    Status of the last public call, for EPD_IT8951_Init which returns
+    the device info instead
+******************************************************************************/
+UBYTE EPD_IT8951_Get_Error(IT8951_Dev* Dev)
+{
+    return Dev->Busy_Error;
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Predict_Display_us
+parameter:  
+Info:
+    Expected waveform time of a W*H = Pixels refresh in Mode, as learned
+    from earlier refreshes, 0 while the mode has not been seen
+******************************************************************************/
+UDOUBLE EPD_IT8951_Predict_Display_us(IT8951_Dev* Dev, UWORD Mode, UDOUBLE Pixels)
+{
+    return EPD_IT8951_LUT_Predict(Dev, Mode, Pixels);
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Get_Power_State
+parameter:  
+Info:
+    IT8951_POWER_RUN, _STANDBY or _SLEEP as last commanded
+******************************************************************************/
+UBYTE EPD_IT8951_Get_Power_State(IT8951_Dev* Dev)
+{
+    return Dev->Power_State;
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Get_Wake_us
+parameter:  
+    State : IT8951_POWER_STANDBY or IT8951_POWER_SLEEP
+Info:
+    Average time SYS_RUN took to bring the controller back from State,
+    0 until it was seen once
+******************************************************************************/
+UDOUBLE EPD_IT8951_Get_Wake_us(IT8951_Dev* Dev, UBYTE State)
+{
+    return (State < IT8951_POWER_STATES) ? Dev->Wake_us[State] : 0;
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Get_Idle_ms
+parameter:  
+Info:
+    Time since the last public call that used the controller
+******************************************************************************/
+UDOUBLE EPD_IT8951_Get_Idle_ms(IT8951_Dev* Dev)
+{
+    return (UDOUBLE)((DEV_Time_us() - Dev->Last_Access_us) / 1000);
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Mem_Burst_Args
+parameter:  
+******************************************************************************/
+static void EPD_IT8951_Mem_Burst_Args(IT8951_Dev* Dev, UWORD Cmd, UDOUBLE Mem_Addr, UDOUBLE Word_Count)
+{
+    UWORD Args[4];
+    Args[0] = (UWORD)(Mem_Addr & 0x0000FFFF);         //addr[15:0]
+    Args[1] = (UWORD)((Mem_Addr >> 16) & 0x0000FFFF); //addr[25:16]
+    Args[2] = (UWORD)(Word_Count & 0x0000FFFF);       //Cnt[15:0]
+    Args[3] = (UWORD)((Word_Count >> 16) & 0x0000FFFF);//Cnt[25:16]
+    EPD_IT8951_WriteMultiArg(Dev, Cmd, Args, 4);
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Mem_Burst_Write
+parameter:  
+    Mem_Addr   : controller address, even
+    Data_Buf   : words in host order
+    Word_Count : number of words
+Info:
+    Cmd8 MEM_BST_WR, the data goes out in one bulk transaction without LD_IMG
+    framing. The word at Mem_Addr holds the bytes Mem_Addr and Mem_Addr+1 in
+    its low and high half, so on the Pi a byte image in controller address
+    order can be passed as is. Areas left stale by a fill get their gray
+    loaded first, nothing would show the write otherwise, and waveforms
+    still showing from the range are waited for.
+******************************************************************************/
+UBYTE EPD_IT8951_Mem_Burst_Write(IT8951_Dev* Dev, UDOUBLE Mem_Addr, UWORD* Data_Buf, UDOUBLE Word_Count)
+{
+    EPD_IT8951_Enter(Dev);
+    EPD_IT8951_Wake(Dev);
+    EPD_IT8951_Stale_Flush(Dev);
+    EPD_IT8951_Claim_Bytes(Dev, Mem_Addr, Word_Count*2);
+
+    EPD_IT8951_Mem_Burst_Args(Dev, IT8951_TCON_MEM_BST_WR, Mem_Addr, Word_Count);
+    EPD_IT8951_WriteMuitiData(Dev, Data_Buf, Word_Count);
+    EPD_IT8951_WriteCommand(Dev, IT8951_TCON_MEM_BST_END);
+
+    //registers are mapped into the same space
+    if(Mem_Addr + Word_Count*2 > IT8951_REG_MEM_BASE)
+        EPD_IT8951_Shadow_Invalidate(Dev);
+
+    return EPD_IT8951_Leave(Dev);
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Mem_Burst_Read
+parameter:  
+    Mem_Addr   : controller address, even
+    Data_Buf   : receives the words in host order
+    Word_Count : number of words
+Info:
+    Cmd6 MEM_BST_RD_T + Cmd7 MEM_BST_RD_S, then one bulk SPI read
+******************************************************************************/
+UBYTE EPD_IT8951_Mem_Burst_Read(IT8951_Dev* Dev, UDOUBLE Mem_Addr, UWORD* Data_Buf, UDOUBLE Word_Count)
+{
+    EPD_IT8951_Enter(Dev);
+    EPD_IT8951_Wake(Dev);
+
+    EPD_IT8951_Mem_Burst_Args(Dev, IT8951_TCON_MEM_BST_RD_T, Mem_Addr, Word_Count);
+    EPD_IT8951_WriteCommand(Dev, IT8951_TCON_MEM_BST_RD_S);
+    EPD_IT8951_ReadMultiData(Dev, Data_Buf, Word_Count);
+    EPD_IT8951_WriteCommand(Dev, IT8951_TCON_MEM_BST_END);
+
+    return EPD_IT8951_Leave(Dev);
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Mem_Copy
+parameter:  
+    Dst_Addr, Src_Addr : controller addresses, even
+    Byte_Count         : even
+Info:
+    The controller has no copy command, the data passes through the host
+    in IT8951_SPI_CHUNK_SIZE pieces. Overlapping ranges are handled.
+******************************************************************************/
+UBYTE EPD_IT8951_Mem_Copy(IT8951_Dev* Dev, UDOUBLE Dst_Addr, UDOUBLE Src_Addr, UDOUBLE Byte_Count)
+{
+    UWORD Copy_Buf[IT8951_SPI_CHUNK_SIZE/2];
+    UDOUBLE Chunk, Offset;
+    bool Backward = (Dst_Addr > Src_Addr) && (Dst_Addr < Src_Addr + Byte_Count);
+
+    EPD_IT8951_Enter(Dev);
+    //before the first read, a stale source is copied as what it shows
+    EPD_IT8951_Wake(Dev);
+    EPD_IT8951_Stale_Flush(Dev);
+    //one wait for the whole destination, not one per chunk
+    EPD_IT8951_Claim_Bytes(Dev, Dst_Addr, Byte_Count);
+
+    for(UDOUBLE Done = 0; Done < Byte_Count && Dev->Busy_Error == IT8951_OK; Done += Chunk)
+    {
+        Chunk = (Byte_Count - Done > IT8951_SPI_CHUNK_SIZE) ? IT8951_SPI_CHUNK_SIZE : Byte_Count - Done;
+        Offset = Backward ? Byte_Count - Done - Chunk : Done;
+        EPD_IT8951_Mem_Burst_Read(Dev, Src_Addr + Offset, Copy_Buf, Chunk/2);
+        if(Dev->Busy_Error == IT8951_OK)
+            EPD_IT8951_Mem_Burst_Write(Dev, Dst_Addr + Offset, Copy_Buf, Chunk/2);
+    }
+    return EPD_IT8951_Leave(Dev);
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Wait_Display
+parameter:  
+Info:
+    Until every waveform the driver started on this panel has finished.
+    The refreshes return once the display command is out, this is for
+    callers that need the picture settled, e.g. before powering down.
+******************************************************************************/
+UBYTE EPD_IT8951_Wait_Display(IT8951_Dev* Dev)
+{
+    EPD_IT8951_Enter(Dev);
+    EPD_IT8951_WaitForDisplayReady(Dev);
+    return EPD_IT8951_Leave(Dev);
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Get_Active_Regions
+parameter:  
+Info:
+    Display commands whose waveform may still be running, as of the last
+    LUTAFSR poll; no bus traffic
+******************************************************************************/
+UBYTE EPD_IT8951_Get_Active_Regions(IT8951_Dev* Dev)
+{
+    UBYTE Count = 0;
+
+    for(int i = 0; i < IT8951_MAX_REGIONS; i++)
+    {
+        if(Dev->Region[i].Active)
+            Count++;
+    }
+    return Count;
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Area_Busy
+parameter:  
+Info:
+    Whether a waveform may still run on part of the panel area. A region
+    the LUT model expects to run for a while yet counts as busy without
+    bus traffic, otherwise LUTAFSR is read once. Does not wait.
+******************************************************************************/
+bool EPD_IT8951_Area_Busy(IT8951_Dev* Dev, UWORD X, UWORD Y, UWORD W, UWORD H)
+{
+    IT8951_Region Area;
+    uint64_t Now = DEV_Time_us();
+    bool Busy = false, Poll = false;
+    UWORD Status;
+
+    EPD_IT8951_Enter(Dev);
+    EPD_IT8951_Canvas_To_Panel(Dev, &X, &Y, &W, &H);
+    Area.X = X;
+    Area.Y = Y;
+    Area.W = W;
+    Area.H = H;
+    for(int i = 0; i < IT8951_MAX_REGIONS; i++)
+    {
+        IT8951_Region* R = &Dev->Region[i];
+        if(!R->Active || !EPD_IT8951_Match_Panel(Dev, R, &Area))
+            continue;
+        Busy = true;
+        if(R->Last_Busy_us != 0 || EPD_IT8951_LUT_Wake(Dev, R) <= Now)
+            Poll = true;
+    }
+
+    if(Poll)
+    {
+        EPD_IT8951_Wake(Dev);
+        Dev->Record_Hold++;
+        Status = EPD_IT8951_ReadReg(Dev, LUTAFSR);
+        Dev->Record_Hold--;
+        if(Dev->Busy_Error == IT8951_OK) {
+            EPD_IT8951_Region_Update(Dev, Status, DEV_Time_us());
+            Busy = false;
+            for(int i = 0; i < IT8951_MAX_REGIONS; i++)
+            {
+                if(Dev->Region[i].Active && EPD_IT8951_Match_Panel(Dev, &Dev->Region[i], &Area))
+                    Busy = true;
+            }
+        }
+    }
+
+    EPD_IT8951_Leave(Dev);
+    return Busy;
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Invalidate_Reg_Cache
+parameter:  
+Info:
+    For code that touches the controller registers behind the driver
+******************************************************************************/
+void EPD_IT8951_Invalidate_Reg_Cache(IT8951_Dev* Dev)
 {
-    EPD_IT8951_WriteCommand(IT8951_TCON_SYS_RUN);
+    EPD_IT8951_Shadow_Invalidate(Dev);
 }
 
 
 /******************************************************************************
-function :	Cmd2 STANDBY
-parameter:  Standby
+function :	EPD_IT8951_Read_Reg
+parameter:  
+Info:
+    Goes through the register shadow, call EPD_IT8951_Invalidate_Reg_Cache
+    first to force a bus read
 ******************************************************************************/
-void EPD_IT8951_Standby(void)
+UWORD EPD_IT8951_Read_Reg(IT8951_Dev* Dev, UWORD Reg_Address)
 {
-    EPD_IT8951_WriteCommand(IT8951_TCON_STANDBY);
+    UWORD Value;
+
+    EPD_IT8951_Enter(Dev);
+    EPD_IT8951_Wake(Dev);
+    Value = EPD_IT8951_ReadReg(Dev, Reg_Address);
+    EPD_IT8951_Leave(Dev);
+    return Value;
 }
 
 
 /******************************************************************************
-function :	Cmd3 SLEEP
-parameter:  Sleep
+function :	EPD_IT8951_Write_Reg
+parameter:  
 ******************************************************************************/
-void EPD_IT8951_Sleep(void)
+UBYTE EPD_IT8951_Write_Reg(IT8951_Dev* Dev, UWORD Reg_Address, UWORD Reg_Value)
 {
-    EPD_IT8951_WriteCommand(IT8951_TCON_SLEEP);
+    EPD_IT8951_Enter(Dev);
+    EPD_IT8951_Wake(Dev);
+    EPD_IT8951_WriteReg(Dev, Reg_Address, Reg_Value);
+    return EPD_IT8951_Leave(Dev);
 }
 
 
@@ -665,63 +2550,188 @@ void EPD_IT8951_Sleep(void)
 function :	EPD_IT8951_Init
 parameter:  
 ******************************************************************************/
-IT8951_Dev_Info EPD_IT8951_Init(UWORD VCOM)
+IT8951_Dev_Info EPD_IT8951_Init(IT8951_Dev* Dev, UWORD VCOM)
 {
     IT8951_Dev_Info Dev_Info;
 
-    EPD_IT8951_Reset();
+    EPD_IT8951_Enter(Dev);
+
+    EPD_IT8951_Reset(Dev);
+    EPD_IT8951_Shadow_Invalidate(Dev);
+    memset(Dev->Region, 0, sizeof(Dev->Region));
+    memset(Dev->Stale, 0, sizeof(Dev->Stale));
+    Dev->Power_State = IT8951_POWER_RUN;
+    Dev->Last_Access_us = DEV_Time_us();
 
-    EPD_IT8951_SystemRun();
+    EPD_IT8951_WriteCommand(Dev, IT8951_TCON_SYS_RUN);
 
-    EPD_IT8951_GetSystemInfo(&Dev_Info);
+    memset(&Dev_Info, 0, sizeof(Dev_Info));
+    EPD_IT8951_GetSystemInfo(Dev, &Dev_Info);
+    Dev->Info = Dev_Info;
+    Dev->Image_Pitch = Dev_Info.Panel_W;
     
     //Enable Pack write
-    EPD_IT8951_WriteReg(I80CPCR,0x0001);
+    EPD_IT8951_WriteReg(Dev, I80CPCR,0x0001);
 
     //Set VCOM by handle
-    if(VCOM != EPD_IT8951_GetVCOM())
+    if(VCOM != EPD_IT8951_GetVCOM(Dev))
     {
-        EPD_IT8951_SetVCOM(VCOM);
-        Debug("VCOM = -%.02fV\n",(float)EPD_IT8951_GetVCOM()/1000);
+        EPD_IT8951_SetVCOM(Dev, VCOM);
+        Debug("VCOM = -%.02fV\n",(float)EPD_IT8951_GetVCOM(Dev)/1000);
     }
+    EPD_IT8951_Leave(Dev);
     return Dev_Info;
 }
 
 
 /******************************************************************************
-function :	EPD_IT8951_Clear_Refresh
+function :	EPD_IT8951_Attach
 parameter:  
+    Dev_Info : as returned by EPD_IT8951_Init when the controller was
+               brought up, kept by the caller
+Info:
+    Takes over a controller that another process configured, without
+    reset, system info or VCOM read-back. IT8951_ERR_NOT_RUNNING when it
+    was reset or powered down since, EPD_IT8951_Init is needed then.
+    A waveform the previous owner left running is waited for like our own.
 ******************************************************************************/
-void EPD_IT8951_Clear_Refresh(IT8951_Dev_Info Dev_Info,UDOUBLE Target_Memory_Addr, UWORD Mode)
+UBYTE EPD_IT8951_Attach(IT8951_Dev* Dev, IT8951_Dev_Info Dev_Info, UWORD VCOM)
 {
+    UWORD Status;
 
-    UDOUBLE ImageSize = ((Dev_Info.Panel_W * 4 % 8 == 0)? (Dev_Info.Panel_W * 4 / 8 ): (Dev_Info.Panel_W * 4 / 8 + 1)) * Dev_Info.Panel_H;
-    UBYTE* Frame_Buf = malloc (ImageSize);
-    memset(Frame_Buf, 0xFF, ImageSize);
+    EPD_IT8951_Enter(Dev);
 
+    EPD_IT8951_Shadow_Invalidate(Dev);
+    memset(Dev->Region, 0, sizeof(Dev->Region));
+    memset(Dev->Stale, 0, sizeof(Dev->Stale));
 
-    IT8951_Load_Img_Info Load_Img_Info;
-    IT8951_Area_Img_Info Area_Img_Info;
+    if(Dev_Info.Panel_W == 0 || Dev_Info.Panel_H == 0
+       || DEV_Wait_Pin(Dev->Busy_Pin, HIGH, IT8951_ATTACH_TIMEOUT_MS) != 0) {
+        Dev->Busy_Error = IT8951_ERR_NOT_RUNNING;
+        return EPD_IT8951_Leave(Dev);
+    }
 
-    EPD_IT8951_WaitForDisplayReady();
+    //wakes it from standby or sleep, a no-op when running
+    EPD_IT8951_WriteCommand(Dev, IT8951_TCON_SYS_RUN);
+
+    //pack mode is off after reset and on once EPD_IT8951_Init ran
+    if(EPD_IT8951_ReadReg(Dev, I80CPCR) != 0x0001 || Dev->Busy_Error != IT8951_OK) {
+        EPD_IT8951_Shadow_Invalidate(Dev);
+        if(Dev->Busy_Error == IT8951_OK)
+            Dev->Busy_Error = IT8951_ERR_NOT_RUNNING;
+        return EPD_IT8951_Leave(Dev);
+    }
+
+    Status = EPD_IT8951_ReadReg(Dev, LUTAFSR);
+    if(Status != 0) {
+        Dev->Region[0].Active = true;
+        Dev->Region[0].W = Dev_Info.Panel_W;
+        Dev->Region[0].H = Dev_Info.Panel_H;
+        Dev->Region[0].Mode = IT8951_LUT_MODES;
+        Dev->Region[0].Engine_Mask = Status;
+        Dev->Region[0].Start_us = Dev->Region[0].Last_Busy_us = DEV_Time_us();
+    }
+
+    Dev->Info = Dev_Info;
+    Dev->Image_Pitch = Dev_Info.Panel_W;
+    EPD_IT8951_SetVCOM(Dev, VCOM);
+    Dev->Power_State = IT8951_POWER_RUN;
+    Dev->Last_Access_us = DEV_Time_us();
+
+    return EPD_IT8951_Leave(Dev);
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Fill_Show
+parameter:  
+    Gray : like the Paint colors, 0x00 black .. 0xF0 white
+Info:
+    In 1bpp mode a pixel shows one of the two BGVR values, with both set
+    to Gray the buffer does not matter and no pixel is loaded. That wants
+    X and W in whole bytes like the 1bpp refreshes, 4 of them on
+    Four_Byte_Align panels. The area of Target_Memory_Addr is left as it
+    was and marked stale instead, see EPD_IT8951_Stale_Load. False when
+    the area does not suit, no stale entry is free or the panel is being
+    recorded, nothing is sent then.
+******************************************************************************/
+static bool EPD_IT8951_Fill_Show(IT8951_Dev* Dev, UWORD X, UWORD Y, UWORD W, UWORD H, UBYTE Gray, UWORD Mode, UDOUBLE Target_Memory_Addr)
+{
+    UWORD Align = Dev->Four_Byte_Align ? 32 : 8;
+
+    //a replay has no stale table to match, the stream has to load the gray
+    if(Dev->Recording != NULL || X % Align != 0 || W % Align != 0
+       || !EPD_IT8951_Stale_Mark(Dev, Target_Memory_Addr, X, Y, W, H, Gray))
+        return false;
+
+    //shown from no buffer at all, loads anywhere may go on
+    memset(&Dev->Display_Source, 0, sizeof(Dev->Display_Source));
+    EPD_IT8951_Begin_Display(Dev, X, Y, W, H);
+    EPD_IT8951_Display_1bp(Dev, X, Y, W, H, Mode, 0, Gray, Gray);
+    return true;
+}
 
-    Load_Img_Info.Source_Buffer_Addr = Frame_Buf;
-    Load_Img_Info.Endian_Type = IT8951_LDIMG_L_ENDIAN;
-    Load_Img_Info.Pixel_Format = IT8951_4BPP;
-    Load_Img_Info.Rotate =  IT8951_ROTATE_0;
-    Load_Img_Info.Target_Memory_Addr = Target_Memory_Addr;
 
-    Area_Img_Info.Area_X = 0;
-    Area_Img_Info.Area_Y = 0;
-    Area_Img_Info.Area_W = Dev_Info.Panel_W;
-    Area_Img_Info.Area_H = Dev_Info.Panel_H;
+/******************************************************************************
+function :	EPD_IT8951_Fill_Area
+parameter:  
+Info:
+    EPD_IT8951_Fill_Show where it can, other areas get Gray loaded as
+    4bpp and shown from the buffer, W a multiple of 4
+******************************************************************************/
+static void EPD_IT8951_Fill_Area(IT8951_Dev* Dev, UWORD X, UWORD Y, UWORD W, UWORD H, UBYTE Gray, UWORD Mode, UDOUBLE Target_Memory_Addr)
+{
+    if(EPD_IT8951_Fill_Show(Dev, X, Y, W, H, Gray, Mode, Target_Memory_Addr))
+        return;
+
+    EPD_IT8951_Fill_Load(Dev, X, Y, W, H, Gray, 4, Target_Memory_Addr);
+    EPD_IT8951_Stale_Clear(Dev, Target_Memory_Addr, X, Y, W, H, 4);
+
+    EPD_IT8951_Begin_Display(Dev, X, Y, W, H);
+    EPD_IT8951_Set_1bpp_Mode(Dev, false);
+    if(Target_Memory_Addr == 0)
+        EPD_IT8951_Display_Area(Dev, X, Y, W, H, Mode);
+    else
+        EPD_IT8951_Display_AreaBuf(Dev, X, Y, W, H, Mode, Target_Memory_Addr);
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Clear_Refresh
+parameter:  
+Info:
+    The whole panel to white, see EPD_IT8951_Fill_Area. When the panel
+    width suits the 1bpp mode no pixel is sent, the image buffer is
+    marked stale.
+******************************************************************************/
+UBYTE EPD_IT8951_Clear_Refresh(IT8951_Dev* Dev, UDOUBLE Target_Memory_Addr, UWORD Mode)
+{
+    EPD_IT8951_Enter(Dev);
+    EPD_IT8951_Wake(Dev);
 
-    EPD_IT8951_HostAreaPackedPixelWrite_4bp(&Load_Img_Info, &Area_Img_Info, false);
+    EPD_IT8951_Fill_Area(Dev, 0, 0, Dev->Info.Panel_W, Dev->Info.Panel_H, 0xF0, Mode, Target_Memory_Addr);
 
-    EPD_IT8951_Display_Area(0, 0, Dev_Info.Panel_W, Dev_Info.Panel_H, Mode);
+    return EPD_IT8951_Leave(Dev);
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Fill_Refresh
+parameter:  
+    Gray : 0x00 black .. 0xF0 white
+Info:
+    A solid area, see EPD_IT8951_Fill_Area for the alignment that keeps
+    it free of pixel data
+******************************************************************************/
+UBYTE EPD_IT8951_Fill_Refresh(IT8951_Dev* Dev, UWORD X, UWORD Y, UWORD W, UWORD H, UBYTE Gray, UWORD Mode, UDOUBLE Target_Memory_Addr)
+{
+    EPD_IT8951_Enter(Dev);
+    EPD_IT8951_Wake(Dev);
+    EPD_IT8951_Canvas_To_Panel(Dev, &X, &Y, &W, &H);
+
+    EPD_IT8951_Fill_Area(Dev, X, Y, W, H, Gray, Mode, Target_Memory_Addr);
 
-    free(Frame_Buf);
-    Frame_Buf = NULL;
+    return EPD_IT8951_Leave(Dev);
 }
 
 
@@ -729,15 +2739,19 @@ void EPD_IT8951_Clear_Refresh(IT8951_Dev_Info Dev_Info,UDOUBLE Target_Memory_Add
 function :	EPD_IT8951_1bp_Refresh
 parameter:
 ******************************************************************************/
-void EPD_IT8951_1bp_Refresh(UBYTE* Frame_Buf, UWORD X, UWORD Y, UWORD W, UWORD H, UBYTE Mode, UDOUBLE Target_Memory_Addr, bool Packed_Write)
+UBYTE EPD_IT8951_1bp_Refresh(IT8951_Dev* Dev, UBYTE* Frame_Buf, UWORD X, UWORD Y, UWORD W, UWORD H, UBYTE Mode, UDOUBLE Target_Memory_Addr, bool Packed_Write)
 {
+    EPD_IT8951_Enter(Dev);
+    EPD_IT8951_Wake(Dev);
+    EPD_IT8951_Canvas_To_Panel(Dev, &X, &Y, &W, &H);
+
     IT8951_Load_Img_Info Load_Img_Info;
     IT8951_Area_Img_Info Area_Img_Info;
 
-    EPD_IT8951_WaitForDisplayReady();
+    Target_Memory_Addr = EPD_IT8951_Begin_Upload(Dev, Target_Memory_Addr, X/8, Y, W/8, H);
 
     Load_Img_Info.Source_Buffer_Addr = Frame_Buf;
-    Load_Img_Info.Endian_Type = IT8951_LDIMG_L_ENDIAN;
+    Load_Img_Info.Endian_Type = Dev->Load_Endian_Type;
     //Use 8bpp to set 1bpp
     Load_Img_Info.Pixel_Format = IT8951_8BPP;
     Load_Img_Info.Rotate =  IT8951_ROTATE_0;
@@ -754,7 +2768,8 @@ void EPD_IT8951_1bp_Refresh(UBYTE* Frame_Buf, UWORD X, UWORD Y, UWORD W, UWORD H
 
     //start = clock();
 
-    EPD_IT8951_HostAreaPackedPixelWrite_1bp(&Load_Img_Info, &Area_Img_Info, Packed_Write);
+    EPD_IT8951_HostAreaPackedPixelWrite_1bp(Dev, &Load_Img_Info, &Area_Img_Info);
+    EPD_IT8951_Stale_Clear(Dev, Target_Memory_Addr, X, Y, W, H, 1);
 
     //finish = clock();
     //duration = (double)(finish - start) / CLOCKS_PER_SEC;
@@ -762,11 +2777,14 @@ void EPD_IT8951_1bp_Refresh(UBYTE* Frame_Buf, UWORD X, UWORD Y, UWORD W, UWORD H
 
     //start = clock();
 
-    EPD_IT8951_Display_1bp(X,Y,W,H,Mode,Target_Memory_Addr,0xF0,0x00);
+    EPD_IT8951_Begin_Display(Dev, X, Y, W, H);
+    EPD_IT8951_Display_1bp(Dev, X,Y,W,H,Mode,Target_Memory_Addr,0xF0,0x00);
 
     //finish = clock();
     //duration = (double)(finish - start) / CLOCKS_PER_SEC;
 	//Debug( "Show occupy %f second\n", duration );
+
+    return EPD_IT8951_Leave(Dev);
 }
 
 
@@ -775,15 +2793,19 @@ void EPD_IT8951_1bp_Refresh(UBYTE* Frame_Buf, UWORD X, UWORD Y, UWORD W, UWORD H
 function :	EPD_IT8951_1bp_Multi_Frame_Write
 parameter:  
 ******************************************************************************/
-void EPD_IT8951_1bp_Multi_Frame_Write(UBYTE* Frame_Buf, UWORD X, UWORD Y, UWORD W, UWORD H,UDOUBLE Target_Memory_Addr, bool Packed_Write)
+UBYTE EPD_IT8951_1bp_Multi_Frame_Write(IT8951_Dev* Dev, UBYTE* Frame_Buf, UWORD X, UWORD Y, UWORD W, UWORD H,UDOUBLE Target_Memory_Addr, bool Packed_Write)
 {
+    EPD_IT8951_Enter(Dev);
+    EPD_IT8951_Wake(Dev);
+    EPD_IT8951_Canvas_To_Panel(Dev, &X, &Y, &W, &H);
+
     IT8951_Load_Img_Info Load_Img_Info;
     IT8951_Area_Img_Info Area_Img_Info;
 
-    EPD_IT8951_WaitForDisplayReady();
+    EPD_IT8951_Claim_Memory(Dev, Target_Memory_Addr, X/8, Y, W/8, H);
 
     Load_Img_Info.Source_Buffer_Addr = Frame_Buf;
-    Load_Img_Info.Endian_Type = IT8951_LDIMG_L_ENDIAN;
+    Load_Img_Info.Endian_Type = Dev->Load_Endian_Type;
     //Use 8bpp to set 1bpp
     Load_Img_Info.Pixel_Format = IT8951_8BPP;
     Load_Img_Info.Rotate =  IT8951_ROTATE_0;
@@ -794,7 +2816,10 @@ void EPD_IT8951_1bp_Multi_Frame_Write(UBYTE* Frame_Buf, UWORD X, UWORD Y, UWORD
     Area_Img_Info.Area_W = W/8;
     Area_Img_Info.Area_H = H;
     
-    EPD_IT8951_HostAreaPackedPixelWrite_1bp(&Load_Img_Info, &Area_Img_Info,Packed_Write);
+    EPD_IT8951_HostAreaPackedPixelWrite_1bp(Dev, &Load_Img_Info, &Area_Img_Info);
+    EPD_IT8951_Stale_Clear(Dev, Target_Memory_Addr, X, Y, W, H, 1);
+
+    return EPD_IT8951_Leave(Dev);
 }
 
 
@@ -804,11 +2829,121 @@ void EPD_IT8951_1bp_Multi_Frame_Write(UBYTE* Frame_Buf, UWORD X, UWORD Y, UWORD
 function :	EPD_IT8951_1bp_Multi_Frame_Refresh
 parameter:  
 ******************************************************************************/
-void EPD_IT8951_1bp_Multi_Frame_Refresh(UWORD X, UWORD Y, UWORD W, UWORD H,UDOUBLE Target_Memory_Addr)
+UBYTE EPD_IT8951_1bp_Multi_Frame_Refresh(IT8951_Dev* Dev, UWORD X, UWORD Y, UWORD W, UWORD H,UDOUBLE Target_Memory_Addr)
+{
+    EPD_IT8951_Enter(Dev);
+    EPD_IT8951_Wake(Dev);
+    EPD_IT8951_Canvas_To_Panel(Dev, &X, &Y, &W, &H);
+    EPD_IT8951_Stale_Load(Dev, Target_Memory_Addr, X, Y, W, H, 1);
+
+    Dev->Display_Source.Mem_Addr = Target_Memory_Addr;
+    Dev->Display_Source.Mem_X = X/8;
+    Dev->Display_Source.Mem_Y = Y;
+    Dev->Display_Source.Mem_W = W/8;
+    Dev->Display_Source.Mem_H = H;
+    EPD_IT8951_Begin_Display(Dev, X, Y, W, H);
+
+    EPD_IT8951_Display_1bp(Dev, X,Y,W,H, Dev->A2_Mode,Target_Memory_Addr,0xF0,0x00);
+
+    return EPD_IT8951_Leave(Dev);
+}
+
+
+
+
+/******************************************************************************
+function :	EPD_IT8951_Area_Write
+parameter:  
+    Bits_Per_Pixel : 1, 2, 4 or 8, Frame_Buf laid out as for EPD_IT8951_<n>bp_Refresh
+Info:
+    Loads the area into Target_Memory_Addr without showing it, like
+    EPD_IT8951_1bp_Multi_Frame_Write for every format. A large frame can
+    be loaded as several horizontal stripes this way, the bus is free
+    between them. The pipeline is not used.
+******************************************************************************/
+UBYTE EPD_IT8951_Area_Write(IT8951_Dev* Dev, UBYTE Bits_Per_Pixel, UBYTE* Frame_Buf, UWORD X, UWORD Y, UWORD W, UWORD H, UDOUBLE Target_Memory_Addr)
+{
+    EPD_IT8951_Enter(Dev);
+    EPD_IT8951_Wake(Dev);
+    EPD_IT8951_Canvas_To_Panel(Dev, &X, &Y, &W, &H);
+
+    IT8951_Load_Img_Info Load_Img_Info;
+    IT8951_Area_Img_Info Area_Img_Info;
+
+    Load_Img_Info.Source_Buffer_Addr = Frame_Buf;
+    Load_Img_Info.Endian_Type = Dev->Load_Endian_Type;
+    Load_Img_Info.Rotate =  IT8951_ROTATE_0;
+    Load_Img_Info.Target_Memory_Addr = Target_Memory_Addr;
+
+    Area_Img_Info.Area_X = (Bits_Per_Pixel == 1) ? X/8 : X;
+    Area_Img_Info.Area_Y = Y;
+    Area_Img_Info.Area_W = (Bits_Per_Pixel == 1) ? W/8 : W;
+    Area_Img_Info.Area_H = H;
+
+    EPD_IT8951_Claim_Memory(Dev, Target_Memory_Addr, Area_Img_Info.Area_X, Y, Area_Img_Info.Area_W, H);
+
+    switch(Bits_Per_Pixel) {
+    case 1:
+        //Use 8bpp to set 1bpp
+        Load_Img_Info.Pixel_Format = IT8951_8BPP;
+        EPD_IT8951_HostAreaPackedPixelWrite_1bp(Dev, &Load_Img_Info, &Area_Img_Info);
+        break;
+    case 2:
+        Load_Img_Info.Pixel_Format = IT8951_2BPP;
+        EPD_IT8951_HostAreaPackedPixelWrite_2bp(Dev, &Load_Img_Info, &Area_Img_Info);
+        break;
+    case 4:
+        Load_Img_Info.Pixel_Format = IT8951_4BPP;
+        EPD_IT8951_HostAreaPackedPixelWrite_4bp(Dev, &Load_Img_Info, &Area_Img_Info);
+        break;
+    default:
+        Load_Img_Info.Pixel_Format = IT8951_8BPP;
+        EPD_IT8951_HostAreaPackedPixelWrite_8bp(Dev, &Load_Img_Info, &Area_Img_Info);
+        break;
+    }
+    EPD_IT8951_Stale_Clear(Dev, Target_Memory_Addr, X, Y, W, H, Bits_Per_Pixel);
+
+    return EPD_IT8951_Leave(Dev);
+}
+
+
+
+
+/******************************************************************************
+function :	EPD_IT8951_Area_Refresh
+parameter:  
+    Mode : waveform, A2_Mode for ink, GC16_Mode for the grayscale formats
+Info:
+    Shows an area loaded with EPD_IT8951_Area_Write
+******************************************************************************/
+UBYTE EPD_IT8951_Area_Refresh(IT8951_Dev* Dev, UBYTE Bits_Per_Pixel, UWORD X, UWORD Y, UWORD W, UWORD H, UBYTE Mode, UDOUBLE Target_Memory_Addr)
 {
-    EPD_IT8951_WaitForDisplayReady();
+    EPD_IT8951_Enter(Dev);
+    EPD_IT8951_Wake(Dev);
+    EPD_IT8951_Canvas_To_Panel(Dev, &X, &Y, &W, &H);
+    EPD_IT8951_Stale_Load(Dev, Target_Memory_Addr, X, Y, W, H, Bits_Per_Pixel);
+
+    Dev->Display_Source.Mem_Addr = Target_Memory_Addr;
+    Dev->Display_Source.Mem_X = (Bits_Per_Pixel == 1) ? X/8 : X;
+    Dev->Display_Source.Mem_Y = Y;
+    Dev->Display_Source.Mem_W = (Bits_Per_Pixel == 1) ? W/8 : W;
+    Dev->Display_Source.Mem_H = H;
+    EPD_IT8951_Begin_Display(Dev, X, Y, W, H);
+
+    if(Bits_Per_Pixel == 1)
+    {
+        EPD_IT8951_Display_1bp(Dev, X,Y,W,H, Mode,Target_Memory_Addr,0xF0,0x00);
+    }
+    else
+    {
+        EPD_IT8951_Set_1bpp_Mode(Dev, false);
+        if(Target_Memory_Addr == 0)
+            EPD_IT8951_Display_Area(Dev, X,Y,W,H, Mode);
+        else
+            EPD_IT8951_Display_AreaBuf(Dev, X,Y,W,H, Mode,Target_Memory_Addr);
+    }
 
-    EPD_IT8951_Display_1bp(X,Y,W,H, A2_Mode,Target_Memory_Addr,0xF0,0x00);
+    return EPD_IT8951_Leave(Dev);
 }
 
 
@@ -818,15 +2953,19 @@ void EPD_IT8951_1bp_Multi_Frame_Refresh(UWORD X, UWORD Y, UWORD W, UWORD H,UDOUB
 function :	EPD_IT8951_2bp_Refresh
 parameter:  
 ******************************************************************************/
-void EPD_IT8951_2bp_Refresh(UBYTE* Frame_Buf, UWORD X, UWORD Y, UWORD W, UWORD H, bool Hold, UDOUBLE Target_Memory_Addr, bool Packed_Write)
+UBYTE EPD_IT8951_2bp_Refresh(IT8951_Dev* Dev, UBYTE* Frame_Buf, UWORD X, UWORD Y, UWORD W, UWORD H, bool Hold, UDOUBLE Target_Memory_Addr, bool Packed_Write)
 {
+    EPD_IT8951_Enter(Dev);
+    EPD_IT8951_Wake(Dev);
+    EPD_IT8951_Canvas_To_Panel(Dev, &X, &Y, &W, &H);
+
     IT8951_Load_Img_Info Load_Img_Info;
     IT8951_Area_Img_Info Area_Img_Info;
 
-    EPD_IT8951_WaitForDisplayReady();
+    Target_Memory_Addr = EPD_IT8951_Begin_Upload(Dev, Target_Memory_Addr, X, Y, W, H);
 
     Load_Img_Info.Source_Buffer_Addr = Frame_Buf;
-    Load_Img_Info.Endian_Type = IT8951_LDIMG_L_ENDIAN;
+    Load_Img_Info.Endian_Type = Dev->Load_Endian_Type;
     Load_Img_Info.Pixel_Format = IT8951_2BPP;
     Load_Img_Info.Rotate =  IT8951_ROTATE_0;
     Load_Img_Info.Target_Memory_Addr = Target_Memory_Addr;
@@ -836,16 +2975,23 @@ void EPD_IT8951_2bp_Refresh(UBYTE* Frame_Buf, UWORD X, UWORD Y, UWORD W, UWORD H
     Area_Img_Info.Area_W = W;
     Area_Img_Info.Area_H = H;
 
-    EPD_IT8951_HostAreaPackedPixelWrite_2bp(&Load_Img_Info, &Area_Img_Info,Packed_Write);
+    EPD_IT8951_HostAreaPackedPixelWrite_2bp(Dev, &Load_Img_Info, &Area_Img_Info);
+    EPD_IT8951_Stale_Clear(Dev, Target_Memory_Addr, X, Y, W, H, 2);
 
-    if(Hold == true)
+    EPD_IT8951_Begin_Display(Dev, X, Y, W, H);
+    EPD_IT8951_Set_1bpp_Mode(Dev, false);
+
+    //a pipelined frame is never in the default buffer
+    if(Hold == true && Dev->Pipeline_Addr == 0)
     {
-        EPD_IT8951_Display_Area(X,Y,W,H, GC16_Mode);
+        EPD_IT8951_Display_Area(Dev, X,Y,W,H, Dev->GC16_Mode);
     }
     else
     {
-        EPD_IT8951_Display_AreaBuf(X,Y,W,H, GC16_Mode,Target_Memory_Addr);
+        EPD_IT8951_Display_AreaBuf(Dev, X,Y,W,H, Dev->GC16_Mode,Target_Memory_Addr);
     }
+
+    return EPD_IT8951_Leave(Dev);
 }
 
 
@@ -855,15 +3001,19 @@ void EPD_IT8951_2bp_Refresh(UBYTE* Frame_Buf, UWORD X, UWORD Y, UWORD W, UWORD H
 function :	EPD_IT8951_4bp_Refresh
 parameter:  
 ******************************************************************************/
-void EPD_IT8951_4bp_Refresh(UBYTE* Frame_Buf, UWORD X, UWORD Y, UWORD W, UWORD H, bool Hold, UDOUBLE Target_Memory_Addr, bool Packed_Write)
+UBYTE EPD_IT8951_4bp_Refresh(IT8951_Dev* Dev, UBYTE* Frame_Buf, UWORD X, UWORD Y, UWORD W, UWORD H, bool Hold, UDOUBLE Target_Memory_Addr, bool Packed_Write)
 {
+    EPD_IT8951_Enter(Dev);
+    EPD_IT8951_Wake(Dev);
+    EPD_IT8951_Canvas_To_Panel(Dev, &X, &Y, &W, &H);
+
     IT8951_Load_Img_Info Load_Img_Info;
     IT8951_Area_Img_Info Area_Img_Info;
 
-    EPD_IT8951_WaitForDisplayReady();
+    Target_Memory_Addr = EPD_IT8951_Begin_Upload(Dev, Target_Memory_Addr, X, Y, W, H);
 
     Load_Img_Info.Source_Buffer_Addr = Frame_Buf;
-    Load_Img_Info.Endian_Type = IT8951_LDIMG_L_ENDIAN;
+    Load_Img_Info.Endian_Type = Dev->Load_Endian_Type;
     Load_Img_Info.Pixel_Format = IT8951_4BPP;
     Load_Img_Info.Rotate =  IT8951_ROTATE_0;
     Load_Img_Info.Target_Memory_Addr = Target_Memory_Addr;
@@ -873,16 +3023,23 @@ void EPD_IT8951_4bp_Refresh(UBYTE* Frame_Buf, UWORD X, UWORD Y, UWORD W, UWORD H
     Area_Img_Info.Area_W = W;
     Area_Img_Info.Area_H = H;
 
-    EPD_IT8951_HostAreaPackedPixelWrite_4bp(&Load_Img_Info, &Area_Img_Info, Packed_Write);
+    EPD_IT8951_HostAreaPackedPixelWrite_4bp(Dev, &Load_Img_Info, &Area_Img_Info);
+    EPD_IT8951_Stale_Clear(Dev, Target_Memory_Addr, X, Y, W, H, 4);
+
+    EPD_IT8951_Begin_Display(Dev, X, Y, W, H);
+    EPD_IT8951_Set_1bpp_Mode(Dev, false);
 
-    if(Hold == true)
+    //a pipelined frame is never in the default buffer
+    if(Hold == true && Dev->Pipeline_Addr == 0)
     {
-        EPD_IT8951_Display_Area(X,Y,W,H, GC16_Mode);
+        EPD_IT8951_Display_Area(Dev, X,Y,W,H, Dev->GC16_Mode);
     }
     else
     {
-        EPD_IT8951_Display_AreaBuf(X,Y,W,H, GC16_Mode,Target_Memory_Addr);
+        EPD_IT8951_Display_AreaBuf(Dev, X,Y,W,H, Dev->GC16_Mode,Target_Memory_Addr);
     }
+
+    return EPD_IT8951_Leave(Dev);
 }
 
 
@@ -890,15 +3047,19 @@ void EPD_IT8951_4bp_Refresh(UBYTE* Frame_Buf, UWORD X, UWORD Y, UWORD W, UWORD H
 function :	EPD_IT8951_8bp_Refresh
 parameter:  
 ******************************************************************************/
-void EPD_IT8951_8bp_Refresh(UBYTE *Frame_Buf, UWORD X, UWORD Y, UWORD W, UWORD H, bool Hold, UDOUBLE Target_Memory_Addr)
+UBYTE EPD_IT8951_8bp_Refresh(IT8951_Dev* Dev, UBYTE *Frame_Buf, UWORD X, UWORD Y, UWORD W, UWORD H, bool Hold, UDOUBLE Target_Memory_Addr)
 {
+    EPD_IT8951_Enter(Dev);
+    EPD_IT8951_Wake(Dev);
+    EPD_IT8951_Canvas_To_Panel(Dev, &X, &Y, &W, &H);
+
     IT8951_Load_Img_Info Load_Img_Info;
     IT8951_Area_Img_Info Area_Img_Info;
 
-    EPD_IT8951_WaitForDisplayReady();
+    Target_Memory_Addr = EPD_IT8951_Begin_Upload(Dev, Target_Memory_Addr, X, Y, W, H);
 
     Load_Img_Info.Source_Buffer_Addr = Frame_Buf;
-    Load_Img_Info.Endian_Type = IT8951_LDIMG_L_ENDIAN;
+    Load_Img_Info.Endian_Type = Dev->Load_Endian_Type;
     Load_Img_Info.Pixel_Format = IT8951_8BPP;
     Load_Img_Info.Rotate =  IT8951_ROTATE_0;
     Load_Img_Info.Target_Memory_Addr = Target_Memory_Addr;
@@ -908,14 +3069,551 @@ void EPD_IT8951_8bp_Refresh(UBYTE *Frame_Buf, UWORD X, UWORD Y, UWORD W, UWORD H
     Area_Img_Info.Area_W = W;
     Area_Img_Info.Area_H = H;
 
-    EPD_IT8951_HostAreaPackedPixelWrite_8bp(&Load_Img_Info, &Area_Img_Info);
+    EPD_IT8951_HostAreaPackedPixelWrite_8bp(Dev, &Load_Img_Info, &Area_Img_Info);
+    EPD_IT8951_Stale_Clear(Dev, Target_Memory_Addr, X, Y, W, H, 8);
+
+    EPD_IT8951_Begin_Display(Dev, X, Y, W, H);
+    EPD_IT8951_Set_1bpp_Mode(Dev, false);
+
+    //a pipelined frame is never in the default buffer
+    if(Hold == true && Dev->Pipeline_Addr == 0)
+    {
+        EPD_IT8951_Display_Area(Dev, X, Y, W, H, Dev->GC16_Mode);
+    }
+    else
+    {
+        EPD_IT8951_Display_AreaBuf(Dev, X, Y, W, H, Dev->GC16_Mode, Target_Memory_Addr);
+    }
+
+    return EPD_IT8951_Leave(Dev);
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Broadcast_Match
+parameter:  
+Info:
+    Dev can take Lead's writes as they are: same geometry, orientation,
+    buffer layout and endian, and a different CS
+******************************************************************************/
+static bool EPD_IT8951_Broadcast_Match(IT8951_Dev* Lead, IT8951_Dev* Dev)
+{
+    return Dev->CS_Pin != Lead->CS_Pin
+        && Dev->Info.Panel_W == Lead->Info.Panel_W
+        && Dev->Info.Panel_H == Lead->Info.Panel_H
+        && Dev->Image_Pitch == Lead->Image_Pitch
+        && Dev->Load_Endian_Type == Lead->Load_Endian_Type
+        && Dev->Load_Rotate == Lead->Load_Rotate
+        && Dev->Load_Mirror == Lead->Load_Mirror;
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Broadcast_Group
+parameter:  
+    Group    : matching panels, locked and awake, Count 1 is a plain refresh
+    Frame_Buf : NULL loads white, see EPD_IT8951_Broadcast_Clear
+Info:
+    Everything that reads from a controller is done panel by panel: the
+    waits for its waveforms, the 1bpp registers, and the LUTAFSR read that
+    follows the display command. In between, the first panel that got
+    through carries the others as mirrors for LD_IMG_AREA, the pixels and
+    the display command, which then cross the bus once.
+******************************************************************************/
+static void EPD_IT8951_Broadcast_Group(IT8951_Dev** Group, UBYTE Count, UBYTE Bits_Per_Pixel, UBYTE* Frame_Buf, UWORD X, UWORD Y, UWORD W, UWORD H, UBYTE Mode, UDOUBLE Target_Memory_Addr)
+{
+    IT8951_Load_Img_Info Load_Img_Info;
+    IT8951_Area_Img_Info Area_Img_Info;
+    IT8951_Dev* Lead = NULL;
+    UDOUBLE Write_Hz = 0, Read_Hz = 0;
+    UWORD Args[7];
+    UWORD Mem_X = (Bits_Per_Pixel == 1) ? X/8 : X;
+    UWORD Mem_W = (Bits_Per_Pixel == 1) ? W/8 : W;
+
+    for(UBYTE i = 0; i < Count; i++)
+    {
+        IT8951_Dev* Dev = Group[i];
+
+        EPD_IT8951_Claim_Memory(Dev, Target_Memory_Addr, Mem_X, Y, Mem_W, H);
+        EPD_IT8951_Begin_Display(Dev, X, Y, W, H);
+        EPD_IT8951_Set_1bpp_Mode(Dev, Bits_Per_Pixel == 1);
+        if(Bits_Per_Pixel == 1)
+            EPD_IT8951_Write_Display_Reg(Dev, BGVR, 0x00F0);
+        if(Dev->Busy_Error != IT8951_OK)
+            continue;
+
+        //the slowest panel sets the clock
+        if(Dev->SPI_Write_Hz != 0 && (Write_Hz == 0 || Dev->SPI_Write_Hz < Write_Hz))
+            Write_Hz = Dev->SPI_Write_Hz;
+        if(Dev->SPI_Read_Hz != 0 && (Read_Hz == 0 || Dev->SPI_Read_Hz < Read_Hz))
+            Read_Hz = Dev->SPI_Read_Hz;
+
+        if(Lead == NULL)
+            Lead = Dev;
+        else
+            Lead->Mirror[Lead->Mirror_Count++] = Dev;
+    }
+    if(Lead == NULL)
+        return;
+
+    //the mirrors' LISAR may differ from ours, write it whatever the shadow says
+    Lead->Shadow_Reg[EPD_IT8951_Shadow_Slot(LISAR)].Valid = false;
+    Lead->Shadow_Reg[EPD_IT8951_Shadow_Slot(LISAR+2)].Valid = false;
+    Group[0] = Lead;
+    Write_Hz = (Lead->Mirror_Count != 0) ? Write_Hz : Lead->SPI_Write_Hz;
+    Read_Hz = (Lead->Mirror_Count != 0) ? Read_Hz : Lead->SPI_Read_Hz;
+    {
+        UDOUBLE Own_Write_Hz = Lead->SPI_Write_Hz, Own_Read_Hz = Lead->SPI_Read_Hz;
+
+        Lead->SPI_Write_Hz = Write_Hz;
+        Lead->SPI_Read_Hz = Read_Hz;
+
+        Load_Img_Info.Source_Buffer_Addr = Frame_Buf;
+        Load_Img_Info.Endian_Type = Lead->Load_Endian_Type;
+        Load_Img_Info.Rotate = IT8951_ROTATE_0;
+        Load_Img_Info.Target_Memory_Addr = Target_Memory_Addr;
+        Area_Img_Info.Area_X = Mem_X;
+        Area_Img_Info.Area_Y = Y;
+        Area_Img_Info.Area_W = Mem_W;
+        Area_Img_Info.Area_H = H;
+
+        if(Frame_Buf == NULL)
+            EPD_IT8951_Fill_Write(Lead, X, Y, W, H, 0xF0, Bits_Per_Pixel, Target_Memory_Addr);
+        else switch(Bits_Per_Pixel) {
+        case 1:
+            //Use 8bpp to set 1bpp
+            Load_Img_Info.Pixel_Format = IT8951_8BPP;
+            EPD_IT8951_HostAreaPackedPixelWrite_1bp(Lead, &Load_Img_Info, &Area_Img_Info);
+            break;
+        case 2:
+            Load_Img_Info.Pixel_Format = IT8951_2BPP;
+            EPD_IT8951_HostAreaPackedPixelWrite_2bp(Lead, &Load_Img_Info, &Area_Img_Info);
+            break;
+        case 4:
+            Load_Img_Info.Pixel_Format = IT8951_4BPP;
+            EPD_IT8951_HostAreaPackedPixelWrite_4bp(Lead, &Load_Img_Info, &Area_Img_Info);
+            break;
+        default:
+            Load_Img_Info.Pixel_Format = IT8951_8BPP;
+            EPD_IT8951_HostAreaPackedPixelWrite_8bp(Lead, &Load_Img_Info, &Area_Img_Info);
+            break;
+        }
+
+        Args[0] = X;
+        Args[1] = Y;
+        Args[2] = W;
+        Args[3] = H;
+        Args[4] = Mode;
+        Args[5] = (UWORD)Target_Memory_Addr;
+        Args[6] = (UWORD)(Target_Memory_Addr>>16);
+        if(Target_Memory_Addr == 0)
+            EPD_IT8951_WriteMultiArg(Lead, USDEF_I80_CMD_DPY_AREA, Args, 5);
+        else
+            EPD_IT8951_WriteMultiArg(Lead, USDEF_I80_CMD_DPY_BUF_AREA, Args, 7);
+
+        Lead->SPI_Write_Hz = Own_Write_Hz;
+        Lead->SPI_Read_Hz = Own_Read_Hz;
+    }
+
+    //back to one transaction per panel
+    for(UBYTE i = 0; i < Lead->Mirror_Count; i++)
+    {
+        IT8951_Dev* Dev = Lead->Mirror[i];
+
+        Dev->Busy_Error = Lead->Busy_Error;
+        //the shared transaction wrote LISAR only, the rest is still the mirror's own
+        if(Dev->Busy_Error == IT8951_OK) {
+            Dev->Shadow_Reg[EPD_IT8951_Shadow_Slot(LISAR)] = Lead->Shadow_Reg[EPD_IT8951_Shadow_Slot(LISAR)];
+            Dev->Shadow_Reg[EPD_IT8951_Shadow_Slot(LISAR+2)] = Lead->Shadow_Reg[EPD_IT8951_Shadow_Slot(LISAR+2)];
+        } else {
+            EPD_IT8951_Shadow_Invalidate(Dev);
+        }
+        EPD_IT8951_Region_Start(Dev, X, Y, W, H, Mode);
+    }
+    Lead->Mirror_Count = 0;
+    EPD_IT8951_Region_Start(Lead, X, Y, W, H, Mode);
+
+    for(UBYTE i = 0; i < Count; i++)
+        EPD_IT8951_Stale_Clear(Group[i], Target_Memory_Addr, X, Y, W, H, Bits_Per_Pixel);
+}
+
+
+/******************************************************************************
+function :	Broadcast prologue / epilogue
+parameter:  
+    Locked : receives Devs in the order they were locked
+Info:
+    Locks are taken in address order, two broadcasts cannot deadlock.
+    Leave returns the first error any panel saw.
+******************************************************************************/
+static void EPD_IT8951_Broadcast_Enter(IT8951_Dev** Devs, UBYTE Count, IT8951_Dev** Locked)
+{
+    memcpy(Locked, Devs, Count * sizeof(Locked[0]));
+    for(UBYTE i = 1; i < Count; i++)
+    {
+        for(UBYTE j = i; j > 0 && Locked[j] < Locked[j-1]; j--)
+        {
+            IT8951_Dev* Swap = Locked[j];
+            Locked[j] = Locked[j-1];
+            Locked[j-1] = Swap;
+        }
+    }
+    for(UBYTE i = 0; i < Count; i++)
+    {
+        if(i > 0 && Locked[i] == Locked[i-1])
+            continue;
+        EPD_IT8951_Enter(Locked[i]);
+        EPD_IT8951_Wake(Locked[i]);
+    }
+}
+
+static UBYTE EPD_IT8951_Broadcast_Leave(IT8951_Dev** Locked, UBYTE Count)
+{
+    UBYTE Status = IT8951_OK;
+
+    for(UBYTE i = Count; i > 0; i--)
+    {
+        if(i < Count && Locked[i-1] == Locked[i])
+            continue;
+        if(Status == IT8951_OK)
+            Status = Locked[i-1]->Busy_Error;
+        EPD_IT8951_Leave(Locked[i-1]);
+    }
+    return Status;
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Broadcast_Refresh
+parameter:  
+    Devs           : panels that show the same picture, up to IT8951_BROADCAST_MAX
+    Bits_Per_Pixel : 1, 2, 4 or 8, laid out as for EPD_IT8951_<n>bp_Refresh
+    Mode           : waveform for all of them, their mode numbers have to agree
+Info:
+    Panels with the same geometry are loaded in one transfer with their
+    chip selects asserted together; a panel that does not match is
+    refreshed on its own. The frame always goes to Target_Memory_Addr,
+    pipelining is not used. Returns the first error any panel saw, each
+    panel's own is left for EPD_IT8951_Get_Error.
+******************************************************************************/
+UBYTE EPD_IT8951_Broadcast_Refresh(IT8951_Dev** Devs, UBYTE Count, UBYTE Bits_Per_Pixel, UBYTE* Frame_Buf, UWORD X, UWORD Y, UWORD W, UWORD H, UBYTE Mode, UDOUBLE Target_Memory_Addr)
+{
+    IT8951_Dev* Locked[IT8951_BROADCAST_MAX];
+    IT8951_Dev* Group[IT8951_BROADCAST_MAX];
+    bool Done[IT8951_BROADCAST_MAX] = {false};
+
+    if(Count == 0 || Count > IT8951_BROADCAST_MAX)
+        return IT8951_ERR_NOT_RUNNING;
+    EPD_IT8951_Broadcast_Enter(Devs, Count, Locked);
+
+    for(UBYTE i = 0; i < Count; i++)
+    {
+        UBYTE Group_Count = 0;
+        UWORD Panel_X = X, Panel_Y = Y, Panel_W = W, Panel_H = H;
+
+        if(Done[i])
+            continue;
+        for(UBYTE j = i; j < Count; j++)
+        {
+            if(!Done[j] && (j == i || EPD_IT8951_Broadcast_Match(Devs[i], Devs[j]))) {
+                Group[Group_Count++] = Devs[j];
+                Done[j] = true;
+            }
+        }
+        EPD_IT8951_Canvas_To_Panel(Devs[i], &Panel_X, &Panel_Y, &Panel_W, &Panel_H);
+        EPD_IT8951_Broadcast_Group(Group, Group_Count, Bits_Per_Pixel, Frame_Buf, Panel_X, Panel_Y, Panel_W, Panel_H, Mode, Target_Memory_Addr);
+    }
+
+    return EPD_IT8951_Broadcast_Leave(Locked, Count);
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Broadcast_Clear
+parameter:  
+Info:
+    EPD_IT8951_Clear_Refresh on all of Devs. Where the panel width suits
+    the 1bpp mode a clear sends no pixels, each panel gets its own BGVR
+    and display command, see EPD_IT8951_Fill_Show. The panels that need
+    white in their buffer get it in one transfer per matching group,
+    like EPD_IT8951_Broadcast_Refresh.
+******************************************************************************/
+UBYTE EPD_IT8951_Broadcast_Clear(IT8951_Dev** Devs, UBYTE Count, UDOUBLE Target_Memory_Addr, UWORD Mode)
+{
+    IT8951_Dev* Locked[IT8951_BROADCAST_MAX];
+    IT8951_Dev* Group[IT8951_BROADCAST_MAX];
+    bool Done[IT8951_BROADCAST_MAX] = {false};
+
+    if(Count == 0 || Count > IT8951_BROADCAST_MAX)
+        return IT8951_ERR_NOT_RUNNING;
+    EPD_IT8951_Broadcast_Enter(Devs, Count, Locked);
 
-    if(Hold == true)
+    for(UBYTE i = 0; i < Count; i++)
+        Done[i] = EPD_IT8951_Fill_Show(Devs[i], 0, 0, Devs[i]->Info.Panel_W, Devs[i]->Info.Panel_H, 0xF0, Mode, Target_Memory_Addr);
+
+    for(UBYTE i = 0; i < Count; i++)
     {
-        EPD_IT8951_Display_Area(X, Y, W, H, GC16_Mode);
+        UBYTE Group_Count = 0;
+
+        if(Done[i])
+            continue;
+        for(UBYTE j = i; j < Count; j++)
+        {
+            if(!Done[j] && (j == i || EPD_IT8951_Broadcast_Match(Devs[i], Devs[j]))) {
+                Group[Group_Count++] = Devs[j];
+                Done[j] = true;
+            }
+        }
+        EPD_IT8951_Broadcast_Group(Group, Group_Count, 4, NULL, 0, 0, Devs[i]->Info.Panel_W, Devs[i]->Info.Panel_H, Mode, Target_Memory_Addr);
+    }
+
+    return EPD_IT8951_Broadcast_Leave(Locked, Count);
+}
+
+
+
+
+/******************************************************************************
+function :	EPD_IT8951_Record_Start
+parameter:  
+    Rec : zeroed, or used before; its buffer is reused
+Info:
+    From here on the transfers made for this handle also go into Rec,
+    what the controller does with them is unchanged, so a stream can be
+    made on the fake bus as well. The register cache is emptied first so
+    every register the stream relies on is written by it. Waits for the
+    LUT and the display commands are kept as such, see EPD_IT8951_Replay.
+    A broadcast is recorded as the stream of its lead panel.
+******************************************************************************/
+UBYTE EPD_IT8951_Record_Start(IT8951_Dev* Dev, IT8951_Recording* Rec)
+{
+    UBYTE* Header;
+
+    EPD_IT8951_Enter(Dev);
+
+    if(Dev->Recording != NULL) {
+        Dev->Busy_Error = IT8951_ERR_RECORDING;
+        return EPD_IT8951_Leave(Dev);
     }
+
+    Rec->Len = 0;
+    Rec->Error = IT8951_OK;
+    Dev->Recording = Rec;
+    Dev->Record_Hold = 0;
+
+    Header = EPD_IT8951_Record_Grow(Dev, IT8951_RECORD_HEADER);
+    if(Header != NULL) {
+        memcpy(Header, Record_Magic, sizeof(Record_Magic));
+        EPD_IT8951_Put16(Header + 4, IT8951_RECORD_VERSION);
+        EPD_IT8951_Put16(Header + 6, Dev->Info.Panel_W);
+        EPD_IT8951_Put16(Header + 8, Dev->Info.Panel_H);
+        EPD_IT8951_Put16(Header + 10, Dev->Image_Pitch);
+    }
+    EPD_IT8951_Shadow_Invalidate(Dev);
+
+    return EPD_IT8951_Leave(Dev);
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Record_Stop
+parameter:  
+Info:
+    Detaches the recording, return IT8951_OK when it holds every transfer
+    made since EPD_IT8951_Record_Start
+******************************************************************************/
+UBYTE EPD_IT8951_Record_Stop(IT8951_Dev* Dev)
+{
+    IT8951_Recording* Rec;
+
+    EPD_IT8951_Enter(Dev);
+
+    Rec = Dev->Recording;
+    Dev->Recording = NULL;
+    if(Rec == NULL)
+        Dev->Busy_Error = IT8951_ERR_RECORDING;
     else
+        Dev->Busy_Error = Rec->Error;
+
+    return EPD_IT8951_Leave(Dev);
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Replay
+parameter:  
+    Rec : made by EPD_IT8951_Record_Start on a panel of the same size
+Info:
+    Sends the recorded words as they are, data straight from Rec, with
+    HRDY checked between transfers like any other call. A recorded LUT
+    wait waits for what runs now, display commands are tracked so the
+    waits and the calls after the replay see them. Stale areas are loaded
+    before the stream starts. A read longer than an 8bpp frame of the
+    panel is taken for a damaged stream.
+******************************************************************************/
+UBYTE EPD_IT8951_Replay(IT8951_Dev* Dev, IT8951_Recording* Rec)
+{
+    const UBYTE* Data = Rec->Data;
+    UDOUBLE Pos = IT8951_RECORD_HEADER, Length, Max_Read;
+    IT8951_Region Area;
+    UWORD* Scratch;
+    UBYTE Op;
+
+    EPD_IT8951_Enter(Dev);
+    //no read the recorder makes is larger than an 8bpp frame
+    Max_Read = (UDOUBLE)Dev->Image_Pitch * Dev->Info.Panel_H / 2;
+
+    if(Rec->Len < IT8951_RECORD_HEADER
+       || memcmp(Data, Record_Magic, sizeof(Record_Magic)) != 0
+       || EPD_IT8951_Get16(Data + 4) != IT8951_RECORD_VERSION
+       || EPD_IT8951_Get16(Data + 6) != Dev->Info.Panel_W
+       || EPD_IT8951_Get16(Data + 8) != Dev->Info.Panel_H
+       || EPD_IT8951_Get16(Data + 10) != Dev->Image_Pitch) {
+        Debug("Replay: not a recording for this panel\r\n");
+        Dev->Busy_Error = IT8951_ERR_RECORDING;
+        return EPD_IT8951_Leave(Dev);
+    }
+
+    EPD_IT8951_Wake(Dev);
+    //the stream knows nothing of this panel's stale areas
+    EPD_IT8951_Stale_Flush(Dev);
+
+    while(Pos < Rec->Len && Dev->Busy_Error == IT8951_OK)
     {
-        EPD_IT8951_Display_AreaBuf(X, Y, W, H, GC16_Mode, Target_Memory_Addr);
+        Op = Data[Pos++];
+        switch(Op) {
+        case IT8951_OP_CMD:
+            if(Rec->Len - Pos < 2)
+                break;
+            EPD_IT8951_WriteCommand(Dev, EPD_IT8951_Get16(Data + Pos));
+            Pos += 2;
+            continue;
+        case IT8951_OP_DATA:
+            if(Rec->Len - Pos < 4)
+                break;
+            Length = EPD_IT8951_Get32(Data + Pos);
+            Pos += 4;
+            if(Length == 0 || (Rec->Len - Pos) / 2 < Length)
+                break;
+            EPD_IT8951_WriteMultiByte(Dev, Rec->Data + Pos, Length*2);
+            Pos += Length*2;
+            continue;
+        case IT8951_OP_READ:
+            if(Rec->Len - Pos < 4)
+                break;
+            Length = EPD_IT8951_Get32(Data + Pos);
+            Pos += 4;
+            if(Length <= 1) {
+                EPD_IT8951_ReadData(Dev);
+                continue;
+            }
+            if(Length > Max_Read || Length > SIZE_MAX / 2
+               || (Scratch = (UWORD*)malloc((size_t)Length * 2)) == NULL)
+                break;
+            EPD_IT8951_ReadMultiData(Dev, Scratch, Length);
+            free(Scratch);
+            continue;
+        case IT8951_OP_WAIT:
+            if(Rec->Len - Pos < 1 + IT8951_RECORD_AREA)
+                break;
+            EPD_IT8951_Get_Area(Data + Pos + 1, &Area);
+            if(Data[Pos] == IT8951_MATCH_PANEL)
+                EPD_IT8951_Wait_Regions(Dev, EPD_IT8951_Match_Panel, &Area);
+            else if(Data[Pos] == IT8951_MATCH_MEMORY)
+                EPD_IT8951_Wait_Regions(Dev, EPD_IT8951_Match_Memory, &Area);
+            else
+                EPD_IT8951_WaitForDisplayReady(Dev);
+            Pos += 1 + IT8951_RECORD_AREA;
+            continue;
+        case IT8951_OP_REGION:
+            if(Rec->Len - Pos < 1 + IT8951_RECORD_AREA)
+                break;
+            EPD_IT8951_Get_Area(Data + Pos + 1, &Area);
+            Dev->Display_Source = Area;
+            EPD_IT8951_Reserve_Region(Dev);
+            EPD_IT8951_Region_Start(Dev, Area.X, Area.Y, Area.W, Area.H, Area.Mode);
+            Pos += 1 + IT8951_RECORD_AREA;
+            continue;
+        }
+        Debug("Replay: bad op %d at %d\r\n", Op, Pos - 1);
+        Dev->Busy_Error = IT8951_ERR_RECORDING;
+    }
+
+    //the stream wrote registers behind the cache
+    EPD_IT8951_Shadow_Invalidate(Dev);
+
+    return EPD_IT8951_Leave(Dev);
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Recording_Save / _Load / _Free
+parameter:  
+Info:
+    The file is the stream as it is. Save and Load return 0, or 1 when
+    the file cannot be written or is not a recording; Load replaces what
+    Rec held.
+******************************************************************************/
+UBYTE EPD_IT8951_Recording_Save(const IT8951_Recording* Rec, const char* Path)
+{
+    FILE* File;
+
+    if(Rec->Error != IT8951_OK || Rec->Len < IT8951_RECORD_HEADER)
+        return 1;
+
+    File = fopen(Path, "wb");
+    if(File == NULL) {
+        Debug("Recording: cannot write %s\r\n", Path);
+        return 1;
+    }
+    if(fwrite(Rec->Data, 1, Rec->Len, File) != Rec->Len) {
+        fclose(File);
+        remove(Path);
+        return 1;
+    }
+    if(fclose(File) != 0) {
+        remove(Path);
+        return 1;
+    }
+    return 0;
+}
+
+UBYTE EPD_IT8951_Recording_Load(IT8951_Recording* Rec, const char* Path)
+{
+    FILE* File;
+    long Size;
+
+    File = fopen(Path, "rb");
+    if(File == NULL)
+        return 1;
+
+    if(fseek(File, 0, SEEK_END) != 0 || (Size = ftell(File)) < IT8951_RECORD_HEADER
+       || fseek(File, 0, SEEK_SET) != 0) {
+        fclose(File);
+        return 1;
+    }
+
+    EPD_IT8951_Recording_Free(Rec);
+    if((Rec->Data = (UBYTE*)malloc(Size)) == NULL) {
+        fclose(File);
+        return 1;
+    }
+    Rec->Size = Size;
+    Rec->Len = fread(Rec->Data, 1, Size, File);
+    fclose(File);
+
+    if(Rec->Len != (UDOUBLE)Size || memcmp(Rec->Data, Record_Magic, sizeof(Record_Magic)) != 0) {
+        EPD_IT8951_Recording_Free(Rec);
+        return 1;
     }
+    return 0;
+}
+
+void EPD_IT8951_Recording_Free(IT8951_Recording* Rec)
+{
+    free(Rec->Data);
+    Rec->Data = NULL;
+    Rec->Len = 0;
+    Rec->Size = 0;
+    Rec->Error = IT8951_OK;
 }
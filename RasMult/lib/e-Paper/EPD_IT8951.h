@@ -32,18 +32,11 @@
 #define __EPD_IT8951_H_
 
 #include <stdbool.h>
+#include <pthread.h>
 
 #include "../Config/DEV_Config.h"
 
 
-// INIT mode, for every init or some time after A2 mode refresh
-extern UBYTE INIT_Mode;
-// GC16 mode, for every time to display 16 grayscale image
-extern UBYTE GC16_Mode;
-// A2 mode, for fast refresh without flash
-extern UBYTE A2_Mode;
-
-
 typedef struct IT8951_Load_Img_Info
 {
     UWORD    Endian_Type;         //little or Big Endian
@@ -97,6 +90,176 @@ IT8951 Command defines
 #define USDEF_I80_CMD_DPY_BUF_AREA 0x0037
 #define USDEF_I80_CMD_VCOM		   0x0039
 
+//Bytes handed to the SPI layer per call during bulk transfers
+#define IT8951_SPI_CHUNK_SIZE      4096
+
+//Default wait limits, HRDY between transfers and LUTAFSR after a display
+#define IT8951_BUSY_TIMEOUT_MS     3000
+#define IT8951_DISPLAY_TIMEOUT_MS  10000
+
+//Reset pulse, then time before HRDY is trusted to reflect the boot
+#define IT8951_RESET_PULSE_MS      10
+#define IT8951_RESET_SETTLE_MS     20
+//EPD_IT8951_Attach gives a running controller this long to show HRDY
+#define IT8951_ATTACH_TIMEOUT_MS   50
+
+//LUT completion wait, see EPD_IT8951_WaitForDisplayReady
+#define IT8951_LUT_MODES           16      //waveform modes with their own model
+#define IT8951_LUT_GUARD           0.85    //part of the predicted time slept without polling
+#define IT8951_LUT_DECAY           0.9     //weight kept by older observations
+#define IT8951_LUT_POLL_MIN_US     500
+#define IT8951_LUT_POLL_MAX_US     16000
+#define IT8951_MAX_REGIONS         16      //display commands tracked in flight, one per LUTAFSR bit
+#define IT8951_MAX_STALE           8       //buffer areas left unwritten by data-free fills
+
+//Registers kept in the host side shadow cache
+#define IT8951_SHADOW_REGS         6
+
+//Panels one EPD_IT8951_Broadcast_Refresh can load in a single transfer
+#define IT8951_BROADCAST_MAX       3
+
+//Registers seen through the memory burst commands start here
+#define IT8951_REG_MEM_BASE        0x18000000
+
+//Status returned by the public calls
+#define IT8951_OK                  0
+#define IT8951_ERR_BUSY_TIMEOUT    1
+#define IT8951_ERR_LUT_TIMEOUT     2
+#define IT8951_ERR_NOT_RUNNING     3   //EPD_IT8951_Attach found a reset controller
+#define IT8951_ERR_RECORDING       4   //recording incomplete, damaged or made on another panel
+#define IT8951_ERR_AREA            5   //area the orientation cannot load, see EPD_IT8951_Set_Orientation
+#define IT8951_ERR_NO_MEMORY       6   //no room for the turned copy of an area
+
+//Power states, see EPD_IT8951_Get_Power_State
+#define IT8951_POWER_RUN           0
+#define IT8951_POWER_STANDBY       1
+#define IT8951_POWER_SLEEP         2
+#define IT8951_POWER_STATES        3
+
+//Idle time before EPD_IT8951_Power_Poll puts the controller into each state, 0 never
+#define IT8951_STANDBY_IDLE_MS     2000
+#define IT8951_SLEEP_IDLE_MS       30000
+
+//waveform duration model per mode, time in us against area in Mpixel,
+//sums are exponentially decayed so the fit follows temperature drift
+typedef struct {
+    double Weight;
+    double Sum_A;
+    double Sum_T;
+    double Sum_AA;
+    double Sum_AT;
+} IT8951_LUT_Model;
+
+//a display command whose waveform may still run, see EPD_IT8951_Wait_Regions
+typedef struct {
+    bool Active;
+    UWORD X, Y, W, H;                   //panel area
+    UDOUBLE Mem_Addr;                   //buffer and area the pixels come from
+    UWORD Mem_X, Mem_Y, Mem_W, Mem_H;
+    UWORD Mode;
+    UWORD Engine_Mask;                  //its LUTAFSR bits, 0 when not known
+    uint64_t Start_us;
+    uint64_t Last_Busy_us;              //last poll that saw it running, 0 none
+} IT8951_Region;
+
+//buffer area a data-free fill did not write, it still holds what was
+//there before the fill; see EPD_IT8951_Fill_Area
+typedef struct {
+    bool Active;
+    UDOUBLE Mem_Addr;
+    UWORD X, Y, W, H;                   //panel area
+    UBYTE Gray;                         //what the panel shows there
+} IT8951_Stale;
+
+//command stream captured by EPD_IT8951_Record_Start, a header and then
+//one op after another, see EPD_IT8951_Replay
+typedef struct IT8951_Recording {
+    UBYTE* Data;
+    UDOUBLE Len;
+    UDOUBLE Size;                       //allocated
+    UBYTE Error;                        //first error met while recording
+} IT8951_Recording;
+
+/*-----------------------------------------------------------------------
+ One controller and its panel. Set up with EPD_IT8951_Open, then every
+ EPD_IT8951_* call takes it first. Calls on the same handle are
+ serialized by Lock, calls on different handles only share the SPI bus
+ for the length of a transaction.
+------------------------------------------------------------------------*/
+typedef struct IT8951_Dev
+{
+    UWORD CS_Pin;
+    UWORD Busy_Pin;
+    UWORD Rst_Pin;
+
+    //waveform modes, A2_Mode's value is not fixed, is decided by the firmware's LUT
+    UBYTE INIT_Mode;    //for every init or some time after A2 mode refresh
+    UBYTE GC16_Mode;    //for every time to display 16 grayscale image
+    UBYTE A2_Mode;      //for fast refresh without flash
+
+    //SPI clock while this panel has the bus, 0 leaves it as it is
+    UDOUBLE SPI_Write_Hz;
+    UDOUBLE SPI_Read_Hz;
+
+    IT8951_Dev_Info Info;           //as read by EPD_IT8951_Init or given to _Attach
+    UWORD Image_Pitch;              //pitch of the controller image buffers
+    bool Four_Byte_Align;           //panel wants X and W in multiples of 32 pixels
+
+    pthread_mutex_t Lock;           //recursive
+
+    //panels that take the same writes while a broadcast runs, their CS
+    //follows ours and their HRDY is waited for too; no reads meanwhile
+    struct IT8951_Dev* Mirror[IT8951_BROADCAST_MAX - 1];
+    UBYTE Mirror_Count;
+
+    //endian used by every LD_IMG, big endian lets frame buffers go out untouched
+    UWORD Load_Endian_Type;
+
+    //how frame buffers are turned onto the panel, see EPD_IT8951_Set_Orientation
+    UBYTE Load_Rotate;
+    bool Load_Mirror;
+
+    //HRDY and LUT wait limits, see EPD_IT8951_Set_Busy_Timeout
+    UDOUBLE Busy_Timeout_ms;
+    UDOUBLE Display_Timeout_ms;
+
+    //sticky until the next public call, once set no further bus traffic is made
+    UBYTE Busy_Error;
+
+    //write-through copy of the registers only the host changes
+    struct {
+        UWORD Value;
+        bool Valid;
+    } Shadow_Reg[IT8951_SHADOW_REGS];
+
+    //second controller image buffer for pipelined refreshes, 0 when off,
+    //Pipeline_Next picks the buffer the next frame is loaded into
+    UDOUBLE Pipeline_Addr;
+    UBYTE Pipeline_Next;
+
+    IT8951_LUT_Model LUT_Model[IT8951_LUT_MODES];
+    IT8951_Region Region[IT8951_MAX_REGIONS];
+    IT8951_Region Display_Source;   //pixels of the next display command
+    IT8951_Stale Stale[IT8951_MAX_STALE];   //oldest first
+
+    //what the controller was last told, and how long SYS_RUN took to bring
+    //it back from each state, see EPD_IT8951_Wake
+    UBYTE Power_State;
+    UDOUBLE Wake_us[IT8951_POWER_STATES];
+    uint64_t Last_Access_us;
+
+    //idle power manager, see EPD_IT8951_Power_Poll; the last hint keeps
+    //the controller up like an update
+    UDOUBLE Standby_Idle_ms;
+    UDOUBLE Sleep_Idle_ms;
+    uint64_t Last_Hint_us;
+
+    //stream capture, see EPD_IT8951_Record_Start; LUTAFSR polls made
+    //while Record_Hold is set are left out of it
+    IT8951_Recording* Recording;
+    UBYTE Record_Hold;
+}IT8951_Dev;
+
 /*-----------------------------------------------------------------------
  IT8951 Mode defines
 ------------------------------------------------------------------------*/
@@ -182,27 +345,73 @@ void EPD_IT8951_Display_AreaBuf(UWORD X,UWORD Y,UWORD W,UWORD H,UWORD Mode, UDOU
 void EPD_IT8951_Display_1bp(UWORD X, UWORD Y, UWORD W, UWORD H, UWORD Mode,UDOUBLE Target_Memory_Addr, UBYTE Front_Gray_Val, UBYTE Back_Gray_Val);
 */
 
-void Enhance_Driving_Capability(void);
+UBYTE EPD_IT8951_Open(IT8951_Dev* Dev, const DEV_PINS* Pins);
+void EPD_IT8951_Close(IT8951_Dev* Dev);
+
+void Enhance_Driving_Capability(IT8951_Dev* Dev);
+
+UBYTE EPD_IT8951_SystemRun(IT8951_Dev* Dev);
+
+UBYTE EPD_IT8951_Standby(IT8951_Dev* Dev);
+
+UBYTE EPD_IT8951_Sleep(IT8951_Dev* Dev);
+
+IT8951_Dev_Info EPD_IT8951_Init(IT8951_Dev* Dev, UWORD VCOM);
+UBYTE EPD_IT8951_Attach(IT8951_Dev* Dev, IT8951_Dev_Info Dev_Info, UWORD VCOM);
+
+void EPD_IT8951_Set_Load_Endian(IT8951_Dev* Dev, UWORD Endian_Type);
+
+void EPD_IT8951_Set_Orientation(IT8951_Dev* Dev, UBYTE Rotate, bool Mirror);
+void EPD_IT8951_Get_Canvas_Size(IT8951_Dev* Dev, UWORD* W, UWORD* H);
+void EPD_IT8951_Map_Area(IT8951_Dev* Dev, UWORD* X, UWORD* Y, UWORD* W, UWORD* H);
+
+void EPD_IT8951_Set_Pipeline(IT8951_Dev* Dev, UDOUBLE Second_Memory_Addr);
+
+void EPD_IT8951_Set_Busy_Timeout(IT8951_Dev* Dev, UDOUBLE Busy_ms, UDOUBLE Display_ms);
+void EPD_IT8951_Get_Busy_Timeout(IT8951_Dev* Dev, UDOUBLE* Busy_ms, UDOUBLE* Display_ms);
+UBYTE EPD_IT8951_Get_Error(IT8951_Dev* Dev);
+UDOUBLE EPD_IT8951_Predict_Display_us(IT8951_Dev* Dev, UWORD Mode, UDOUBLE Pixels);
+void EPD_IT8951_Invalidate_Reg_Cache(IT8951_Dev* Dev);
+UWORD EPD_IT8951_Read_Reg(IT8951_Dev* Dev, UWORD Reg_Address);
+UBYTE EPD_IT8951_Write_Reg(IT8951_Dev* Dev, UWORD Reg_Address, UWORD Reg_Value);
+UBYTE EPD_IT8951_Get_Active_Regions(IT8951_Dev* Dev);
+UBYTE EPD_IT8951_Wait_Display(IT8951_Dev* Dev);
+bool EPD_IT8951_Area_Busy(IT8951_Dev* Dev, UWORD X, UWORD Y, UWORD W, UWORD H);
+UBYTE EPD_IT8951_Get_Power_State(IT8951_Dev* Dev);
+UDOUBLE EPD_IT8951_Get_Wake_us(IT8951_Dev* Dev, UBYTE State);
+UDOUBLE EPD_IT8951_Get_Idle_ms(IT8951_Dev* Dev);
 
-void EPD_IT8951_SystemRun(void);
+UBYTE EPD_IT8951_Mem_Burst_Write(IT8951_Dev* Dev, UDOUBLE Mem_Addr, UWORD* Data_Buf, UDOUBLE Word_Count);
+UBYTE EPD_IT8951_Mem_Burst_Read(IT8951_Dev* Dev, UDOUBLE Mem_Addr, UWORD* Data_Buf, UDOUBLE Word_Count);
+UBYTE EPD_IT8951_Mem_Copy(IT8951_Dev* Dev, UDOUBLE Dst_Addr, UDOUBLE Src_Addr, UDOUBLE Byte_Count);
 
-void EPD_IT8951_Standby(void);
+UBYTE EPD_IT8951_Clear_Refresh(IT8951_Dev* Dev, UDOUBLE Target_Memory_Addr, UWORD Mode);
+UBYTE EPD_IT8951_Fill_Refresh(IT8951_Dev* Dev, UWORD X, UWORD Y, UWORD W, UWORD H, UBYTE Gray, UWORD Mode, UDOUBLE Target_Memory_Addr);
 
-void EPD_IT8951_Sleep(void);
+//Packed_Write does nothing: EPD_IT8951_Init always enables pack mode (I80CPCR),
+//every load streams its area in one transaction
+UBYTE EPD_IT8951_1bp_Refresh(IT8951_Dev* Dev, UBYTE* Frame_Buf, UWORD X, UWORD Y, UWORD W, UWORD H, UBYTE Mode, UDOUBLE Target_Memory_Addr, bool Packed_Write);
+UBYTE EPD_IT8951_1bp_Multi_Frame_Write(IT8951_Dev* Dev, UBYTE* Frame_Buf, UWORD X, UWORD Y, UWORD W, UWORD H,UDOUBLE Target_Memory_Addr, bool Packed_Write);
+UBYTE EPD_IT8951_1bp_Multi_Frame_Refresh(IT8951_Dev* Dev, UWORD X, UWORD Y, UWORD W, UWORD H,UDOUBLE Target_Memory_Addr);
 
-IT8951_Dev_Info EPD_IT8951_Init(UWORD VCOM);
+UBYTE EPD_IT8951_Area_Write(IT8951_Dev* Dev, UBYTE Bits_Per_Pixel, UBYTE* Frame_Buf, UWORD X, UWORD Y, UWORD W, UWORD H, UDOUBLE Target_Memory_Addr);
+UBYTE EPD_IT8951_Area_Refresh(IT8951_Dev* Dev, UBYTE Bits_Per_Pixel, UWORD X, UWORD Y, UWORD W, UWORD H, UBYTE Mode, UDOUBLE Target_Memory_Addr);
 
-void EPD_IT8951_Clear_Refresh(IT8951_Dev_Info Dev_Info,UDOUBLE Target_Memory_Addr, UWORD Mode);
+UBYTE EPD_IT8951_2bp_Refresh(IT8951_Dev* Dev, UBYTE* Frame_Buf, UWORD X, UWORD Y, UWORD W, UWORD H, bool Hold, UDOUBLE Target_Memory_Addr, bool Packed_Write);
 
-void EPD_IT8951_1bp_Refresh(UBYTE* Frame_Buf, UWORD X, UWORD Y, UWORD W, UWORD H, UBYTE Mode, UDOUBLE Target_Memory_Addr, bool Packed_Write);
-void EPD_IT8951_1bp_Multi_Frame_Write(UBYTE* Frame_Buf, UWORD X, UWORD Y, UWORD W, UWORD H,UDOUBLE Target_Memory_Addr, bool Packed_Write);
-void EPD_IT8951_1bp_Multi_Frame_Refresh(UWORD X, UWORD Y, UWORD W, UWORD H,UDOUBLE Target_Memory_Addr);
+UBYTE EPD_IT8951_4bp_Refresh(IT8951_Dev* Dev, UBYTE* Frame_Buf, UWORD X, UWORD Y, UWORD W, UWORD H, bool Hold, UDOUBLE Target_Memory_Addr, bool Packed_Write);
 
-void EPD_IT8951_2bp_Refresh(UBYTE* Frame_Buf, UWORD X, UWORD Y, UWORD W, UWORD H, bool Hold, UDOUBLE Target_Memory_Addr, bool Packed_Write);
+UBYTE EPD_IT8951_8bp_Refresh(IT8951_Dev* Dev, UBYTE *Frame_Buf, UWORD X, UWORD Y, UWORD W, UWORD H, bool Hold, UDOUBLE Target_Memory_Addr);
 
-void EPD_IT8951_4bp_Refresh(UBYTE* Frame_Buf, UWORD X, UWORD Y, UWORD W, UWORD H, bool Hold, UDOUBLE Target_Memory_Addr, bool Packed_Write);
+UBYTE EPD_IT8951_Broadcast_Refresh(IT8951_Dev** Devs, UBYTE Count, UBYTE Bits_Per_Pixel, UBYTE* Frame_Buf, UWORD X, UWORD Y, UWORD W, UWORD H, UBYTE Mode, UDOUBLE Target_Memory_Addr);
+UBYTE EPD_IT8951_Broadcast_Clear(IT8951_Dev** Devs, UBYTE Count, UDOUBLE Target_Memory_Addr, UWORD Mode);
 
-void EPD_IT8951_8bp_Refresh(UBYTE *Frame_Buf, UWORD X, UWORD Y, UWORD W, UWORD H, bool Hold, UDOUBLE Target_Memory_Addr);
+UBYTE EPD_IT8951_Record_Start(IT8951_Dev* Dev, IT8951_Recording* Rec);
+UBYTE EPD_IT8951_Record_Stop(IT8951_Dev* Dev);
+UBYTE EPD_IT8951_Replay(IT8951_Dev* Dev, IT8951_Recording* Rec);
+UBYTE EPD_IT8951_Recording_Save(const IT8951_Recording* Rec, const char* Path);
+UBYTE EPD_IT8951_Recording_Load(IT8951_Recording* Rec, const char* Path);
+void EPD_IT8951_Recording_Free(IT8951_Recording* Rec);
 
 
 
@@ -0,0 +1,286 @@
+/*****************************************************************************
+* | File      	:   EPD_IT8951_Cache.c
+* | Author      :   IT8951-ePaper contributors
+* | Function    :   IT8951 SDRAM allocator and screen cache
+* | Info        :
+*                Every image buffer shares the display buffer's pitch, so a
+*                W x H area at (X, Y) takes H rows spread over the pitch
+*                and not W x H bytes in a row. A slot holds exactly those
+*                bytes and its Target_Memory_Addr is picked so the area
+*                lands in them. Free space is whatever lies between the
+*                slots, first fit.
+*                Named slots are screens kept loaded for later; when room
+*                is short the least recently used one goes.
+*----------------
+* |	This version:   V1.0
+* | Date        :   2026-10-18
+* | Info        :
+* -----------------------------------------------------------------------------
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documnetation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to  whom the Software is
+# furished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS OR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+# THE SOFTWARE.
+#
+******************************************************************************/
+#include "EPD_IT8951_Cache.h"
+#include <string.h>
+
+
+/******************************************************************************
+function :	EPD_IT8951_Pool_Init
+parameter:
+    End_Addr : end of the controller SDRAM, 0 for IT8951_SDRAM_SIZE
+    Evicted  : called for every screen dropped by EPD_IT8951_Cache_Add,
+               may be NULL
+Info:
+    Dev must be initialized, the pool starts past its display buffer.
+    A pool is not shared between threads.
+******************************************************************************/
+void EPD_IT8951_Pool_Init(IT8951_Pool* Pool, IT8951_Dev* Dev, UDOUBLE End_Addr, IT8951_Cache_Evicted Evicted, void* User)
+{
+    UDOUBLE Memory_Addr = Dev->Info.Memory_Addr_L | ((UDOUBLE)Dev->Info.Memory_Addr_H << 16);
+
+    memset(Pool, 0, sizeof(*Pool));
+    Pool->Dev = Dev;
+    Pool->Start = Memory_Addr + (UDOUBLE)Dev->Image_Pitch * Dev->Info.Panel_H;
+    Pool->End = (End_Addr != 0) ? End_Addr : IT8951_SDRAM_SIZE;
+    Pool->Evicted = Evicted;
+    Pool->User = User;
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Pool_Place
+parameter:
+Info:
+    Takes a free slot for the area, at the lowest address it fits. The
+    area is on the canvas, the room it takes is where the driver loads
+    it on the panel. Returns NULL when there is no room or no free slot.
+******************************************************************************/
+static IT8951_Slot* EPD_IT8951_Pool_Place(IT8951_Pool* Pool, UBYTE Bits_Per_Pixel, UWORD X, UWORD Y, UWORD W, UWORD H)
+{
+    UDOUBLE Pitch = Pool->Dev->Image_Pitch;
+    UWORD Panel_X = X, Panel_Y = Y, Panel_W = W, Panel_H = H;
+    UDOUBLE Mem_X, Mem_W;
+    UDOUBLE Off_Start, Off_End, Gap_Start, Gap_End, Target;
+    UDOUBLE Best = 0;
+    IT8951_Slot* Slot = NULL;
+    bool Found = false;
+
+    if(W == 0 || H == 0)
+        return NULL;
+    EPD_IT8951_Map_Area(Pool->Dev, &Panel_X, &Panel_Y, &Panel_W, &Panel_H);
+    Mem_X = (Bits_Per_Pixel == 1) ? Panel_X / 8 : Panel_X;
+    Mem_W = (Bits_Per_Pixel == 1) ? (Panel_W + 7) / 8 : Panel_W;
+    Off_Start = (UDOUBLE)Panel_Y * Pitch + Mem_X;
+    Off_End = (UDOUBLE)(Panel_Y + Panel_H - 1) * Pitch + Mem_X + Mem_W;
+
+    //a gap starts at the pool start or at the end of a slot and ends at
+    //the next slot up
+    for(int i = -1; i < IT8951_POOL_SLOTS; i++)
+    {
+        if(i >= 0 && !Pool->Slot[i].Used)
+            continue;
+        Gap_Start = (i < 0) ? Pool->Start : Pool->Slot[i].End;
+        Gap_End = Pool->End;
+        for(int j = 0; j < IT8951_POOL_SLOTS; j++)
+            if(Pool->Slot[j].Used && Pool->Slot[j].Start >= Gap_Start && Pool->Slot[j].Start < Gap_End)
+                Gap_End = Pool->Slot[j].Start;
+
+        Target = (Gap_Start > Off_Start) ? Gap_Start - Off_Start : 0;
+        Target = (Target + IT8951_POOL_ALIGN - 1) / IT8951_POOL_ALIGN * IT8951_POOL_ALIGN;
+        if(Target == 0)
+            Target = IT8951_POOL_ALIGN;     //0 means the display buffer to the refresh calls
+        if(Target + Off_End > Gap_End)
+            continue;
+        if(!Found || Target < Best) {
+            Best = Target;
+            Found = true;
+        }
+    }
+    if(!Found)
+        return NULL;
+
+    for(int i = 0; i < IT8951_POOL_SLOTS; i++)
+        if(!Pool->Slot[i].Used) {
+            Slot = &Pool->Slot[i];
+            break;
+        }
+    if(Slot == NULL)
+        return NULL;
+
+    memset(Slot, 0, sizeof(*Slot));
+    Slot->Used = true;
+    Slot->Target_Memory_Addr = Best;
+    Slot->Start = Best + Off_Start;
+    Slot->End = Best + Off_End;
+    Slot->Bits_Per_Pixel = Bits_Per_Pixel;
+    Slot->X = X;
+    Slot->Y = Y;
+    Slot->W = W;
+    Slot->H = H;
+    Slot->Last_Use = ++Pool->Use_Count;
+    return Slot;
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Pool_Alloc
+parameter:
+    Bits_Per_Pixel   : of the frame, 1 takes a byte per 8 pixels, the
+                       others a byte per pixel
+    X, Y, W, H       : area the frame is written to and shown at
+Info:
+    Returns the Target_Memory_Addr for the frame, 0 when there is no room.
+    Cached screens are not dropped for it.
+******************************************************************************/
+UDOUBLE EPD_IT8951_Pool_Alloc(IT8951_Pool* Pool, UBYTE Bits_Per_Pixel, UWORD X, UWORD Y, UWORD W, UWORD H)
+{
+    IT8951_Slot* Slot = EPD_IT8951_Pool_Place(Pool, Bits_Per_Pixel, X, Y, W, H);
+
+    return (Slot != NULL) ? Slot->Target_Memory_Addr : 0;
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Pool_Free
+parameter:
+Info:
+    A refresh still showing from the slot is safe, whatever is loaded
+    there next waits for it
+******************************************************************************/
+void EPD_IT8951_Pool_Free(IT8951_Pool* Pool, UDOUBLE Target_Memory_Addr)
+{
+    for(int i = 0; i < IT8951_POOL_SLOTS; i++)
+        if(Pool->Slot[i].Used && Pool->Slot[i].Target_Memory_Addr == Target_Memory_Addr) {
+            Pool->Slot[i].Used = false;
+            return;
+        }
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Pool_Free_Bytes
+parameter:
+Info:
+    Between the slots, a frame may still not fit for its spread over the
+    pitch
+******************************************************************************/
+UDOUBLE EPD_IT8951_Pool_Free_Bytes(IT8951_Pool* Pool)
+{
+    UDOUBLE Free = Pool->End - Pool->Start;
+
+    for(int i = 0; i < IT8951_POOL_SLOTS; i++)
+        if(Pool->Slot[i].Used)
+            Free -= Pool->Slot[i].End - Pool->Slot[i].Start;
+    return Free;
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Cache_Find
+parameter:
+Info:
+    Returns the screen loaded under Name, NULL when it is not, and counts
+    the lookup as a use
+******************************************************************************/
+IT8951_Slot* EPD_IT8951_Cache_Find(IT8951_Pool* Pool, const char* Name)
+{
+    for(int i = 0; i < IT8951_POOL_SLOTS; i++)
+        if(Pool->Slot[i].Used && Pool->Slot[i].Name[0] != 0
+           && strncmp(Pool->Slot[i].Name, Name, IT8951_CACHE_NAME - 1) == 0) {
+            Pool->Slot[i].Last_Use = ++Pool->Use_Count;
+            Pool->Hits++;
+            return &Pool->Slot[i];
+        }
+    Pool->Misses++;
+    return NULL;
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Cache_Remove
+parameter:
+Info:
+    For a screen whose content changed or whose load failed
+******************************************************************************/
+void EPD_IT8951_Cache_Remove(IT8951_Pool* Pool, const char* Name)
+{
+    for(int i = 0; i < IT8951_POOL_SLOTS; i++)
+        if(Pool->Slot[i].Used && Pool->Slot[i].Name[0] != 0
+           && strncmp(Pool->Slot[i].Name, Name, IT8951_CACHE_NAME - 1) == 0)
+            Pool->Slot[i].Used = false;
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Cache_Add
+parameter:
+    Name : up to IT8951_CACHE_NAME - 1 characters, a screen already
+           under it is dropped
+Info:
+    Makes room for a screen, dropping the least recently used ones as
+    needed, and reports each to Evicted. The caller loads the screen to
+    the slot's Target_Memory_Addr at X, Y, e.g. with
+    EPD_IT8951_Area_Write. Returns NULL when it cannot fit even with
+    every other screen gone.
+******************************************************************************/
+IT8951_Slot* EPD_IT8951_Cache_Add(IT8951_Pool* Pool, const char* Name, UBYTE Bits_Per_Pixel, UWORD X, UWORD Y, UWORD W, UWORD H)
+{
+    IT8951_Slot* Slot;
+    IT8951_Slot* Oldest;
+    char Evicted_Name[IT8951_CACHE_NAME];
+
+    EPD_IT8951_Cache_Remove(Pool, Name);
+
+    while((Slot = EPD_IT8951_Pool_Place(Pool, Bits_Per_Pixel, X, Y, W, H)) == NULL)
+    {
+        Oldest = NULL;
+        for(int i = 0; i < IT8951_POOL_SLOTS; i++)
+            if(Pool->Slot[i].Used && Pool->Slot[i].Name[0] != 0
+               && (Oldest == NULL || Pool->Slot[i].Last_Use < Oldest->Last_Use))
+                Oldest = &Pool->Slot[i];
+        if(Oldest == NULL)
+            return NULL;
+
+        Oldest->Used = false;
+        Pool->Evictions++;
+        if(Pool->Evicted != NULL) {
+            strcpy(Evicted_Name, Oldest->Name);
+            Pool->Evicted(Pool->User, Evicted_Name);
+        }
+    }
+
+    strncpy(Slot->Name, Name, IT8951_CACHE_NAME - 1);
+    Slot->Name[IT8951_CACHE_NAME - 1] = 0;
+    return Slot;
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Cache_Show
+parameter:
+    Mode : waveform, A2_Mode for ink, GC16_Mode for the grayscale formats
+Info:
+    One display command from the screen's slot, nothing is loaded
+******************************************************************************/
+UBYTE EPD_IT8951_Cache_Show(IT8951_Pool* Pool, IT8951_Slot* Screen, UBYTE Mode)
+{
+    Screen->Last_Use = ++Pool->Use_Count;
+    return EPD_IT8951_Area_Refresh(Pool->Dev, Screen->Bits_Per_Pixel, Screen->X, Screen->Y, Screen->W, Screen->H,
+                                   Mode, Screen->Target_Memory_Addr);
+}
@@ -0,0 +1,88 @@
+/*****************************************************************************
+* | File      	:   EPD_IT8951_Cache.h
+* | Author      :   IT8951-ePaper contributors
+* | Function    :   IT8951 SDRAM allocator and screen cache
+* | Info        :
+*----------------
+* |	This version:   V1.0
+* | Date        :   2026-10-18
+* | Info        :
+* -----------------------------------------------------------------------------
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documnetation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to  whom the Software is
+# furished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS OR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+# THE SOFTWARE.
+#
+******************************************************************************/
+#ifndef __EPD_IT8951_CACHE_H_
+#define __EPD_IT8951_CACHE_H_
+
+#include "EPD_IT8951.h"
+
+//controller SDRAM, give EPD_IT8951_Pool_Init the real end if a board differs
+#define IT8951_SDRAM_SIZE       0x4000000
+
+#define IT8951_POOL_SLOTS       32      //frames and screens held at once
+#define IT8951_POOL_ALIGN       4       //of every Target_Memory_Addr handed out
+#define IT8951_CACHE_NAME       24      //screen names, the terminator included
+
+//a frame's place in the SDRAM; Start..End are the bytes its area takes,
+//Target_Memory_Addr is what the refresh and write calls are given
+typedef struct IT8951_Slot
+{
+    UDOUBLE Target_Memory_Addr;
+    UDOUBLE Start;
+    UDOUBLE End;
+    UBYTE Bits_Per_Pixel;
+    UWORD X;
+    UWORD Y;
+    UWORD W;
+    UWORD H;
+    char Name[IT8951_CACHE_NAME];       //cached screen, empty for EPD_IT8951_Pool_Alloc
+    UDOUBLE Last_Use;
+    bool Used;
+}IT8951_Slot;
+
+//a cached screen was dropped to make room, it has to be loaded again
+typedef void (*IT8951_Cache_Evicted)(void* User, const char* Name);
+
+typedef struct IT8951_Pool
+{
+    IT8951_Dev* Dev;
+    UDOUBLE Start;                      //past the display buffer
+    UDOUBLE End;
+    IT8951_Slot Slot[IT8951_POOL_SLOTS];    //stay put while used, callers keep pointers
+    UDOUBLE Use_Count;                  //clock of Last_Use
+    IT8951_Cache_Evicted Evicted;
+    void* User;
+
+    UDOUBLE Hits;
+    UDOUBLE Misses;
+    UDOUBLE Evictions;
+}IT8951_Pool;
+
+void EPD_IT8951_Pool_Init(IT8951_Pool* Pool, IT8951_Dev* Dev, UDOUBLE End_Addr, IT8951_Cache_Evicted Evicted, void* User);
+UDOUBLE EPD_IT8951_Pool_Alloc(IT8951_Pool* Pool, UBYTE Bits_Per_Pixel, UWORD X, UWORD Y, UWORD W, UWORD H);
+void EPD_IT8951_Pool_Free(IT8951_Pool* Pool, UDOUBLE Target_Memory_Addr);
+UDOUBLE EPD_IT8951_Pool_Free_Bytes(IT8951_Pool* Pool);
+
+IT8951_Slot* EPD_IT8951_Cache_Find(IT8951_Pool* Pool, const char* Name);
+IT8951_Slot* EPD_IT8951_Cache_Add(IT8951_Pool* Pool, const char* Name, UBYTE Bits_Per_Pixel, UWORD X, UWORD Y, UWORD W, UWORD H);
+void EPD_IT8951_Cache_Remove(IT8951_Pool* Pool, const char* Name);
+UBYTE EPD_IT8951_Cache_Show(IT8951_Pool* Pool, IT8951_Slot* Screen, UBYTE Mode);
+
+#endif
@@ -0,0 +1,195 @@
+/*****************************************************************************
+* | File      	:   EPD_IT8951_Coalesce.c
+* | Author      :   IT8951-ePaper contributors
+* | Function    :   Coalescing of small refreshes on the IT8951
+* | Info        :
+*                Every refresh is loaded right away, so the caller can reuse
+*                its buffer, but its display command is held for a few
+*                milliseconds. Held areas of the same format, mode and
+*                buffer that overlap or touch are merged when that does not
+*                grow the refreshed area, and a burst of small updates
+*                becomes a few display commands and waveforms. The merged
+*                area is shown from the image buffer, so the pixels in it
+*                that no refresh wrote have to be what the panel shows
+*                already, as they are when every update goes to one buffer.
+*----------------
+* |	This version:   V1.0
+* | Date        :   2026-10-18
+* | Info        :
+* -----------------------------------------------------------------------------
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documnetation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to  whom the Software is
+# furished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS OR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+# THE SOFTWARE.
+#
+******************************************************************************/
+#include "EPD_IT8951_Coalesce.h"
+#include <string.h>
+
+
+/******************************************************************************
+function :	EPD_IT8951_Coalesce_Init
+parameter:
+    Window_ms : how long a display command is held, 0 to show every
+                refresh right away
+******************************************************************************/
+void EPD_IT8951_Coalesce_Init(IT8951_Coalesce* Coalesce, IT8951_Dev* Dev, UWORD Window_ms)
+{
+    memset(Coalesce, 0, sizeof(*Coalesce));
+    Coalesce->Dev = Dev;
+    Coalesce->Window_us = (uint64_t)Window_ms * 1000;
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Coalesce_Merge
+parameter:
+Info:
+    Merges only when the rectangle around both is exactly their union:
+    one contains the other, or they span the same columns and overlap or
+    meet in rows, or the same rows and overlap or meet in columns. Any
+    other rectangle would show pixels neither area loaded.
+******************************************************************************/
+static bool EPD_IT8951_Coalesce_Merge(IT8951_Coalesce_Area* Into, const IT8951_Coalesce_Area* Area)
+{
+    UWORD X0, Y0, X1, Y1;
+    bool Same_Cols, Same_Rows;
+
+    if(Into->Bits_Per_Pixel != Area->Bits_Per_Pixel || Into->Mode != Area->Mode
+        || Into->Target_Memory_Addr != Area->Target_Memory_Addr)
+        return false;
+    if(Into->X > Area->X + Area->W || Area->X > Into->X + Into->W
+        || Into->Y > Area->Y + Area->H || Area->Y > Into->Y + Into->H)
+        return false;
+
+    X0 = (Into->X < Area->X) ? Into->X : Area->X;
+    Y0 = (Into->Y < Area->Y) ? Into->Y : Area->Y;
+    X1 = (Into->X + Into->W > Area->X + Area->W) ? Into->X + Into->W : Area->X + Area->W;
+    Y1 = (Into->Y + Into->H > Area->Y + Area->H) ? Into->Y + Into->H : Area->Y + Area->H;
+
+    Same_Cols = Into->X == Area->X && Into->W == Area->W;
+    Same_Rows = Into->Y == Area->Y && Into->H == Area->H;
+    if(!Same_Cols && !Same_Rows
+        && !(X0 == Into->X && Y0 == Into->Y && X1 == Into->X + Into->W && Y1 == Into->Y + Into->H)
+        && !(X0 == Area->X && Y0 == Area->Y && X1 == Area->X + Area->W && Y1 == Area->Y + Area->H))
+        return false;
+
+    Into->X = X0;
+    Into->Y = Y0;
+    Into->W = X1 - X0;
+    Into->H = Y1 - Y0;
+    return true;
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Coalesce_Flush
+parameter:
+Info:
+    Shows every held area, oldest first. Returns the first error.
+******************************************************************************/
+UBYTE EPD_IT8951_Coalesce_Flush(IT8951_Coalesce* Coalesce)
+{
+    UBYTE Status = IT8951_OK;
+
+    pthread_mutex_lock(&Coalesce->Dev->Lock);
+    for(UBYTE i = 0; i < Coalesce->Count; i++)
+    {
+        IT8951_Coalesce_Area* Area = &Coalesce->Area[i];
+        UBYTE Area_Status = EPD_IT8951_Area_Refresh(Coalesce->Dev, Area->Bits_Per_Pixel, Area->X, Area->Y, Area->W, Area->H, Area->Mode, Area->Target_Memory_Addr);
+        if(Status == IT8951_OK)
+            Status = Area_Status;
+    }
+    Coalesce->Count = 0;
+    pthread_mutex_unlock(&Coalesce->Dev->Lock);
+    return Status;
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Coalesce_Poll
+parameter:
+Info:
+    From the application's loop, shows the held areas once the oldest has
+    waited for the window
+******************************************************************************/
+UBYTE EPD_IT8951_Coalesce_Poll(IT8951_Coalesce* Coalesce)
+{
+    UBYTE Status = IT8951_OK;
+
+    pthread_mutex_lock(&Coalesce->Dev->Lock);
+    if(Coalesce->Count != 0 && DEV_Time_us() - Coalesce->First_us >= Coalesce->Window_us)
+        Status = EPD_IT8951_Coalesce_Flush(Coalesce);
+    pthread_mutex_unlock(&Coalesce->Dev->Lock);
+    return Status;
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Coalesce_Refresh
+parameter:
+    Bits_Per_Pixel : 1, 2, 4 or 8, Frame_Buf laid out as for EPD_IT8951_<n>bp_Refresh
+    Mode           : waveform, GC16_Mode for the grayscale formats
+Info:
+    Loads the area now and holds its display command. The held areas are
+    shown when the window is over, seen here or by
+    EPD_IT8951_Coalesce_Poll, or when no more can be held. Returns the
+    error of the load, or of the display commands sent by this call.
+******************************************************************************/
+UBYTE EPD_IT8951_Coalesce_Refresh(IT8951_Coalesce* Coalesce, UBYTE Bits_Per_Pixel, UBYTE* Frame_Buf, UWORD X, UWORD Y, UWORD W, UWORD H, UBYTE Mode, UDOUBLE Target_Memory_Addr)
+{
+    IT8951_Coalesce_Area Area;
+    UBYTE Status;
+
+    pthread_mutex_lock(&Coalesce->Dev->Lock);
+    Status = EPD_IT8951_Area_Write(Coalesce->Dev, Bits_Per_Pixel, Frame_Buf, X, Y, W, H, Target_Memory_Addr);
+    if(Status != IT8951_OK) {
+        pthread_mutex_unlock(&Coalesce->Dev->Lock);
+        return Status;
+    }
+
+    Area.Bits_Per_Pixel = Bits_Per_Pixel;
+    Area.Mode = Mode;
+    Area.Target_Memory_Addr = Target_Memory_Addr;
+    Area.X = X;
+    Area.Y = Y;
+    Area.W = W;
+    Area.H = H;
+
+    //a merged area can merge again, it goes to the end as it holds the newest pixels
+    for(UBYTE i = 0; i < Coalesce->Count; )
+    {
+        if(EPD_IT8951_Coalesce_Merge(&Area, &Coalesce->Area[i])) {
+            memmove(&Coalesce->Area[i], &Coalesce->Area[i + 1], (Coalesce->Count - i - 1) * sizeof(Area));
+            Coalesce->Count--;
+            i = 0;
+        } else {
+            i++;
+        }
+    }
+
+    if(Coalesce->Count == IT8951_COALESCE_AREAS)
+        Status = EPD_IT8951_Coalesce_Flush(Coalesce);
+    if(Coalesce->Count == 0)
+        Coalesce->First_us = DEV_Time_us();
+    Coalesce->Area[Coalesce->Count++] = Area;
+
+    if(Status == IT8951_OK)
+        Status = EPD_IT8951_Coalesce_Poll(Coalesce);
+    pthread_mutex_unlock(&Coalesce->Dev->Lock);
+    return Status;
+}
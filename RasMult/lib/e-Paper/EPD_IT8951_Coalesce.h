@@ -0,0 +1,64 @@
+/*****************************************************************************
+* | File      	:   EPD_IT8951_Coalesce.h
+* | Author      :   IT8951-ePaper contributors
+* | Function    :   Coalescing of small refreshes on the IT8951
+* | Info        :
+*----------------
+* |	This version:   V1.0
+* | Date        :   2026-10-18
+* | Info        :
+* -----------------------------------------------------------------------------
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documnetation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to  whom the Software is
+# furished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS OR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+# THE SOFTWARE.
+#
+******************************************************************************/
+#ifndef __EPD_IT8951_COALESCE_H_
+#define __EPD_IT8951_COALESCE_H_
+
+#include "EPD_IT8951.h"
+
+#define IT8951_COALESCE_AREAS      8       //display commands held at most
+#define IT8951_COALESCE_WINDOW_MS  20      //default hold time
+
+typedef struct IT8951_Coalesce_Area
+{
+    UBYTE Bits_Per_Pixel;
+    UBYTE Mode;
+    UDOUBLE Target_Memory_Addr;
+    UWORD X;
+    UWORD Y;
+    UWORD W;
+    UWORD H;
+}IT8951_Coalesce_Area;
+
+typedef struct IT8951_Coalesce
+{
+    IT8951_Dev* Dev;
+    uint64_t Window_us;         //0 shows every refresh right away
+    IT8951_Coalesce_Area Area[IT8951_COALESCE_AREAS];   //oldest first
+    UBYTE Count;
+    uint64_t First_us;          //when the oldest held area was loaded
+}IT8951_Coalesce;
+
+void EPD_IT8951_Coalesce_Init(IT8951_Coalesce* Coalesce, IT8951_Dev* Dev, UWORD Window_ms);
+UBYTE EPD_IT8951_Coalesce_Refresh(IT8951_Coalesce* Coalesce, UBYTE Bits_Per_Pixel, UBYTE* Frame_Buf, UWORD X, UWORD Y, UWORD W, UWORD H, UBYTE Mode, UDOUBLE Target_Memory_Addr);
+UBYTE EPD_IT8951_Coalesce_Poll(IT8951_Coalesce* Coalesce);
+UBYTE EPD_IT8951_Coalesce_Flush(IT8951_Coalesce* Coalesce);
+
+#endif
@@ -0,0 +1,133 @@
+/*****************************************************************************
+* | File      	:   EPD_IT8951_Player.c
+* | Author      :   IT8951-ePaper contributors
+* | Function    :   Paced playback of frames held in IT8951 memory
+* | Info        :
+*                Frame n is due at the first frame's time plus n periods.
+*                A frame is shown at its deadline, or dropped when the area
+*                still runs the waveform of the one before; the next frame
+*                replaces it. Nothing queues behind a busy LUT engine, so a
+*                slow waveform costs frames and not latency, and the frames
+*                that are shown stay on the beat.
+*----------------
+* |	This version:   V1.0
+* | Date        :   2026-10-18
+* | Info        :
+* -----------------------------------------------------------------------------
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documnetation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to  whom the Software is
+# furished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS OR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+# THE SOFTWARE.
+#
+******************************************************************************/
+#include "EPD_IT8951_Player.h"
+#include <string.h>
+#include <math.h>
+
+
+/******************************************************************************
+function :	EPD_IT8951_Player_Start
+parameter:
+    X, Y, W, H     : panel area the frames are shown in
+    Bits_Per_Pixel : of the frames, as loaded with EPD_IT8951_Area_Write or
+                     EPD_IT8951_1bp_Multi_Frame_Write
+    Mode           : waveform, A2_Mode for animation
+    Frame_Rate     : target, frames per second
+Info:
+    The clock starts with the first frame
+******************************************************************************/
+void EPD_IT8951_Player_Start(IT8951_Player* Player, IT8951_Dev* Dev, UBYTE Bits_Per_Pixel, UWORD X, UWORD Y, UWORD W, UWORD H, UBYTE Mode, UWORD Frame_Rate)
+{
+    memset(Player, 0, sizeof(*Player));
+    Player->Dev = Dev;
+    Player->Bits_Per_Pixel = Bits_Per_Pixel;
+    Player->Mode = Mode;
+    Player->X = X;
+    Player->Y = Y;
+    Player->W = W;
+    Player->H = H;
+    Player->Period_us = 1000000 / ((Frame_Rate != 0) ? Frame_Rate : 1);
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Player_Frame
+parameter:
+    Frame_Addr : image buffer holding the frame
+Info:
+    Sleeps until the frame's deadline and shows it, unless the area is
+    still busy then. A caller that fell behind by whole periods is put
+    back on the beat, the missed deadlines are not made up for.
+******************************************************************************/
+UBYTE EPD_IT8951_Player_Frame(IT8951_Player* Player, UDOUBLE Frame_Addr)
+{
+    uint64_t Now = DEV_Time_us();
+    UBYTE Status;
+
+    if(Player->Deadline_us == 0) {
+        Player->Start_us = Now;
+        Player->Deadline_us = Now;
+    }
+    if(Now >= Player->Deadline_us + Player->Period_us) {
+        Player->Deadline_us += (Now - Player->Deadline_us) / Player->Period_us * Player->Period_us;
+    } else if(Now < Player->Deadline_us) {
+        DEV_Delay_us(Player->Deadline_us - Now);
+    }
+
+    if(EPD_IT8951_Area_Busy(Player->Dev, Player->X, Player->Y, Player->W, Player->H)) {
+        Player->Stats.Dropped++;
+        Player->Deadline_us += Player->Period_us;
+        return IT8951_OK;
+    }
+
+    Status = EPD_IT8951_Area_Refresh(Player->Dev, Player->Bits_Per_Pixel, Player->X, Player->Y, Player->W, Player->H, Player->Mode, Frame_Addr);
+
+    Now = DEV_Time_us();
+    if(Now - Player->Deadline_us > Player->Stats.Max_Late_us)
+        Player->Stats.Max_Late_us = Now - Player->Deadline_us;
+    if(Player->Stats.Shown != 0) {
+        double Interval = (double)(Now - Player->Last_Show_us);
+        Player->Sum_Interval += Interval;
+        Player->Sum_Interval2 += Interval * Interval;
+    }
+    Player->Last_Show_us = Now;
+    Player->Stats.Shown++;
+    Player->Deadline_us += Player->Period_us;
+    return Status;
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Player_Get_Stats
+parameter:
+Info:
+    Since EPD_IT8951_Player_Start
+******************************************************************************/
+void EPD_IT8951_Player_Get_Stats(IT8951_Player* Player, IT8951_Player_Stats* Stats)
+{
+    UDOUBLE Intervals = (Player->Stats.Shown > 1) ? Player->Stats.Shown - 1 : 0;
+    uint64_t Elapsed = Player->Last_Show_us - Player->Start_us;
+
+    *Stats = Player->Stats;
+    Stats->Fps = (Elapsed != 0) ? Intervals * 1000000.0 / Elapsed : 0;
+    Stats->Jitter_us = 0;
+    if(Intervals != 0) {
+        double Mean = Player->Sum_Interval / Intervals;
+        double Var = Player->Sum_Interval2 / Intervals - Mean * Mean;
+        Stats->Jitter_us = (Var > 0) ? sqrt(Var) : 0;
+    }
+}
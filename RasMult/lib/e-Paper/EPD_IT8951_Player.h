@@ -0,0 +1,67 @@
+/*****************************************************************************
+* | File      	:   EPD_IT8951_Player.h
+* | Author      :   IT8951-ePaper contributors
+* | Function    :   Paced playback of frames held in IT8951 memory
+* | Info        :
+*----------------
+* |	This version:   V1.0
+* | Date        :   2026-10-18
+* | Info        :
+* -----------------------------------------------------------------------------
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documnetation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to  whom the Software is
+# furished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS OR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+# THE SOFTWARE.
+#
+******************************************************************************/
+#ifndef __EPD_IT8951_PLAYER_H_
+#define __EPD_IT8951_PLAYER_H_
+
+#include "EPD_IT8951.h"
+
+typedef struct IT8951_Player_Stats
+{
+    UDOUBLE Shown;
+    UDOUBLE Dropped;            //the area was still busy at the frame's deadline
+    double Fps;                 //frames shown per second of wall time
+    double Jitter_us;           //standard deviation of the time between shown frames
+    UDOUBLE Max_Late_us;        //of a shown frame, after its deadline
+}IT8951_Player_Stats;
+
+typedef struct IT8951_Player
+{
+    IT8951_Dev* Dev;
+    UBYTE Bits_Per_Pixel;
+    UBYTE Mode;
+    UWORD X;
+    UWORD Y;
+    UWORD W;
+    UWORD H;
+    uint64_t Period_us;
+    uint64_t Deadline_us;       //of the next frame, 0 before the first
+    uint64_t Start_us;
+    uint64_t Last_Show_us;
+    double Sum_Interval;
+    double Sum_Interval2;
+    IT8951_Player_Stats Stats;
+}IT8951_Player;
+
+void EPD_IT8951_Player_Start(IT8951_Player* Player, IT8951_Dev* Dev, UBYTE Bits_Per_Pixel, UWORD X, UWORD Y, UWORD W, UWORD H, UBYTE Mode, UWORD Frame_Rate);
+UBYTE EPD_IT8951_Player_Frame(IT8951_Player* Player, UDOUBLE Frame_Addr);
+void EPD_IT8951_Player_Get_Stats(IT8951_Player* Player, IT8951_Player_Stats* Stats);
+
+#endif
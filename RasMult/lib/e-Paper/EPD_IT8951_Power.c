@@ -0,0 +1,105 @@
+/*****************************************************************************
+* | File      	:   EPD_IT8951_Power.c
+* | Author      :   IT8951-ePaper contributors
+* | Function    :   Idle power management for the IT8951
+* | Info        :
+*                Steps the controller down to standby and sleep when it
+*                has not been used for a while, and back up as soon as an
+*                update is announced rather than when it arrives
+*----------------
+* |	This version:   V1.0
+* | Date        :   2026-10-18
+* | Info        :
+* -----------------------------------------------------------------------------
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documnetation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to  whom the Software is
+# furished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS OR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+# THE SOFTWARE.
+#
+******************************************************************************/
+#include "EPD_IT8951_Power.h"
+
+
+/******************************************************************************
+function :	EPD_IT8951_Power_Set_Idle
+parameter:
+    Standby_ms : idle time before standby, 0 never
+    Sleep_ms   : idle time before sleep, 0 never
+******************************************************************************/
+void EPD_IT8951_Power_Set_Idle(IT8951_Dev* Dev, UDOUBLE Standby_ms, UDOUBLE Sleep_ms)
+{
+    pthread_mutex_lock(&Dev->Lock);
+    Dev->Standby_Idle_ms = Standby_ms;
+    Dev->Sleep_Idle_ms = Sleep_ms;
+    pthread_mutex_unlock(&Dev->Lock);
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Power_Hint
+parameter:
+Info:
+    An update is likely soon, e.g. the pen came into range or a refresh
+    was queued. Brings the controller back now so the update itself does
+    not pay EPD_IT8951_Get_Wake_us. No bus traffic while it is running,
+    cheap enough to call on every input poll. Never waits for the panel:
+    while another thread is inside a call on it, that call has woken it
+    already and the hint is dropped.
+******************************************************************************/
+void EPD_IT8951_Power_Hint(IT8951_Dev* Dev)
+{
+    if(pthread_mutex_trylock(&Dev->Lock) != 0)
+        return;
+    Dev->Last_Hint_us = DEV_Time_us();
+
+    if(EPD_IT8951_Get_Power_State(Dev) != IT8951_POWER_RUN) {
+        UBYTE From = EPD_IT8951_Get_Power_State(Dev);
+        EPD_IT8951_SystemRun(Dev);
+        Debug("Pre-wake from %s, %lu us\r\n", From == IT8951_POWER_SLEEP ? "sleep" : "standby",
+              (unsigned long)EPD_IT8951_Get_Wake_us(Dev, From));
+    }
+    pthread_mutex_unlock(&Dev->Lock);
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Power_Poll
+parameter:
+Info:
+    Call from the main loop. Standby and Sleep first wait for the
+    waveforms the driver started, which have normally ended by then.
+******************************************************************************/
+UBYTE EPD_IT8951_Power_Poll(IT8951_Dev* Dev)
+{
+    UDOUBLE Idle_ms, Hint_ms;
+    UBYTE State, Status = IT8951_OK;
+
+    pthread_mutex_lock(&Dev->Lock);
+    Idle_ms = EPD_IT8951_Get_Idle_ms(Dev);
+    Hint_ms = (UDOUBLE)((DEV_Time_us() - Dev->Last_Hint_us) / 1000);
+    State = EPD_IT8951_Get_Power_State(Dev);
+
+    if(Hint_ms < Idle_ms)
+        Idle_ms = Hint_ms;
+
+    if(State != IT8951_POWER_SLEEP && Dev->Sleep_Idle_ms != 0 && Idle_ms >= Dev->Sleep_Idle_ms)
+        Status = EPD_IT8951_Sleep(Dev);
+    else if(State == IT8951_POWER_RUN && Dev->Standby_Idle_ms != 0 && Idle_ms >= Dev->Standby_Idle_ms)
+        Status = EPD_IT8951_Standby(Dev);
+    pthread_mutex_unlock(&Dev->Lock);
+    return Status;
+}
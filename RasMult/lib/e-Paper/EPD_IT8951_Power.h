@@ -0,0 +1,40 @@
+/*****************************************************************************
+* | File      	:   EPD_IT8951_Power.h
+* | Author      :   IT8951-ePaper contributors
+* | Function    :   Idle power management for the IT8951
+* | Info        :
+*----------------
+* |	This version:   V1.0
+* | Date        :   2026-10-18
+* | Info        :
+* -----------------------------------------------------------------------------
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documnetation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to  whom the Software is
+# furished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS OR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+# THE SOFTWARE.
+#
+******************************************************************************/
+#ifndef __EPD_IT8951_POWER_H_
+#define __EPD_IT8951_POWER_H_
+
+#include "EPD_IT8951.h"
+
+void EPD_IT8951_Power_Set_Idle(IT8951_Dev* Dev, UDOUBLE Standby_ms, UDOUBLE Sleep_ms);
+void EPD_IT8951_Power_Hint(IT8951_Dev* Dev);
+UBYTE EPD_IT8951_Power_Poll(IT8951_Dev* Dev);
+
+#endif
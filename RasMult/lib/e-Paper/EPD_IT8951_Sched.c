@@ -0,0 +1,361 @@
+/*****************************************************************************
+* | File      	:   EPD_IT8951_Sched.c
+* | Author      :   IT8951-ePaper contributors
+* | Function    :   Refresh scheduler for several IT8951 panels on one SPI bus
+* | Info        :
+*                One worker thread per panel issues that panel's jobs in
+*                order. A worker that waits for HRDY or for its own panel's
+*                waveform does not hold the bus, so the others upload and
+*                start their waveforms meanwhile: a round over all panels
+*                costs about the sum of the uploads plus the longest
+*                waveform instead of the sum of both
+*----------------
+* |	This version:   V1.1
+* | Date        :   2026-10-18
+* | Info        :
+* 1.Interactive jobs, bulk uploads are loaded in stripes and the
+*   interactive jobs of the panel go in between
+* -----------------------------------------------------------------------------
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documnetation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to  whom the Software is
+# furished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS OR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+# THE SOFTWARE.
+#
+******************************************************************************/
+#include "EPD_IT8951_Sched.h"
+
+
+/******************************************************************************
+function :	EPD_IT8951_Sched_Run
+parameter:
+Info:
+    Returns once the display command is out, the waveform keeps running
+******************************************************************************/
+static UBYTE EPD_IT8951_Sched_Run(IT8951_Dev* Dev, const IT8951_Sched_Job* Job)
+{
+    if(Job->Bits_Per_Pixel != IT8951_SCHED_CLEAR && Job->Frame_Buf == NULL)
+        return EPD_IT8951_Area_Refresh(Dev, Job->Bits_Per_Pixel, Job->X, Job->Y, Job->W, Job->H,
+                                       (Job->Bits_Per_Pixel == 1) ? Job->Mode : Dev->GC16_Mode, Job->Target_Memory_Addr);
+
+    switch(Job->Bits_Per_Pixel) {
+    case IT8951_SCHED_CLEAR:
+        return EPD_IT8951_Clear_Refresh(Dev, Job->Target_Memory_Addr, Job->Mode);
+    case 1:
+        return EPD_IT8951_1bp_Refresh(Dev, Job->Frame_Buf, Job->X, Job->Y, Job->W, Job->H, Job->Mode, Job->Target_Memory_Addr, true);
+    case 2:
+        return EPD_IT8951_2bp_Refresh(Dev, Job->Frame_Buf, Job->X, Job->Y, Job->W, Job->H, Job->Hold, Job->Target_Memory_Addr, true);
+    case 4:
+        return EPD_IT8951_4bp_Refresh(Dev, Job->Frame_Buf, Job->X, Job->Y, Job->W, Job->H, Job->Hold, Job->Target_Memory_Addr, true);
+    default:
+        return EPD_IT8951_8bp_Refresh(Dev, Job->Frame_Buf, Job->X, Job->Y, Job->W, Job->H, Job->Hold, Job->Target_Memory_Addr);
+    }
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Sched_Done
+parameter:
+Info:
+    With Sched->Lock held. Frees the job's slot and records its status.
+******************************************************************************/
+static void EPD_IT8951_Sched_Done(IT8951_Sched_Panel* Panel, UBYTE Class, UBYTE Status)
+{
+    if(Status != IT8951_OK && Panel->Error == IT8951_OK)
+        Panel->Error = Status;
+    Panel->Head[Class] = (Panel->Head[Class] + 1) % IT8951_SCHED_QUEUE;
+    Panel->Count[Class]--;
+    pthread_cond_broadcast(&Panel->Sched->Changed);
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Sched_Yield
+parameter:
+    Bulk : the job being loaded
+Info:
+    Issues the panel's queued interactive jobs, between two stripes of a
+    bulk upload. The areas they show are kept to be shown again on top of
+    the bulk job; once IT8951_SCHED_INK are kept, the rest waits for it.
+******************************************************************************/
+static void EPD_IT8951_Sched_Yield(IT8951_Sched_Panel* Panel, const IT8951_Sched_Job* Bulk)
+{
+    IT8951_Sched* Sched = Panel->Sched;
+    IT8951_Sched_Job Job;
+    UBYTE Status;
+
+    pthread_mutex_lock(&Sched->Lock);
+    while(Panel->Count[IT8951_SCHED_INTERACTIVE] != 0 && Panel->Ink_Count < IT8951_SCHED_INK)
+    {
+        Job = Panel->Queue[IT8951_SCHED_INTERACTIVE][Panel->Head[IT8951_SCHED_INTERACTIVE]];
+        pthread_mutex_unlock(&Sched->Lock);
+
+        Status = EPD_IT8951_Sched_Run(Panel->Dev, &Job);
+
+        //an area in the bulk job's buffer is shown with it anyway
+        if(Status == IT8951_OK && Job.Bits_Per_Pixel != IT8951_SCHED_CLEAR
+           && Job.Target_Memory_Addr != Bulk->Target_Memory_Addr) {
+            Job.Frame_Buf = NULL;
+            Panel->Ink[Panel->Ink_Count++] = Job;
+        }
+
+        pthread_mutex_lock(&Sched->Lock);
+        EPD_IT8951_Sched_Done(Panel, IT8951_SCHED_INTERACTIVE, Status);
+    }
+    pthread_mutex_unlock(&Sched->Lock);
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Sched_Run_Bulk
+parameter:
+Info:
+    A frame of more than IT8951_SCHED_STRIPE_BYTES is loaded a stripe at a
+    time with EPD_IT8951_Area_Write and shown once it is complete, so pen
+    ink waits for one stripe instead of the whole image. The ink shown in
+    between is shown again from its own buffer after the frame. Striped
+    frames go straight to Target_Memory_Addr, the pipeline is not used.
+******************************************************************************/
+static UBYTE EPD_IT8951_Sched_Run_Bulk(IT8951_Sched_Panel* Panel, const IT8951_Sched_Job* Job)
+{
+    IT8951_Dev* Dev = Panel->Dev;
+    UDOUBLE Row_Bytes = (UDOUBLE)Job->W * Job->Bits_Per_Pixel / 8;
+    UWORD Stripe_Rows;
+    UBYTE Status;
+
+    if(Job->Bits_Per_Pixel == IT8951_SCHED_CLEAR || Job->Frame_Buf == NULL || Row_Bytes == 0
+        || Row_Bytes * Job->H <= IT8951_SCHED_STRIPE_BYTES)
+        return EPD_IT8951_Sched_Run(Dev, Job);
+
+    Stripe_Rows = IT8951_SCHED_STRIPE_BYTES / Row_Bytes;
+    //turned a quarter, the rows of a 1bpp stripe are panel columns and
+    //want the alignment of its X and W, see EPD_IT8951_Set_Orientation
+    if(Job->Bits_Per_Pixel == 1 && (Dev->Load_Rotate & 1)) {
+        UWORD Align = Dev->Four_Byte_Align ? 32 : 16;
+        Stripe_Rows = (Stripe_Rows > Align) ? Stripe_Rows - Stripe_Rows % Align : Align;
+    }
+    if(Stripe_Rows == 0)
+        Stripe_Rows = 1;
+
+    Panel->Ink_Count = 0;
+    for(UWORD Row = 0; Row < Job->H; Row += Stripe_Rows)
+    {
+        UWORD Rows = (Job->H - Row < Stripe_Rows) ? Job->H - Row : Stripe_Rows;
+
+        EPD_IT8951_Sched_Yield(Panel, Job);
+        Status = EPD_IT8951_Area_Write(Dev, Job->Bits_Per_Pixel, Job->Frame_Buf + Row * Row_Bytes,
+                                       Job->X, Job->Y + Row, Job->W, Rows, Job->Target_Memory_Addr);
+        if(Status != IT8951_OK)
+            return Status;
+    }
+    EPD_IT8951_Sched_Yield(Panel, Job);
+
+    Status = EPD_IT8951_Area_Refresh(Dev, Job->Bits_Per_Pixel, Job->X, Job->Y, Job->W, Job->H,
+                                     (Job->Bits_Per_Pixel == 1) ? Job->Mode : Dev->GC16_Mode, Job->Target_Memory_Addr);
+    for(UBYTE i = 0; i < Panel->Ink_Count && Status == IT8951_OK; i++)
+        Status = EPD_IT8951_Sched_Run(Dev, &Panel->Ink[i]);
+    return Status;
+}
+
+
+static void* EPD_IT8951_Sched_Worker(void* Arg)
+{
+    IT8951_Sched_Panel* Panel = (IT8951_Sched_Panel*)Arg;
+    IT8951_Sched* Sched = Panel->Sched;
+    IT8951_Sched_Job Job;
+    UBYTE Class;
+    UBYTE Status;
+
+    pthread_mutex_lock(&Sched->Lock);
+    for(;;)
+    {
+        while(Panel->Count[IT8951_SCHED_INTERACTIVE] == 0 && Panel->Count[IT8951_SCHED_BULK] == 0 && !Sched->Stop)
+            pthread_cond_wait(&Sched->Changed, &Sched->Lock);
+        if(Panel->Count[IT8951_SCHED_INTERACTIVE] != 0)
+            Class = IT8951_SCHED_INTERACTIVE;
+        else if(Panel->Count[IT8951_SCHED_BULK] != 0)
+            Class = IT8951_SCHED_BULK;
+        else
+            break;
+
+        //the slot stays taken until the job is done, Flush counts on it
+        Job = Panel->Queue[Class][Panel->Head[Class]];
+        pthread_mutex_unlock(&Sched->Lock);
+
+        if(Class == IT8951_SCHED_INTERACTIVE)
+            Status = EPD_IT8951_Sched_Run(Panel->Dev, &Job);
+        else
+            Status = EPD_IT8951_Sched_Run_Bulk(Panel, &Job);
+
+        pthread_mutex_lock(&Sched->Lock);
+        EPD_IT8951_Sched_Done(Panel, Class, Status);
+    }
+    pthread_mutex_unlock(&Sched->Lock);
+    return NULL;
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Sched_Start
+parameter:
+    Devs  : opened and initialized panels, they must not share a CS pin
+    Count : up to IT8951_SCHED_PANELS
+Info:
+    return 0, or 1 when the workers could not be started
+******************************************************************************/
+UBYTE EPD_IT8951_Sched_Start(IT8951_Sched* Sched, IT8951_Dev** Devs, UBYTE Count)
+{
+    if(Count == 0 || Count > IT8951_SCHED_PANELS)
+        return 1;
+
+    memset(Sched, 0, sizeof(*Sched));
+    pthread_mutex_init(&Sched->Lock, NULL);
+    pthread_cond_init(&Sched->Changed, NULL);
+
+    for(UBYTE i = 0; i < Count; i++)
+    {
+        IT8951_Sched_Panel* Panel = &Sched->Panel[i];
+        Panel->Sched = Sched;
+        Panel->Dev = Devs[i];
+        if(pthread_create(&Panel->Thread, NULL, EPD_IT8951_Sched_Worker, Panel) != 0) {
+            Debug("Sched: cannot start the worker of panel %d\r\n", i);
+            EPD_IT8951_Sched_Stop(Sched);
+            return 1;
+        }
+        Sched->Panel_Count++;
+    }
+    return 0;
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Sched_Submit
+parameter:
+    Panel : index into the Devs given to EPD_IT8951_Sched_Start
+Info:
+    Queues the job and returns, blocks only while the panel's queue for
+    the job's priority is full. Jobs of one panel and priority run in
+    submission order.
+    return 0, or 1 for a bad panel or job
+******************************************************************************/
+UBYTE EPD_IT8951_Sched_Submit(IT8951_Sched* Sched, UBYTE Panel, const IT8951_Sched_Job* Job)
+{
+    IT8951_Sched_Panel* P;
+    UBYTE Bpp = Job->Bits_Per_Pixel;
+    UBYTE Class = Job->Priority;
+
+    if(Panel >= Sched->Panel_Count)
+        return 1;
+    if(Bpp != IT8951_SCHED_CLEAR && Bpp != 1 && Bpp != 2 && Bpp != 4 && Bpp != 8)
+        return 1;
+    if(Class >= IT8951_SCHED_CLASSES)
+        return 1;
+
+    P = &Sched->Panel[Panel];
+    pthread_mutex_lock(&Sched->Lock);
+    while(P->Count[Class] == IT8951_SCHED_QUEUE && !Sched->Stop)
+        pthread_cond_wait(&Sched->Changed, &Sched->Lock);
+    if(Sched->Stop) {
+        pthread_mutex_unlock(&Sched->Lock);
+        return 1;
+    }
+    P->Queue[Class][(P->Head[Class] + P->Count[Class]) % IT8951_SCHED_QUEUE] = *Job;
+    P->Count[Class]++;
+    pthread_cond_broadcast(&Sched->Changed);
+    pthread_mutex_unlock(&Sched->Lock);
+    return 0;
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Sched_Flush
+parameter:
+    Wait_Display : also wait until the waveforms have finished
+Info:
+    Until every submitted job was issued. Frame buffers can be reused
+    after it. Returns the first error any panel saw since the last flush.
+******************************************************************************/
+UBYTE EPD_IT8951_Sched_Flush(IT8951_Sched* Sched, bool Wait_Display)
+{
+    UBYTE Status = IT8951_OK;
+
+    pthread_mutex_lock(&Sched->Lock);
+    for(UBYTE i = 0; i < Sched->Panel_Count; i++)
+    {
+        IT8951_Sched_Panel* Panel = &Sched->Panel[i];
+        while(Panel->Count[IT8951_SCHED_INTERACTIVE] != 0 || Panel->Count[IT8951_SCHED_BULK] != 0)
+            pthread_cond_wait(&Sched->Changed, &Sched->Lock);
+        if(Status == IT8951_OK)
+            Status = Panel->Error;
+        Panel->Error = IT8951_OK;
+    }
+    pthread_mutex_unlock(&Sched->Lock);
+
+    for(UBYTE i = 0; Wait_Display && i < Sched->Panel_Count; i++)
+    {
+        UBYTE Wait_Status = EPD_IT8951_Wait_Display(Sched->Panel[i].Dev);
+        if(Status == IT8951_OK)
+            Status = Wait_Status;
+    }
+    return Status;
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Sched_Drain
+parameter:
+    Priority : IT8951_SCHED_BULK or IT8951_SCHED_INTERACTIVE
+Info:
+    Until no job of that priority is queued or being issued on any panel,
+    their frame buffers can be reused after it. Errors are left for
+    EPD_IT8951_Sched_Flush. Draining the interactive jobs waits for at
+    most one stripe of a bulk upload.
+******************************************************************************/
+void EPD_IT8951_Sched_Drain(IT8951_Sched* Sched, UBYTE Priority)
+{
+    if(Priority >= IT8951_SCHED_CLASSES)
+        return;
+
+    pthread_mutex_lock(&Sched->Lock);
+    for(UBYTE i = 0; i < Sched->Panel_Count; i++)
+    {
+        while(Sched->Panel[i].Count[Priority] != 0)
+            pthread_cond_wait(&Sched->Changed, &Sched->Lock);
+    }
+    pthread_mutex_unlock(&Sched->Lock);
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Sched_Stop
+parameter:
+Info:
+    Jobs already queued are still issued, then the workers exit
+******************************************************************************/
+void EPD_IT8951_Sched_Stop(IT8951_Sched* Sched)
+{
+    pthread_mutex_lock(&Sched->Lock);
+    Sched->Stop = true;
+    pthread_cond_broadcast(&Sched->Changed);
+    pthread_mutex_unlock(&Sched->Lock);
+
+    for(UBYTE i = 0; i < Sched->Panel_Count; i++)
+        pthread_join(Sched->Panel[i].Thread, NULL);
+    Sched->Panel_Count = 0;
+
+    pthread_cond_destroy(&Sched->Changed);
+    pthread_mutex_destroy(&Sched->Lock);
+}
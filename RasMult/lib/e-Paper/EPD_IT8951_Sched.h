@@ -0,0 +1,99 @@
+/*****************************************************************************
+* | File      	:   EPD_IT8951_Sched.h
+* | Author      :   IT8951-ePaper contributors
+* | Function    :   Refresh scheduler for several IT8951 panels on one SPI bus
+* | Info        :
+*----------------
+* |	This version:   V1.0
+* | Date        :   2026-10-18
+* | Info        :
+* -----------------------------------------------------------------------------
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documnetation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to  whom the Software is
+# furished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS OR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+# THE SOFTWARE.
+#
+******************************************************************************/
+#ifndef __EPD_IT8951_SCHED_H_
+#define __EPD_IT8951_SCHED_H_
+
+#include "EPD_IT8951.h"
+
+#define IT8951_SCHED_PANELS        3       //EPD_CS_PIN_1..3
+#define IT8951_SCHED_QUEUE         8       //jobs waiting per panel
+
+//Bits_Per_Pixel of a job that runs EPD_IT8951_Clear_Refresh
+#define IT8951_SCHED_CLEAR         0
+
+//Job priority, interactive jobs go ahead of queued bulk ones and in
+//between the stripes of the one being loaded
+#define IT8951_SCHED_BULK          0
+#define IT8951_SCHED_INTERACTIVE   1
+#define IT8951_SCHED_CLASSES       2
+
+//bulk uploads are loaded in stripes of about this many bytes
+#define IT8951_SCHED_STRIPE_BYTES  32768
+//interactive areas shown between the stripes of one bulk upload and again
+//on top of it, further interactive jobs wait for the bulk job
+#define IT8951_SCHED_INK           32
+
+typedef struct IT8951_Sched_Job
+{
+    UBYTE Bits_Per_Pixel;       //1, 2, 4, 8 or IT8951_SCHED_CLEAR
+    UBYTE* Frame_Buf;           //read by the worker, keep it until the flush;
+                                //NULL shows what Target_Memory_Addr holds
+    UWORD X;
+    UWORD Y;
+    UWORD W;
+    UWORD H;
+    UBYTE Mode;                 //1bpp and clear only, the others use GC16_Mode
+    bool Hold;
+    UDOUBLE Target_Memory_Addr;
+    UBYTE Priority;             //IT8951_SCHED_BULK or IT8951_SCHED_INTERACTIVE;
+                                //interactive jobs keep their pixels over a bulk
+                                //upload only in another Target_Memory_Addr
+}IT8951_Sched_Job;
+
+typedef struct IT8951_Sched_Panel
+{
+    struct IT8951_Sched* Sched;
+    IT8951_Dev* Dev;
+    pthread_t Thread;
+    IT8951_Sched_Job Queue[IT8951_SCHED_CLASSES][IT8951_SCHED_QUEUE];
+    UBYTE Head[IT8951_SCHED_CLASSES];
+    UBYTE Count[IT8951_SCHED_CLASSES];  //queued, the one being issued included
+    UBYTE Error;                //first failure since the last flush
+    IT8951_Sched_Job Ink[IT8951_SCHED_INK];    //worker only, display-only copies
+    UBYTE Ink_Count;
+}IT8951_Sched_Panel;
+
+typedef struct IT8951_Sched
+{
+    IT8951_Sched_Panel Panel[IT8951_SCHED_PANELS];
+    UBYTE Panel_Count;
+    bool Stop;
+    pthread_mutex_t Lock;
+    pthread_cond_t Changed;     //a queue grew or shrank, or Stop was set
+}IT8951_Sched;
+
+UBYTE EPD_IT8951_Sched_Start(IT8951_Sched* Sched, IT8951_Dev** Devs, UBYTE Count);
+UBYTE EPD_IT8951_Sched_Submit(IT8951_Sched* Sched, UBYTE Panel, const IT8951_Sched_Job* Job);
+UBYTE EPD_IT8951_Sched_Flush(IT8951_Sched* Sched, bool Wait_Display);
+void EPD_IT8951_Sched_Drain(IT8951_Sched* Sched, UBYTE Priority);
+void EPD_IT8951_Sched_Stop(IT8951_Sched* Sched);
+
+#endif
@@ -0,0 +1,300 @@
+/*****************************************************************************
+* | File      	:   EPD_IT8951_Scroll.c
+* | Author      :   IT8951-ePaper contributors
+* | Function    :   Scrolling a picture held in IT8951 memory
+* | Info        :
+*                The picture, taller or wider than the viewport, is kept in
+*                an image buffer at the buffer pitch, picture row n being
+*                buffer row Y + n. DPY_BUF_AREA takes the buffer address,
+*                so a scroll step only moves that address: one display
+*                command and its waveform, no pixels. Parts of the picture
+*                the viewport has not shown before are drawn by the caller
+*                and loaded first, everything loaded stays for later steps.
+*----------------
+* |	This version:   V1.0
+* | Date        :   2026-10-18
+* | Info        :
+* -----------------------------------------------------------------------------
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documnetation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to  whom the Software is
+# furished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS OR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+# THE SOFTWARE.
+#
+******************************************************************************/
+#include "EPD_IT8951_Scroll.h"
+#include <stdlib.h>
+#include <string.h>
+
+
+/******************************************************************************
+function :	EPD_IT8951_Scroll_Step
+parameter:
+Info:
+    Loads start and end on whole words of the buffer, for 1bpp on the
+    alignment of the 1bpp refreshes
+******************************************************************************/
+static UWORD EPD_IT8951_Scroll_Step(IT8951_Scroll* Scroll)
+{
+    if(Scroll->Bits_Per_Pixel == 1)
+        return Scroll->Dev->Four_Byte_Align ? 32 : 16;
+    return 16 / Scroll->Bits_Per_Pixel;
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Scroll_Mem_X
+parameter:
+Info:
+    Buffer bytes taken by Pixels pixels, the 1bpp trick puts 8 in a byte
+******************************************************************************/
+static UDOUBLE EPD_IT8951_Scroll_Mem_X(IT8951_Scroll* Scroll, UDOUBLE Pixels)
+{
+    return (Scroll->Bits_Per_Pixel == 1) ? (Pixels + 7) / 8 : Pixels;
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Scroll_Load
+parameter:
+    Frame_Buf : the picture area, NULL to have Draw make it
+Info:
+    Picture pixel (Image_X, Image_Y) goes to buffer pixel
+    (X + Image_X, Y + Image_Y); the rows are reached through the address
+    so the area stays within the panel coordinates.
+******************************************************************************/
+static UBYTE EPD_IT8951_Scroll_Load(IT8951_Scroll* Scroll, UBYTE* Frame_Buf, UWORD Image_X, UWORD Image_Y, UWORD W, UWORD H)
+{
+    UDOUBLE Line = ((UDOUBLE)W * Scroll->Bits_Per_Pixel + 7) / 8;
+    UBYTE* Buf = Frame_Buf;
+    UBYTE Status;
+
+    if(W == 0 || H == 0)
+        return IT8951_OK;
+
+    if(Buf == NULL) {
+        Buf = malloc(Line * H);
+        if(Buf == NULL) {
+            Debug("Scroll: out of memory\r\n");
+            return IT8951_ERR_NOT_RUNNING;
+        }
+        memset(Buf, 0xFF, Line * H);
+        Scroll->Draw(Scroll->User, Buf, Image_X, Image_Y, W, H);
+        Scroll->Drawn_Pixels += (UDOUBLE)W * H;
+    }
+
+    Status = EPD_IT8951_Area_Write(Scroll->Dev, Scroll->Bits_Per_Pixel, Buf, Scroll->X + Image_X, Scroll->Y, W, H,
+                                   Scroll->Base_Addr + (UDOUBLE)Image_Y * Scroll->Dev->Image_Pitch);
+
+    if(Buf != Frame_Buf)
+        free(Buf);
+    return Status;
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Scroll_Open
+parameter:
+    Base_Addr      : image buffer with room for Y + Image_H rows at the
+                     pitch, not the one other refreshes load into;
+                     EPD_IT8951_Pool_Alloc for X, Y, Image_W, Image_H
+                     gives one
+    Bits_Per_Pixel : 1, 2, 4 or 8, as for EPD_IT8951_Area_Write
+    X, Y, W, H     : viewport on the panel
+    Image_W        : the picture; X + Image_W must fit the pitch, in
+    Image_H          bytes for 1bpp, so 1bpp pictures may be up to eight
+                     panels wide
+    Draw           : called for the parts that get shown, NULL when the
+                     caller loads the whole picture with EPD_IT8951_Scroll_Write
+Info:
+    X and Image_W in multiples of 16 pixels for 1bpp (32 on
+    Four_Byte_Align panels), of one word otherwise. On a mirrored canvas
+    the picture runs right to left in the buffer and has to fit left of
+    the canvas edge; turned canvases are not supported. Nothing is shown
+    yet. Returns 1 when the picture does not fit that.
+******************************************************************************/
+UBYTE EPD_IT8951_Scroll_Open(IT8951_Scroll* Scroll, IT8951_Dev* Dev, UDOUBLE Base_Addr, UBYTE Bits_Per_Pixel, UWORD X, UWORD Y, UWORD W, UWORD H, UWORD Image_W, UWORD Image_H, IT8951_Scroll_Draw Draw, void* User)
+{
+    UWORD Step, Canvas_W, Canvas_H;
+
+    memset(Scroll, 0, sizeof(*Scroll));
+    Scroll->Dev = Dev;
+    Scroll->Base_Addr = Base_Addr;
+    Scroll->Bits_Per_Pixel = Bits_Per_Pixel;
+    Scroll->X = X;
+    Scroll->Y = Y;
+    Scroll->W = W;
+    Scroll->H = H;
+    Scroll->Image_W = Image_W;
+    Scroll->Image_H = Image_H;
+    Scroll->Draw = Draw;
+    Scroll->User = User;
+
+    Step = EPD_IT8951_Scroll_Step(Scroll);
+    if(W > Image_W || H > Image_H || X % Step != 0 || Image_W % Step != 0
+       || EPD_IT8951_Scroll_Mem_X(Scroll, (UDOUBLE)X + Image_W) > Dev->Image_Pitch) {
+        Debug("Scroll: %dx%d picture does not fit the buffer at %d\r\n", Image_W, Image_H, X);
+        return 1;
+    }
+    EPD_IT8951_Get_Canvas_Size(Dev, &Canvas_W, &Canvas_H);
+    if(Dev->Load_Rotate != IT8951_ROTATE_0 || (Dev->Load_Mirror && (UDOUBLE)X + Image_W > Canvas_W)) {
+        Debug("Scroll: %dx%d picture does not fit the canvas orientation\r\n", Image_W, Image_H);
+        return 1;
+    }
+
+    if(Draw == NULL) {
+        Scroll->Valid_X1 = Image_W;
+        Scroll->Valid_Y1 = Image_H;
+    }
+    return 0;
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Scroll_Write
+parameter:
+    Frame_Buf : W x H, laid out as for EPD_IT8951_Area_Write
+Info:
+    Loads part of the picture, Image_X and W aligned like in
+    EPD_IT8951_Scroll_Open. Also for redrawing a part that changed, the
+    next step that shows it picks it up.
+******************************************************************************/
+UBYTE EPD_IT8951_Scroll_Write(IT8951_Scroll* Scroll, UBYTE* Frame_Buf, UWORD Image_X, UWORD Image_Y, UWORD W, UWORD H)
+{
+    UWORD X1 = Image_X + W, Y1 = Image_Y + H;
+    UBYTE Status;
+
+    Status = EPD_IT8951_Scroll_Load(Scroll, Frame_Buf, Image_X, Image_Y, W, H);
+    if(Status != IT8951_OK)
+        return Status;
+
+    //the loaded part stays one rectangle, whatever does not join it is
+    //just not counted
+    if(Scroll->Valid_X0 == Scroll->Valid_X1
+       || (Image_X <= Scroll->Valid_X0 && X1 >= Scroll->Valid_X1 && Image_Y <= Scroll->Valid_Y0 && Y1 >= Scroll->Valid_Y1)) {
+        Scroll->Valid_X0 = Image_X;
+        Scroll->Valid_Y0 = Image_Y;
+        Scroll->Valid_X1 = X1;
+        Scroll->Valid_Y1 = Y1;
+    } else if(Image_X == Scroll->Valid_X0 && X1 == Scroll->Valid_X1 && Image_Y <= Scroll->Valid_Y1 && Y1 >= Scroll->Valid_Y0) {
+        if(Image_Y < Scroll->Valid_Y0)
+            Scroll->Valid_Y0 = Image_Y;
+        if(Y1 > Scroll->Valid_Y1)
+            Scroll->Valid_Y1 = Y1;
+    } else if(Image_Y == Scroll->Valid_Y0 && Y1 == Scroll->Valid_Y1 && Image_X <= Scroll->Valid_X1 && X1 >= Scroll->Valid_X0) {
+        if(Image_X < Scroll->Valid_X0)
+            Scroll->Valid_X0 = Image_X;
+        if(X1 > Scroll->Valid_X1)
+            Scroll->Valid_X1 = X1;
+    }
+    return IT8951_OK;
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Scroll_Invalidate
+parameter:
+Info:
+    The whole picture changed, Draw is asked again for what gets shown
+******************************************************************************/
+void EPD_IT8951_Scroll_Invalidate(IT8951_Scroll* Scroll)
+{
+    if(Scroll->Draw != NULL) {
+        Scroll->Valid_X0 = Scroll->Valid_X1 = 0;
+        Scroll->Valid_Y0 = Scroll->Valid_Y1 = 0;
+    }
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Scroll_To
+parameter:
+    Scroll_X, Scroll_Y : picture pixel for the top left of the viewport,
+                         clipped to the picture; for 1bpp Scroll_X goes
+                         down to a multiple of 8
+    Mode               : waveform, A2_Mode for ink
+Info:
+    Loads what the viewport has not shown yet, together with what lies
+    between it and the loaded part, then shows the viewport from the
+    buffer address of its first pixel. A jump clear of the loaded part
+    starts over from the viewport alone.
+******************************************************************************/
+UBYTE EPD_IT8951_Scroll_To(IT8951_Scroll* Scroll, UWORD Scroll_X, UWORD Scroll_Y, UBYTE Mode)
+{
+    UWORD Step = EPD_IT8951_Scroll_Step(Scroll);
+    UWORD X0, Y0, X1, Y1;
+    UDOUBLE Addr;
+    UBYTE Status = IT8951_OK;
+
+    if(Scroll_X > Scroll->Image_W - Scroll->W)
+        Scroll_X = Scroll->Image_W - Scroll->W;
+    if(Scroll_Y > Scroll->Image_H - Scroll->H)
+        Scroll_Y = Scroll->Image_H - Scroll->H;
+    if(Scroll->Bits_Per_Pixel == 1)
+        Scroll_X -= Scroll_X % 8;
+    Scroll->Scroll_X = Scroll_X;
+    Scroll->Scroll_Y = Scroll_Y;
+
+    X0 = Scroll_X - Scroll_X % Step;
+    Y0 = Scroll_Y;
+    X1 = (Scroll_X + Scroll->W + Step - 1) / Step * Step;
+    Y1 = Scroll_Y + Scroll->H;
+
+    if(X0 < Scroll->Valid_X0 || Y0 < Scroll->Valid_Y0 || X1 > Scroll->Valid_X1 || Y1 > Scroll->Valid_Y1)
+    {
+        if(X0 > Scroll->Valid_X1 || X1 < Scroll->Valid_X0 || Y0 > Scroll->Valid_Y1 || Y1 < Scroll->Valid_Y0
+           || Scroll->Valid_X0 == Scroll->Valid_X1) {
+            Status = EPD_IT8951_Scroll_Load(Scroll, NULL, X0, Y0, X1 - X0, Y1 - Y0);
+        } else {
+            if(X0 > Scroll->Valid_X0)
+                X0 = Scroll->Valid_X0;
+            if(Y0 > Scroll->Valid_Y0)
+                Y0 = Scroll->Valid_Y0;
+            if(X1 < Scroll->Valid_X1)
+                X1 = Scroll->Valid_X1;
+            if(Y1 < Scroll->Valid_Y1)
+                Y1 = Scroll->Valid_Y1;
+
+            //above and below across the new width, left and right beside
+            //the loaded rows
+            if(Status == IT8951_OK)
+                Status = EPD_IT8951_Scroll_Load(Scroll, NULL, X0, Y0, X1 - X0, Scroll->Valid_Y0 - Y0);
+            if(Status == IT8951_OK)
+                Status = EPD_IT8951_Scroll_Load(Scroll, NULL, X0, Scroll->Valid_Y1, X1 - X0, Y1 - Scroll->Valid_Y1);
+            if(Status == IT8951_OK)
+                Status = EPD_IT8951_Scroll_Load(Scroll, NULL, X0, Scroll->Valid_Y0, Scroll->Valid_X0 - X0, Scroll->Valid_Y1 - Scroll->Valid_Y0);
+            if(Status == IT8951_OK)
+                Status = EPD_IT8951_Scroll_Load(Scroll, NULL, Scroll->Valid_X1, Scroll->Valid_Y0, X1 - Scroll->Valid_X1, Scroll->Valid_Y1 - Scroll->Valid_Y0);
+        }
+        if(Status != IT8951_OK) {
+            EPD_IT8951_Scroll_Invalidate(Scroll);
+            return Status;
+        }
+        Scroll->Valid_X0 = X0;
+        Scroll->Valid_Y0 = Y0;
+        Scroll->Valid_X1 = X1;
+        Scroll->Valid_Y1 = Y1;
+    }
+
+    //mirrored, the picture runs right to left in the buffer, so scrolling
+    //right moves the viewport's source left
+    Addr = Scroll->Base_Addr + (UDOUBLE)Scroll_Y * Scroll->Dev->Image_Pitch;
+    if(Scroll->Dev->Load_Mirror)
+        Addr -= EPD_IT8951_Scroll_Mem_X(Scroll, Scroll_X);
+    else
+        Addr += EPD_IT8951_Scroll_Mem_X(Scroll, Scroll_X);
+    return EPD_IT8951_Area_Refresh(Scroll->Dev, Scroll->Bits_Per_Pixel, Scroll->X, Scroll->Y, Scroll->W, Scroll->H, Mode, Addr);
+}
@@ -0,0 +1,70 @@
+/*****************************************************************************
+* | File      	:   EPD_IT8951_Scroll.h
+* | Author      :   IT8951-ePaper contributors
+* | Function    :   Scrolling a picture held in IT8951 memory
+* | Info        :
+*----------------
+* |	This version:   V1.0
+* | Date        :   2026-10-18
+* | Info        :
+* -----------------------------------------------------------------------------
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documnetation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to  whom the Software is
+# furished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS OR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+# THE SOFTWARE.
+#
+******************************************************************************/
+#ifndef __EPD_IT8951_SCROLL_H_
+#define __EPD_IT8951_SCROLL_H_
+
+#include "EPD_IT8951.h"
+
+//draws part of the picture into Buf, W x H pixels laid out like a Paint
+//image of the scroll's Bits_Per_Pixel, white when it is called
+typedef void (*IT8951_Scroll_Draw)(void* User, UBYTE* Buf, UWORD Image_X, UWORD Image_Y, UWORD W, UWORD H);
+
+typedef struct IT8951_Scroll
+{
+    IT8951_Dev* Dev;
+    UDOUBLE Base_Addr;          //image buffer the picture is kept in
+    UBYTE Bits_Per_Pixel;
+    UWORD X;                    //viewport on the panel
+    UWORD Y;
+    UWORD W;
+    UWORD H;
+    UWORD Image_W;
+    UWORD Image_H;
+    UWORD Scroll_X;             //picture pixel at the top left of the viewport
+    UWORD Scroll_Y;
+    IT8951_Scroll_Draw Draw;
+    void* User;
+
+    //part of the picture already in the buffer, empty when X0 == X1
+    UWORD Valid_X0;
+    UWORD Valid_Y0;
+    UWORD Valid_X1;
+    UWORD Valid_Y1;
+
+    UDOUBLE Drawn_Pixels;       //by Draw, since EPD_IT8951_Scroll_Open
+}IT8951_Scroll;
+
+UBYTE EPD_IT8951_Scroll_Open(IT8951_Scroll* Scroll, IT8951_Dev* Dev, UDOUBLE Base_Addr, UBYTE Bits_Per_Pixel, UWORD X, UWORD Y, UWORD W, UWORD H, UWORD Image_W, UWORD Image_H, IT8951_Scroll_Draw Draw, void* User);
+UBYTE EPD_IT8951_Scroll_Write(IT8951_Scroll* Scroll, UBYTE* Frame_Buf, UWORD Image_X, UWORD Image_Y, UWORD W, UWORD H);
+void EPD_IT8951_Scroll_Invalidate(IT8951_Scroll* Scroll);
+UBYTE EPD_IT8951_Scroll_To(IT8951_Scroll* Scroll, UWORD Scroll_X, UWORD Scroll_Y, UBYTE Mode);
+
+#endif
@@ -0,0 +1,140 @@
+/*****************************************************************************
+* | File      	:   EPD_IT8951_State.c
+* | Author      :   IT8951-ePaper contributors
+* | Function    :   Warm restart state for the IT8951
+* | Info        :
+*                What a restart needs to take over a running controller:
+*                the device info and the host copy of the panel image
+*----------------
+* |	This version:   V1.0
+* | Date        :   2026-10-18
+* | Info        :
+* -----------------------------------------------------------------------------
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documnetation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to  whom the Software is
+# furished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS OR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+# THE SOFTWARE.
+#
+******************************************************************************/
+#include "EPD_IT8951_State.h"
+
+#include <stdio.h>
+
+typedef struct IT8951_State_Header
+{
+    UDOUBLE Magic;
+    IT8951_Dev_Info Dev_Info;
+    UDOUBLE Image_Size;
+}IT8951_State_Header;
+
+
+/******************************************************************************
+function :	EPD_IT8951_Save_State
+parameter:
+    Image      : host copy of what the panel shows, in any format the
+                 caller likes, may be NULL
+    Image_Size : bytes
+Info:
+    Written through a temporary and renamed, so a restart never sees half
+    a file
+******************************************************************************/
+UBYTE EPD_IT8951_Save_State(const char* Path, IT8951_Dev_Info* Dev_Info, UBYTE* Image, UDOUBLE Image_Size)
+{
+    IT8951_State_Header Header;
+    char Tmp_Path[256];
+    FILE* File;
+    bool Good;
+
+    memset(&Header, 0, sizeof(Header));
+    Header.Magic = IT8951_STATE_MAGIC;
+    Header.Dev_Info = *Dev_Info;
+    Header.Image_Size = (Image != NULL) ? Image_Size : 0;
+
+    snprintf(Tmp_Path, sizeof(Tmp_Path), "%s.tmp", Path);
+    File = fopen(Tmp_Path, "wb");
+    if(File == NULL) {
+        Debug("State: cannot write %s\r\n", Tmp_Path);
+        return 1;
+    }
+    Good = fwrite(&Header, sizeof(Header), 1, File) == 1;
+    if(Good && Header.Image_Size != 0)
+        Good = fwrite(Image, Header.Image_Size, 1, File) == 1;
+    if(fclose(File) != 0 || !Good || rename(Tmp_Path, Path) != 0) {
+        Debug("State: cannot replace %s\r\n", Path);
+        remove(Tmp_Path);
+        return 1;
+    }
+    return 0;
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Load_State
+parameter:
+    Image      : receives the stored image, NULL reads the device info only
+    Image_Size : must match what was saved
+Info:
+    0 when the state was read
+******************************************************************************/
+UBYTE EPD_IT8951_Load_State(const char* Path, IT8951_Dev_Info* Dev_Info, UBYTE* Image, UDOUBLE Image_Size)
+{
+    IT8951_State_Header Header;
+    FILE* File;
+    bool Good;
+
+    File = fopen(Path, "rb");
+    if(File == NULL)
+        return 1;
+
+    Good = fread(&Header, sizeof(Header), 1, File) == 1 && Header.Magic == IT8951_STATE_MAGIC;
+    if(Good && Image != NULL)
+        Good = Header.Image_Size == Image_Size && fread(Image, Image_Size, 1, File) == 1;
+    fclose(File);
+
+    if(!Good)
+        return 1;
+    if(Dev_Info != NULL)
+        *Dev_Info = Header.Dev_Info;
+    return 0;
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Warm_Init
+parameter:
+    Path : state file written by EPD_IT8951_Save_State before the last exit
+    Warm : true when the controller was taken over as it was
+Info:
+    Drop-in for EPD_IT8951_Init. Falls back to it when there is no state
+    or the controller went through a reset; the caller has to clear and
+    repaint the panel in that case only.
+******************************************************************************/
+IT8951_Dev_Info EPD_IT8951_Warm_Init(IT8951_Dev* Dev, UWORD VCOM, const char* Path, bool* Warm)
+{
+    IT8951_Dev_Info Dev_Info;
+
+    *Warm = false;
+    if(EPD_IT8951_Load_State(Path, &Dev_Info, NULL, 0) == 0
+        && EPD_IT8951_Attach(Dev, Dev_Info, VCOM) == IT8951_OK) {
+        Debug("Attached to the running controller\r\n");
+        *Warm = true;
+        return Dev_Info;
+    }
+
+    Debug("Cold start\r\n");
+    return EPD_IT8951_Init(Dev, VCOM);
+}
@@ -0,0 +1,45 @@
+/*****************************************************************************
+* | File      	:   EPD_IT8951_State.h
+* | Author      :   IT8951-ePaper contributors
+* | Function    :   Warm restart state for the IT8951
+* | Info        :
+*----------------
+* |	This version:   V1.0
+* | Date        :   2026-10-18
+* | Info        :
+* -----------------------------------------------------------------------------
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documnetation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to  whom the Software is
+# furished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS OR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+# THE SOFTWARE.
+#
+******************************************************************************/
+#ifndef __EPD_IT8951_STATE_H_
+#define __EPD_IT8951_STATE_H_
+
+#include "EPD_IT8951.h"
+
+//State file, %d is the screen number
+#define IT8951_STATE_PATH          "/var/tmp/it8951_state.%d"
+#define IT8951_STATE_MAGIC         0x49543853     //"IT8S"
+
+UBYTE EPD_IT8951_Save_State(const char* Path, IT8951_Dev_Info* Dev_Info, UBYTE* Image, UDOUBLE Image_Size);
+UBYTE EPD_IT8951_Load_State(const char* Path, IT8951_Dev_Info* Dev_Info, UBYTE* Image, UDOUBLE Image_Size);
+
+IT8951_Dev_Info EPD_IT8951_Warm_Init(IT8951_Dev* Dev, UWORD VCOM, const char* Path, bool* Warm);
+
+#endif
@@ -0,0 +1,385 @@
+/*****************************************************************************
+* | File      	:   EPD_IT8951_Tune.c
+* | Author      :   IT8951-ePaper contributors
+* | Function    :   SPI clock autotuner for the IT8951
+* | Info        :
+*                Steps the SPI clock up until register and memory round
+*                trips stop verifying, separately for the write and the
+*                read direction, and keeps the result per panel
+*----------------
+* |	This version:   V1.0
+* | Date        :   2026-10-18
+* | Info        :
+* -----------------------------------------------------------------------------
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documnetation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to  whom the Software is
+# furished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS OR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+# THE SOFTWARE.
+#
+******************************************************************************/
+#include "EPD_IT8951_Tune.h"
+
+#include <stdio.h>
+#include <ctype.h>
+
+//Clock steps, the core clock (250MHz) over even bcm2835 dividers 64..6
+static const UDOUBLE Tune_Steps[] = {
+    3906250, 7812500, 10416666, 12500000, 15625000,
+    20833333, 25000000, 31250000, 41666666,
+};
+#define TUNE_STEP_COUNT (sizeof(Tune_Steps)/sizeof(Tune_Steps[0]))
+
+//LISAR low word is only latched by the next LD_IMG, any value is harmless
+static const UWORD Tune_Reg_Pattern[] = {0xA55A, 0x5AA5, 0xFFFF, 0x0000};
+
+
+/******************************************************************************
+function :	EPD_IT8951_Tune_Speed
+parameter:
+Info:
+    The handle's clocks, taken over by the bus on its next transaction
+******************************************************************************/
+static void EPD_IT8951_Tune_Speed(IT8951_Dev* Dev, UDOUBLE Write_Hz, UDOUBLE Read_Hz)
+{
+    Dev->SPI_Write_Hz = Write_Hz;
+    Dev->SPI_Read_Hz = Read_Hz;
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Tune_Check
+parameter:
+    Seed : varies the burst pattern between passes
+Info:
+    One register write/read-back per pattern and one burst write/read
+    through Scratch_Addr, at whatever clocks are set
+******************************************************************************/
+static bool EPD_IT8951_Tune_Check(IT8951_Dev* Dev, UDOUBLE Scratch_Addr, UDOUBLE Seed)
+{
+    UWORD Tune_Tx[IT8951_TUNE_WORDS];
+    UWORD Tune_Rx[IT8951_TUNE_WORDS];
+    UDOUBLE X = Seed | 1;
+
+    for(UWORD i = 0; i < sizeof(Tune_Reg_Pattern)/sizeof(Tune_Reg_Pattern[0]); i++)
+    {
+        //both directions have to cross the bus, not the shadow
+        EPD_IT8951_Invalidate_Reg_Cache(Dev);
+        if(EPD_IT8951_Write_Reg(Dev, LISAR, Tune_Reg_Pattern[i]) != IT8951_OK)
+            return false;
+        EPD_IT8951_Invalidate_Reg_Cache(Dev);
+        if(EPD_IT8951_Read_Reg(Dev, LISAR) != Tune_Reg_Pattern[i] || EPD_IT8951_Get_Error(Dev) != IT8951_OK)
+            return false;
+    }
+
+    for(UDOUBLE i = 0; i < IT8951_TUNE_WORDS; i++)
+    {
+        X ^= X << 13;
+        X ^= X >> 17;
+        X ^= X << 5;
+        Tune_Tx[i] = (UWORD)X;
+    }
+    memset(Tune_Rx, 0, sizeof(Tune_Rx));
+
+    if(EPD_IT8951_Mem_Burst_Write(Dev, Scratch_Addr, Tune_Tx, IT8951_TUNE_WORDS) != IT8951_OK)
+        return false;
+    if(EPD_IT8951_Mem_Burst_Read(Dev, Scratch_Addr, Tune_Rx, IT8951_TUNE_WORDS) != IT8951_OK)
+        return false;
+    return memcmp(Tune_Tx, Tune_Rx, sizeof(Tune_Tx)) == 0;
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Tune_Recover
+parameter:
+Info:
+    Back to the base clock after a failed step. A garbled transfer can leave
+    the controller waiting for arguments, SYS_RUN plus a clean check at the
+    base clock shows it is listening again.
+******************************************************************************/
+static bool EPD_IT8951_Tune_Recover(IT8951_Dev* Dev, UDOUBLE Scratch_Addr)
+{
+    EPD_IT8951_Tune_Speed(Dev, Tune_Steps[0], Tune_Steps[0]);
+    EPD_IT8951_Invalidate_Reg_Cache(Dev);
+
+    for(UBYTE Retry = 0; Retry < IT8951_TUNE_REPEAT; Retry++)
+    {
+        EPD_IT8951_SystemRun(Dev);
+        if(EPD_IT8951_Tune_Check(Dev, Scratch_Addr, 0x1234567 + Retry))
+            return true;
+    }
+    return false;
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Tune_Phase
+parameter:
+    Write_Phase : step the write clock with reads at the base clock, or
+                  the other way round
+Info:
+    Returns the index of the safe step, one below the last passing step
+    whether or not a failure was seen: the top step passing says nothing
+    about its margin. Tune_Steps[0] is assumed good, the caller has
+    checked it.
+******************************************************************************/
+static int EPD_IT8951_Tune_Phase(IT8951_Dev* Dev, UDOUBLE Scratch_Addr, bool Write_Phase, bool* Recovered)
+{
+    int Pass = 0;
+
+    for(UWORD Step = 1; Step < TUNE_STEP_COUNT; Step++)
+    {
+        bool Good = true;
+
+        if(Write_Phase)
+            EPD_IT8951_Tune_Speed(Dev, Tune_Steps[Step], Tune_Steps[0]);
+        else
+            EPD_IT8951_Tune_Speed(Dev, Tune_Steps[0], Tune_Steps[Step]);
+
+        for(UBYTE Repeat = 0; Repeat < IT8951_TUNE_REPEAT && Good; Repeat++)
+            Good = EPD_IT8951_Tune_Check(Dev, Scratch_Addr, (Step << 8) + Repeat + 1);
+
+        Debug("SPI %s %lu Hz: %s\r\n", Write_Phase ? "write" : "read",
+              (unsigned long)Tune_Steps[Step], Good ? "ok" : "failed");
+
+        if(!Good) {
+            *Recovered = EPD_IT8951_Tune_Recover(Dev, Scratch_Addr);
+            return Pass > 0 ? Pass - 1 : 0;
+        }
+        Pass = Step;
+    }
+
+    EPD_IT8951_Tune_Speed(Dev, Tune_Steps[0], Tune_Steps[0]);
+    *Recovered = true;
+    return Pass > 0 ? Pass - 1 : 0;
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Tune_SPI
+parameter:
+    Scratch_Addr : IT8951_TUNE_WORDS*2 bytes of controller memory that are
+                   not being displayed, overwritten
+    Profile      : receives the chosen clocks
+Info:
+    Takes a few seconds at most. The chosen clocks are the handle's on
+    return; on failure the base clock is kept and Profile holds it too.
+******************************************************************************/
+UBYTE EPD_IT8951_Tune_SPI(IT8951_Dev* Dev, UDOUBLE Scratch_Addr, IT8951_SPI_Profile* Profile)
+{
+    UDOUBLE Busy_ms, Display_ms;
+    bool Recovered = true;
+    int Write_Step = 0, Read_Step = 0;
+    UBYTE Status = IT8951_OK;
+
+    //other threads stay off the panel while its clocks are out of spec
+    pthread_mutex_lock(&Dev->Lock);
+
+    EPD_IT8951_Get_Busy_Timeout(Dev, &Busy_ms, &Display_ms);
+    EPD_IT8951_Set_Busy_Timeout(Dev, IT8951_TUNE_BUSY_MS, Display_ms);
+
+    EPD_IT8951_Tune_Speed(Dev, Tune_Steps[0], Tune_Steps[0]);
+    if(!EPD_IT8951_Tune_Check(Dev, Scratch_Addr, 1)) {
+        Debug("SPI tune: no clean round trip at the base clock\r\n");
+        Status = IT8951_ERR_BUSY_TIMEOUT;
+    }
+
+    if(Status == IT8951_OK)
+        Write_Step = EPD_IT8951_Tune_Phase(Dev, Scratch_Addr, true, &Recovered);
+    if(Status == IT8951_OK && Recovered)
+        Read_Step = EPD_IT8951_Tune_Phase(Dev, Scratch_Addr, false, &Recovered);
+    if(Status == IT8951_OK && !Recovered) {
+        Debug("SPI tune: controller did not come back at the base clock\r\n");
+        Status = IT8951_ERR_BUSY_TIMEOUT;
+    }
+
+    if(Status != IT8951_OK)
+        Write_Step = Read_Step = 0;
+
+    Profile->Write_Hz = Tune_Steps[Write_Step];
+    Profile->Read_Hz = Tune_Steps[Read_Step];
+    EPD_IT8951_Tune_Speed(Dev, Profile->Write_Hz, Profile->Read_Hz);
+
+    //LISAR was used as scratch
+    EPD_IT8951_Invalidate_Reg_Cache(Dev);
+    EPD_IT8951_Set_Busy_Timeout(Dev, Busy_ms, Display_ms);
+
+    Debug("SPI tune: write %lu Hz, read %lu Hz\r\n",
+          (unsigned long)Profile->Write_Hz, (unsigned long)Profile->Read_Hz);
+    pthread_mutex_unlock(&Dev->Lock);
+    return Status;
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Profile_Key
+parameter:
+Info:
+    "<FW_Version> <LUT_Version>", blanks and control bytes replaced
+******************************************************************************/
+static void EPD_IT8951_Profile_Key(IT8951_Dev_Info* Dev_Info, char* Key, UWORD Size)
+{
+    const char* Field[2] = {(const char*)Dev_Info->FW_Version, (const char*)Dev_Info->LUT_Version};
+    UWORD Len = 0;
+
+    for(UBYTE f = 0; f < 2; f++)
+    {
+        UWORD Start = Len;
+        for(UWORD i = 0; i < sizeof(Dev_Info->FW_Version) && Field[f][i] != 0 && Len < Size - 2; i++)
+            Key[Len++] = isgraph((unsigned char)Field[f][i]) ? Field[f][i] : '_';
+        if(Len == Start && Len < Size - 2)
+            Key[Len++] = '-';
+        if(f == 0)
+            Key[Len++] = ' ';
+    }
+    Key[Len] = 0;
+}
+
+
+static const char* EPD_IT8951_Profile_Path(void)
+{
+    const char* Path = getenv("EPD_SPI_PROFILE");
+    return (Path != NULL && Path[0] != 0) ? Path : IT8951_SPI_PROFILE_PATH;
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Load_SPI_Profile
+parameter:
+Info:
+    0 when a profile for this panel was found, 1 otherwise.
+    Lines are "<FW_Version> <LUT_Version> <Write_Hz> <Read_Hz>".
+******************************************************************************/
+UBYTE EPD_IT8951_Load_SPI_Profile(IT8951_Dev_Info* Dev_Info, IT8951_SPI_Profile* Profile)
+{
+    char Key[40], Fw[20], Lut[20], Line[128];
+    unsigned long Write_Hz, Read_Hz;
+    UBYTE Status = 1;
+    FILE* File;
+
+    EPD_IT8951_Profile_Key(Dev_Info, Key, sizeof(Key));
+    File = fopen(EPD_IT8951_Profile_Path(), "r");
+    if(File == NULL)
+        return 1;
+
+    while(fgets(Line, sizeof(Line), File) != NULL)
+    {
+        char Line_Key[40];
+        if(sscanf(Line, "%19s %19s %lu %lu", Fw, Lut, &Write_Hz, &Read_Hz) != 4)
+            continue;
+        snprintf(Line_Key, sizeof(Line_Key), "%s %s", Fw, Lut);
+        if(strcmp(Line_Key, Key) == 0 && Write_Hz != 0 && Read_Hz != 0) {
+            Profile->Write_Hz = Write_Hz;
+            Profile->Read_Hz = Read_Hz;
+            Status = 0;
+        }
+    }
+    fclose(File);
+    return Status;
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Save_SPI_Profile
+parameter:
+Info:
+    Replaces the line of this panel and keeps the others, the file is
+    rewritten through a temporary and renamed
+******************************************************************************/
+UBYTE EPD_IT8951_Save_SPI_Profile(IT8951_Dev_Info* Dev_Info, IT8951_SPI_Profile* Profile)
+{
+    const char* Path = EPD_IT8951_Profile_Path();
+    char Key[40], Tmp_Path[256], Line[128], Fw[20], Lut[20];
+    FILE *Old, *New;
+
+    EPD_IT8951_Profile_Key(Dev_Info, Key, sizeof(Key));
+    snprintf(Tmp_Path, sizeof(Tmp_Path), "%s.tmp", Path);
+    New = fopen(Tmp_Path, "w");
+    if(New == NULL) {
+        Debug("SPI profile: cannot write %s\r\n", Tmp_Path);
+        return 1;
+    }
+
+    Old = fopen(Path, "r");
+    if(Old != NULL) {
+        while(fgets(Line, sizeof(Line), Old) != NULL)
+        {
+            char Line_Key[40];
+            if(sscanf(Line, "%19s %19s", Fw, Lut) == 2) {
+                snprintf(Line_Key, sizeof(Line_Key), "%s %s", Fw, Lut);
+                if(strcmp(Line_Key, Key) == 0)
+                    continue;
+            }
+            fputs(Line, New);
+        }
+        fclose(Old);
+    }
+
+    fprintf(New, "%s %lu %lu\n", Key, (unsigned long)Profile->Write_Hz, (unsigned long)Profile->Read_Hz);
+    if(fclose(New) != 0 || rename(Tmp_Path, Path) != 0) {
+        Debug("SPI profile: cannot replace %s\r\n", Path);
+        remove(Tmp_Path);
+        return 1;
+    }
+    return 0;
+}
+
+
+/******************************************************************************
+function :	EPD_IT8951_Auto_SPI
+parameter:
+    Scratch_Addr : as for EPD_IT8951_Tune_SPI
+Info:
+    Startup path: a stored profile is applied after a single check pass,
+    a missing or failing one is tuned again and saved
+******************************************************************************/
+UBYTE EPD_IT8951_Auto_SPI(IT8951_Dev* Dev, UDOUBLE Scratch_Addr)
+{
+    IT8951_SPI_Profile Profile;
+    UBYTE Status = IT8951_OK;
+
+    pthread_mutex_lock(&Dev->Lock);
+
+    if(EPD_IT8951_Load_SPI_Profile(&Dev->Info, &Profile) == 0) {
+        UDOUBLE Busy_ms, Display_ms;
+        bool Good;
+
+        EPD_IT8951_Get_Busy_Timeout(Dev, &Busy_ms, &Display_ms);
+        EPD_IT8951_Set_Busy_Timeout(Dev, IT8951_TUNE_BUSY_MS, Display_ms);
+        EPD_IT8951_Tune_Speed(Dev, Profile.Write_Hz, Profile.Read_Hz);
+        Good = EPD_IT8951_Tune_Check(Dev, Scratch_Addr, 1);
+        EPD_IT8951_Invalidate_Reg_Cache(Dev);
+        EPD_IT8951_Set_Busy_Timeout(Dev, Busy_ms, Display_ms);
+
+        if(Good) {
+            Debug("SPI profile: write %lu Hz, read %lu Hz\r\n",
+                  (unsigned long)Profile.Write_Hz, (unsigned long)Profile.Read_Hz);
+            pthread_mutex_unlock(&Dev->Lock);
+            return IT8951_OK;
+        }
+        Debug("SPI profile: stored clocks failed, tuning again\r\n");
+        if(!EPD_IT8951_Tune_Recover(Dev, Scratch_Addr))
+            Status = IT8951_ERR_BUSY_TIMEOUT;
+    }
+
+    if(Status == IT8951_OK) {
+        Status = EPD_IT8951_Tune_SPI(Dev, Scratch_Addr, &Profile);
+        if(Status == IT8951_OK)
+            EPD_IT8951_Save_SPI_Profile(&Dev->Info, &Profile);
+    }
+    pthread_mutex_unlock(&Dev->Lock);
+    return Status;
+}
@@ -0,0 +1,57 @@
+/*****************************************************************************
+* | File      	:   EPD_IT8951_Tune.h
+* | Author      :   IT8951-ePaper contributors
+* | Function    :   SPI clock autotuner for the IT8951
+* | Info        :
+*----------------
+* |	This version:   V1.0
+* | Date        :   2026-10-18
+* | Info        :
+* -----------------------------------------------------------------------------
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documnetation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to  whom the Software is
+# furished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS OR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+# THE SOFTWARE.
+#
+******************************************************************************/
+#ifndef __EPD_IT8951_TUNE_H_
+#define __EPD_IT8951_TUNE_H_
+
+#include "EPD_IT8951.h"
+
+//Profile file, one line per panel, overridden by $EPD_SPI_PROFILE
+#define IT8951_SPI_PROFILE_PATH    "/var/tmp/it8951_spi.profile"
+
+//Verification at each clock step
+#define IT8951_TUNE_WORDS          1024    //burst pattern length, bytes = 2x
+#define IT8951_TUNE_REPEAT         3       //passes needed before a step is accepted
+#define IT8951_TUNE_BUSY_MS        200     //HRDY timeout while tuning
+
+typedef struct IT8951_SPI_Profile
+{
+    UDOUBLE Write_Hz;
+    UDOUBLE Read_Hz;
+}IT8951_SPI_Profile;
+
+UBYTE EPD_IT8951_Tune_SPI(IT8951_Dev* Dev, UDOUBLE Scratch_Addr, IT8951_SPI_Profile* Profile);
+
+UBYTE EPD_IT8951_Load_SPI_Profile(IT8951_Dev_Info* Dev_Info, IT8951_SPI_Profile* Profile);
+UBYTE EPD_IT8951_Save_SPI_Profile(IT8951_Dev_Info* Dev_Info, IT8951_SPI_Profile* Profile);
+
+UBYTE EPD_IT8951_Auto_SPI(IT8951_Dev* Dev, UDOUBLE Scratch_Addr);
+
+#endif